@@ -47,6 +47,7 @@ namespace MiniZinc {
 
   class Item;
   class FunctionI;
+  class ParBytecode;
 
   class ExpressionSet;
   class ExpressionSetIter;
@@ -249,6 +250,11 @@ namespace MiniZinc {
     
     /// Mark \a e as alive for garbage collection
     static void mark(Expression* e);
+    /** \brief Mark the non-expression components of \a e (which must
+     * already be marked itself) and push its subexpressions onto \a stack
+     */
+    static void markChildren(const Expression* e,
+                             std::vector<const Expression*>& stack);
   };
 
   /// \brief Integer literal expression
@@ -429,10 +435,14 @@ namespace MiniZinc {
   class ArrayLit : public Expression {
     friend class Expression;
   protected:
-    /// The array
+    /// The array (created on demand for packed arrays)
     ASTExprVec<Expression> _v;
     /// The declared array dimensions
     ASTIntVec _dims;
+    /// Packed values of a par array, or NULL once materialised
+    ASTParVecO* _packed;
+    /// Replace the packed values by literal expressions
+    void materialise(void);
   public:
     /// The identifier of this expression type
     static const ExpressionId eid = E_ARRAYLIT;
@@ -453,13 +463,45 @@ namespace MiniZinc {
     /// Constructor (two-dimensional)
     ArrayLit(const Location& loc,
              const std::vector<std::vector<Expression*> >& v);
+    /// Constructor (packed par values)
+    ArrayLit(const Location& loc,
+             ASTParVecO* packed,
+             const std::vector<std::pair<int,int> >& dims);
     /// Recompute hash value
     void rehash(void);
     
-    /// Access value
-    ASTExprVec<Expression> v(void) const { return _v; }
+    /**
+     * \brief Access value
+     *
+     * If the array is packed, this creates literal expressions for its
+     * values and drops the packed representation, so that modifications
+     * made through the returned vector are seen by all other operations.
+     * Read-only code should use operator[] and size() instead.
+     */
+    ASTExprVec<Expression> v(void) {
+      if (_packed)
+        materialise();
+      return _v;
+    }
+    /**
+     * \brief Return element \a i
+     *
+     * For a packed array, this returns a new literal for the value and
+     * leaves the array unchanged. The literal is not kept alive by the array.
+     */
+    const Expression* operator [](unsigned int i) const {
+      return _packed ? packedElement(i) : _v[i];
+    }
+    /// Return a literal for element \a i of a packed array
+    Expression* packedElement(unsigned int i) const;
     /// Set value
-    void v(const ASTExprVec<Expression>& val) { _v = val; }
+    void v(const ASTExprVec<Expression>& val) { _v = val; _packed = NULL; }
+    /// Return number of elements
+    unsigned int size(void) const {
+      return _packed ? _packed->size() : _v.size();
+    }
+    /// Return packed par values, or NULL if the array is not packed
+    ASTParVecO* packed(void) const { return _packed; }
 
     /// Return number of dimensions
     int dims(void) const;
@@ -557,6 +599,10 @@ namespace MiniZinc {
     /// The where-clause (or NULL)
     Expression* _where;
   public:
+    /// Bytecode compiled for par evaluation (or NULL), see bytecode_comp
+    ParBytecode* _bytecode;
+    /// Whether compiling to bytecode has been attempted
+    bool _bytecodeDone;
     /// The identifier of this expression type
     static const ExpressionId eid = E_COMP;
     /// Constructor
@@ -731,9 +777,41 @@ namespace MiniZinc {
     /// Recompute hash value
     void rehash(void);
   };
+  /**
+   * \brief Observer of declaration updates
+   *
+   * Observers are notified whenever the domain, right hand side or
+   * flattened version of a declaration changes, so that information
+   * derived from declarations (such as cached bounds) can be invalidated
+   * per declaration. Observers are registered with the thread that
+   * constructs them, since declarations are only updated by the thread
+   * that flattens the model they belong to.
+   */
+  class DeclObserver {
+    friend class VarDecl;
+  private:
+    /// Previous observer on this thread
+    DeclObserver* _prev;
+    /// Next observer on this thread
+    DeclObserver* _next;
+    /// Observers cannot be copied
+    DeclObserver(const DeclObserver&);
+    /// Observers cannot be copied
+    DeclObserver& operator =(const DeclObserver&);
+  public:
+    /// Constructor (registers the observer)
+    DeclObserver(void);
+    /// Destructor (unregisters the observer)
+    virtual ~DeclObserver(void);
+    /// Node \a n (a declaration or type-inst) has changed
+    virtual void changed(const ASTNode* n) = 0;
+    /// Any declaration may have changed
+    virtual void changedAll(void) = 0;
+  };
+
   /// \brief A variable declaration expression
   class VarDecl : public Expression {
-    friend class Let;
+    friend class DeclObserver;
   protected:
     /// Type-inst of the declared variable
     TypeInst* _ti;
@@ -745,6 +823,8 @@ namespace MiniZinc {
     WeakRef _flat;
     /// Integer payload
     int _payload;
+    /// Observers registered on this thread
+    static DeclObserver*& _observers(void);
   public:
     /// The identifier of this expression type
     static const ExpressionId eid = E_VARDECL;
@@ -765,7 +845,7 @@ namespace MiniZinc {
     /// Access TypeInst
     TypeInst* ti(void) const { return _ti; }
     /// Set TypeInst
-    void ti(TypeInst* t) { _ti=t; }
+    void ti(TypeInst* t) { if (t != _ti) { _ti=t; touch(this); } }
     /// Access identifier
     Id* id(void) const { return _id; }
     /// Access initialisation expression
@@ -795,6 +875,17 @@ namespace MiniZinc {
     int payload(void) const { return _payload; }
     /// Set payload
     void payload(int i) { _payload = i; }
+    
+    /// Notify the observers on this thread that node \a n has changed
+    static void touch(const ASTNode* n) {
+      for (DeclObserver* o = _observers(); o != NULL; o = o->_next)
+        o->changed(n);
+    }
+    /// Notify the observers on this thread that any declaration may have changed
+    static void touchAll(void) {
+      for (DeclObserver* o = _observers(); o != NULL; o = o->_next)
+        o->changedAll();
+    }
   };
   /// \brief %Let expression
   class Let : public Expression {
@@ -816,12 +907,61 @@ namespace MiniZinc {
     ASTExprVec<Expression> let(void) const { return _let; }
     /// Access body
     Expression* in(void) const { return _in; }
-    
-    /// Remember current let bindings
-    void pushbindings(void);
-    /// Restore previous let bindings
-    void popbindings(void);
-    
+  };
+
+  /**
+   * \brief Scoped bindings of let variables and function parameters
+   *
+   * Records the right hand side, type-inst and flat declaration of each
+   * declaration bound in a scope, and restores them in reverse order when
+   * the object is destroyed, including when an exception leaves the scope.
+   * Objects of this class must be allocated on the stack, the garbage
+   * collector treats the recorded expressions of all live scopes as roots.
+   */
+  class Bindings {
+    friend class GC;
+  public:
+    /// A recorded binding
+    struct Binding {
+      VarDecl* vd;
+      Expression* e;
+      TypeInst* ti;
+      VarDecl* flat;
+    };
+  protected:
+    /// Number of bindings recorded without allocating memory
+    static const unsigned int _inlineSize = 4;
+    /// The first recorded bindings
+    Binding _inline[_inlineSize];
+    /// Further recorded bindings
+    std::vector<Binding> _more;
+    /// Number of recorded bindings
+    unsigned int _size;
+    /// Enclosing scope
+    Bindings* _next;
+  private:
+    Bindings(const Bindings&);
+    Bindings& operator =(const Bindings&);
+  public:
+    /// Constructor
+    Bindings(void);
+    /// Record the bindings of all declarations of \a let
+    Bindings(Let* let);
+    /// Destructor, restores all recorded bindings
+    ~Bindings(void);
+    /// Record the current binding of \a vd
+    void save(VarDecl* vd);
+    /// Record the current binding of \a vd and bind it to \a e
+    void bind(VarDecl* vd, Expression* e);
+
+    /// Return number of recorded bindings
+    unsigned int size(void) const { return _size; }
+    /// Return recorded binding \a i
+    const Binding& operator [](unsigned int i) const {
+      return i < _inlineSize ? _inline[i] : _more[i-_inlineSize];
+    }
+    /// Return enclosing scope
+    Bindings* next(void) const { return _next; }
   };
 
   /// \brief Type-inst expression
@@ -849,7 +989,7 @@ namespace MiniZinc {
     /// Access domain
     Expression* domain(void) const { return _domain; }
     //// Set domain
-    void domain(Expression* d) { _domain = d; }
+    void domain(Expression* d) { if (d != _domain) { _domain = d; VarDecl::touch(this); } }
     
     /// Set ranges to \a ranges
     void setRanges(const std::vector<TypeInst*>& ranges);
@@ -1130,6 +1270,13 @@ namespace MiniZinc {
       builtin_str str;
     } _builtins;
 
+    /// Bytecode compiled from the body for par evaluation (or NULL)
+    ParBytecode* _bytecode;
+    /// Whether compiling the body to bytecode has been attempted
+    bool _bytecodeDone;
+    /// Whether the body has side effects (valid once _bytecodeDone is set)
+    bool _bytecodeImpure;
+
     /// Constructor
     FunctionI(const Location& loc,
               const std::string& id, TypeInst* ti,
@@ -1149,7 +1296,7 @@ namespace MiniZinc {
     /// Access body
     Expression* e(void) const { return _e; }
     /// Set body
-    void e(Expression* b) { _e = b; }
+    void e(Expression* b) { _e = b; _bytecodeDone = false; }
     
     /** \brief Compute return type given argument types \a ta
      */
@@ -1163,8 +1310,8 @@ namespace MiniZinc {
 
     /// Mark for GC
     void mark(void) {
-      _gc_mark = 1;
-      loc().mark();
+      if (setMark())
+        loc().mark();
     }
   };
 
@@ -1220,11 +1367,8 @@ namespace MiniZinc {
     void exit(Expression* e) {}
   };
 
-  /// Statically allocated constants
+  /// Statically allocated constants, shared by all threads in the immortal region
   class Constants {
-  private:
-      /// Garbage collection root set for constants
-      Model* m;
   public:
       /// Literal true
       BoolLit* lit_true;
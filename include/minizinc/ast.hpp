@@ -162,7 +162,7 @@ namespace MiniZinc {
   ArrayLit::ArrayLit(const Location& loc,
                      const std::vector<Expression*>& v,
                      const std::vector<std::pair<int,int> >& dims)
-  : Expression(loc,E_ARRAYLIT,Type()) {
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(NULL) {
     _flag_1 = false;
     std::vector<int> d(dims.size()*2);
     for (unsigned int i=dims.size(); i--;) {
@@ -178,7 +178,7 @@ namespace MiniZinc {
   ArrayLit::ArrayLit(const Location& loc,
                      ASTExprVec<Expression> v,
                      const std::vector<std::pair<int,int> >& dims)
-  : Expression(loc,E_ARRAYLIT,Type()) {
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(NULL) {
     _flag_1 = false;
     std::vector<int> d(dims.size()*2);
     for (unsigned int i=dims.size(); i--;) {
@@ -193,7 +193,7 @@ namespace MiniZinc {
   inline
   ArrayLit::ArrayLit(const Location& loc,
                      ASTExprVec<Expression> v)
-  : Expression(loc,E_ARRAYLIT,Type()) {
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(NULL) {
     _flag_1 = false;
     std::vector<int> dims(2);
     dims[0]=1;
@@ -206,7 +206,7 @@ namespace MiniZinc {
   inline
   ArrayLit::ArrayLit(const Location& loc,
                      const std::vector<Expression*>& v)
-  : Expression(loc,E_ARRAYLIT,Type()) {
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(NULL) {
     _flag_1 = false;
     std::vector<int> dims(2);
     dims[0]=1;
@@ -219,7 +219,7 @@ namespace MiniZinc {
   inline
   ArrayLit::ArrayLit(const Location& loc,
                      const std::vector<std::vector<Expression*> >& v)
-  : Expression(loc,E_ARRAYLIT,Type()) {
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(NULL) {
     _flag_1 = false;
     std::vector<int> dims(4);
     dims[0]=1;
@@ -271,6 +271,7 @@ namespace MiniZinc {
     _g = ASTExprVec<Expression>(es);
     _g_idx = ASTIntVec(idx);
     _where = g._w;
+    _bytecodeDone = false;
     rehash();
   }
   inline
@@ -278,7 +279,7 @@ namespace MiniZinc {
                                Expression* e,
                                Generators& g,
                                bool set)
-  : Expression(loc,E_COMP,Type()) {
+  : Expression(loc,E_COMP,Type()), _bytecode(NULL) {
     init(e,g);
     _flag_1 = set;
   }
@@ -405,7 +406,10 @@ namespace MiniZinc {
 
   inline void
   VarDecl::e(Expression* rhs) {
-    _e = rhs;
+    if (rhs != _e) {
+      _e = rhs;
+      touch(this);
+    }
   }
   
   inline bool
@@ -437,6 +441,10 @@ namespace MiniZinc {
   }
   inline void
   VarDecl::flat(VarDecl* vd) {
+    // Always reassign, so that a reference to a collected declaration
+    // is unlinked from the collector's list of weak references
+    if (vd != flat())
+      touch(this);
     _flat = WeakRef(vd);
   }
 
@@ -529,6 +537,9 @@ namespace MiniZinc {
     _ti(ti),
     _params(ASTExprVec<VarDecl>(params)),
     _e(e) {
+    _bytecode = NULL;
+    _bytecodeDone = false;
+    _bytecodeImpure = false;
     _builtins.e = NULL;
     _builtins.b = NULL;
     _builtins.f = NULL;
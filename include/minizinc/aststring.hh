@@ -114,13 +114,16 @@ namespace MiniZinc {
 
   /**
    * \brief Garbage collected string
+   *
+   * Strings are interned in a table owned by the garbage collector of the
+   * current thread, so that equal strings usually share the same object.
    */
   class ASTStringO : public ASTChunk {
   protected:
-    /// Constructor
-    ASTStringO(const std::string& s);
+    /// Constructor for string \a s with hash value \a h
+    ASTStringO(const std::string& s, size_t h);
   public:
-    /// Allocate and initialise as \a s
+    /// Return interned string equal to \a s, allocate it if necessary
     static ASTStringO* a(const std::string& s);
     /// Return underlying C-style string
     const char* c_str(void) const { return _data+sizeof(size_t); }
@@ -138,7 +141,7 @@ namespace MiniZinc {
     }
     /// Mark for garbage collection
     void mark(void) const {
-      _gc_mark = 1;
+      setMark();
     }
   };
 
@@ -164,8 +167,11 @@ namespace MiniZinc {
 
   inline bool
   ASTString::operator== (const ASTString& s) const {
-    return size()==s.size() &&
-      (size()==0 || strncmp(_s->c_str(),s._s->c_str(),size())==0);
+    // Interned strings are equal iff they are identical, but strings
+    // interned by different threads or in the immortal region are not
+    return _s==s._s || (size()==s.size() &&
+      (size()==0 || (_s->hash()==s._s->hash() &&
+                     strncmp(_s->c_str(),s._s->c_str(),size())==0)));
   }
   inline bool
   ASTString::operator!= (const ASTString& s) const {
@@ -118,7 +118,98 @@ namespace MiniZinc {
     /// Iterator end
     int* end(void) { return begin()+size(); }
     /// Mark as alive for garbage collection
-    void mark(void) const { _gc_mark = 1; }
+    void mark(void) const { setMark(); }
+  };
+
+  /**
+   * \brief Garbage collected vector of packed par values
+   *
+   * Stores the values of a fully evaluated par array of integers
+   * (as long long), floats (as double) or Booleans (as bits)
+   * contiguously, without separate literal nodes.
+   */
+  class ASTParVecO : public ASTChunk {
+  public:
+    /// Element kind
+    enum Kind { PV_INT, PV_FLOAT, PV_BOOL };
+  protected:
+    /// Header stored in front of the values
+    struct Header {
+      /// Element kind
+      unsigned int kind;
+      /// Number of elements
+      unsigned int n;
+    };
+    /// Return header
+    Header& header(void) { return *reinterpret_cast<Header*>(_data); }
+    /// Return header
+    const Header& header(void) const {
+      return *reinterpret_cast<const Header*>(_data);
+    }
+    /// Return start of the values
+    char* values(void) { return _data+sizeof(Header); }
+    /// Return start of the values
+    const char* values(void) const { return _data+sizeof(Header); }
+    /// Return number of bytes needed for \a n values of kind \a k
+    static size_t bytes(Kind k, unsigned int n);
+    /// Constructor
+    ASTParVecO(Kind k, unsigned int n);
+  public:
+    /// Allocate vector of \a n values of kind \a k, initialised to zero
+    static ASTParVecO* a(Kind k, unsigned int n);
+    /// Return element kind
+    Kind kind(void) const { return static_cast<Kind>(header().kind); }
+    /// Return size
+    unsigned int size(void) const { return header().n; }
+    /// Return integer at position \a i
+    long long int& i(unsigned int i) {
+      assert(kind()==PV_INT && i<size());
+      return reinterpret_cast<long long int*>(values())[i];
+    }
+    /// Return integer at position \a i
+    long long int i(unsigned int i) const {
+      assert(kind()==PV_INT && i<size());
+      return reinterpret_cast<const long long int*>(values())[i];
+    }
+    /// Return float at position \a i
+    double& f(unsigned int i) {
+      assert(kind()==PV_FLOAT && i<size());
+      return reinterpret_cast<double*>(values())[i];
+    }
+    /// Return float at position \a i
+    double f(unsigned int i) const {
+      assert(kind()==PV_FLOAT && i<size());
+      return reinterpret_cast<const double*>(values())[i];
+    }
+    /// Return Boolean at position \a i
+    bool b(unsigned int i) const {
+      assert(kind()==PV_BOOL && i<size());
+      return (values()[i >> 3] >> (i & 7)) & 1;
+    }
+    /// Set Boolean at position \a i to \a v
+    void b(unsigned int i, bool v) {
+      assert(kind()==PV_BOOL && i<size());
+      if (v)
+        values()[i >> 3] |= static_cast<char>(1 << (i & 7));
+      else
+        values()[i >> 3] &= static_cast<char>(~(1 << (i & 7)));
+    }
+    /// Return pointer to the integers
+    const long long int* ints(void) const {
+      assert(kind()==PV_INT);
+      return reinterpret_cast<const long long int*>(values());
+    }
+    /// Return pointer to the floats
+    const double* floats(void) const {
+      assert(kind()==PV_FLOAT);
+      return reinterpret_cast<const double*>(values());
+    }
+    /// Return number of Booleans that are true
+    unsigned int count(void) const;
+    /// Check if the values of \a v are equal to this vector's values
+    bool equal(const ASTParVecO* v) const;
+    /// Mark as alive for garbage collection
+    void mark(void) const { setMark(); }
   };
 
   /// Garbage collected vector of expressions
@@ -145,7 +236,7 @@ namespace MiniZinc {
     /// Iterator end
     T* end(void) { return begin()+size(); }
     /// Mark as alive for garbage collection
-    void mark(void) const { _gc_mark = 1; }
+    void mark(void) const { setMark(); }
   };
 
   template<class T>
@@ -18,6 +18,19 @@ namespace MiniZinc {
   
   /// Add builtins to the functions defined in \a m
   void registerBuiltins(Env& env, Model* m);
+
+  /**
+   * \brief Parse a library that can be shared by many models
+   *
+   * Parses the standard library and the files \a includes, found in
+   * \a includePaths, in the immortal region (see GCImmortal). The library
+   * is typechecked, its builtins are registered, and it is then frozen
+   * (see Model::freeze), so that models parsed on any thread can include
+   * it. Returns NULL and reports to \a err if the library has errors.
+   */
+  Model* parseLibrary(const std::vector<std::string>& includes,
+                      const std::vector<std::string>& includePaths,
+                      std::ostream& err);
   
 }
 
@@ -0,0 +1,55 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_BYTECODE_HH__
+#define __MINIZINC_BYTECODE_HH__
+
+#include <minizinc/ast.hh>
+
+#include <vector>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Outcome of evaluating an expression using par bytecode
+   *
+   * BC_UNSUPPORTED means the expression could not be compiled, BC_FAILED
+   * that execution was abandoned (e.g. because of an evaluation error).
+   * In both cases the caller evaluates the expression again using the
+   * tree-walking evaluator, which reports any errors with full context.
+   */
+  enum BytecodeResult { BC_OK, BC_UNSUPPORTED, BC_FAILED };
+
+  /// Evaluate call \a ce to a par int or bool function into \a r
+  BytecodeResult bytecode_call(EnvI& env, Call* ce, IntVal& r);
+
+  /// Evaluate par int or bool comprehension \a c into \a a
+  BytecodeResult bytecode_comp(EnvI& env, Comprehension* c,
+                               std::vector<IntVal>& a);
+
+  /// Release the bytecode \a bc of a function
+  void bytecode_delete(ParBytecode* bc);
+
+  /// Disables bytecode evaluation in an environment while in scope
+  class BytecodeDisabler {
+  protected:
+    /// The environment
+    EnvI& _env;
+  public:
+    /// Disable bytecode in \a env
+    BytecodeDisabler(EnvI& env);
+    /// Re-enable bytecode
+    ~BytecodeDisabler(void);
+  };
+
+}
+
+#endif
@@ -81,20 +81,20 @@ namespace MiniZinc {
    */
   IntSetVal* compute_intset_bounds(EnvI& env, Expression* e);
 
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_array(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                  KeepAlive in, std::vector<typename Eval::ArrayVal>& a);
+                  KeepAlive in, Array& a);
 
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_set(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                KeepAlive in, std::vector<typename Eval::ArrayVal>& a);
+                KeepAlive in, Array& a);
 
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_set(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                IntVal i, KeepAlive in, std::vector<typename Eval::ArrayVal>& a) {
+                IntVal i, KeepAlive in, Array& a) {
     e->decl(gen,id)->e()->cast<IntLit>()->v(i);
     CallStackItem csi(env, e->decl(gen,id)->id(), i);
     if (id == e->n_decls(gen)-1) {
@@ -129,10 +129,10 @@ namespace MiniZinc {
     }
   }
 
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_array(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                  IntVal i, KeepAlive in, std::vector<typename Eval::ArrayVal>& a) {
+                  IntVal i, KeepAlive in, Array& a) {
     ArrayLit* al = in()->cast<ArrayLit>();
     CallStackItem csi(env, e->decl(gen,id)->id(), i);
     e->decl(gen,id)->e(al->v()[i.toInt()]);
@@ -179,10 +179,10 @@ namespace MiniZinc {
    * in that generator, \a in is the expression of that generator, and
    * \a a is the array in which to place the result.
    */
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_set(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                KeepAlive in, std::vector<typename Eval::ArrayVal>& a) {
+                KeepAlive in, Array& a) {
     IntSetRanges rsi(in()->cast<SetLit>()->isv());
     Ranges::ToValues<IntSetRanges> rsv(rsi);
     for (; rsv(); ++rsv) {
@@ -198,10 +198,10 @@ namespace MiniZinc {
    * in that generator, \a in is the expression of that generator, and
    * \a a is the array in which to place the result.
    */
-  template<class Eval>
+  template<class Eval, class Array>
   void
   eval_comp_array(EnvI& env, Eval& eval, Comprehension* e, int gen, int id,
-                  KeepAlive in, std::vector<typename Eval::ArrayVal>& a) {
+                  KeepAlive in, Array& a) {
     ArrayLit* al = in()->cast<ArrayLit>();
     for (unsigned int i=0; i<al->v().size(); i++) {
       eval_comp_array<Eval>(env, eval,e,gen,id,i,in,a);
@@ -212,12 +212,13 @@ namespace MiniZinc {
    * \brief Evaluate comprehension expression
    * 
    * Calls \a eval.e for every element of the comprehension \a e and
-   * returns a vector with all the evaluated results.
+   * passes each result to \a a.push_back as soon as it is produced.
+   * \a a does not have to store the results, which allows callers to
+   * process large comprehensions without materialising them.
    */
-  template<class Eval>
-  std::vector<typename Eval::ArrayVal>
-  eval_comp(EnvI& env, Eval& eval, Comprehension* e) {
-    std::vector<typename Eval::ArrayVal> a;
+  template<class Eval, class Array>
+  void
+  eval_comp(EnvI& env, Eval& eval, Comprehension* e, Array& a) {
     KeepAlive in;
     {
       GCLock lock;
@@ -236,6 +237,19 @@ namespace MiniZinc {
     } else {
       eval_comp_array<Eval>(env, eval,e,0,0,in,a);
     }
+  }
+
+  /**
+   * \brief Evaluate comprehension expression
+   * 
+   * Calls \a eval.e for every element of the comprehension \a e and
+   * returns a vector with all the evaluated results.
+   */
+  template<class Eval>
+  std::vector<typename Eval::ArrayVal>
+  eval_comp(EnvI& env, Eval& eval, Comprehension* e) {
+    std::vector<typename Eval::ArrayVal> a;
+    eval_comp(env, eval, e, a);
     return a;
   }  
 
@@ -13,6 +13,12 @@
 #define __MINIZINC_FILE_UTILS_HH__
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 namespace MiniZinc { namespace FileUtils {
 
@@ -24,6 +30,62 @@ namespace MiniZinc { namespace FileUtils {
   bool directory_exists(const std::string& dirname);
   /// Return full path to file
   std::string file_path(const std::string& filename);
+  /// Read the contents of \a filename into \a contents, return whether successful
+  bool read_file(const std::string& filename, std::string& contents);
+
+  /**
+   * \brief Pool of threads that read files in the background
+   *
+   * The parser uses the shared FileReader to load included files and data
+   * files while it is busy parsing other files. Parsing itself stays on the
+   * calling thread, since all AST nodes are allocated from its heap.
+   * Threads are only started when a request finds no idle thread, so
+   * reading a single file uses a single thread.
+   */
+  class FileReader {
+  public:
+    /// Result of reading a file
+    struct Result {
+      /// Name of the file that was read (empty if none was found)
+      std::string filename;
+      /// Contents of the file
+      std::string contents;
+      /// Whether the file was found and read successfully
+      bool success;
+      /// Constructor
+      Result(void) : success(false) {}
+    };
+    /// Construct reader with up to \a nThreads threads (0 means hardware concurrency)
+    FileReader(unsigned int nThreads = 0);
+    /// Destructor, discards all requests that have not been started
+    ~FileReader(void);
+    /// Return the reader shared by all parsers in the process
+    static FileReader& shared(void);
+    /// Read the first existing file from \a candidates in the background
+    std::shared_future<Result> read(const std::vector<std::string>& candidates);
+  protected:
+    /// Worker thread main loop
+    void run(void);
+    /// Maximum number of worker threads
+    unsigned int _maxThreads;
+    /// Worker threads
+    std::vector<std::thread> _threads;
+    /// Number of worker threads waiting for a request
+    unsigned int _idle;
+    /// Pending requests
+    std::deque<std::packaged_task<Result()> > _queue;
+    /// Mutex protecting the queue
+    std::mutex _mutex;
+    /// Signalled when a request is added or the reader shuts down
+    std::condition_variable _cv;
+    /// Whether the reader is shutting down
+    bool _done;
+  private:
+    /// Disabled
+    FileReader(const FileReader&);
+    /// Disabled
+    FileReader& operator =(const FileReader&);
+  };
 }}
 
 #endif
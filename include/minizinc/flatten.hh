@@ -31,8 +31,11 @@ namespace MiniZinc {
   struct FlatteningOptions {
     /// Keep output in resulting flat model
     bool keepOutputInFzn;
+    /// Use half-reified (\a _imp) predicates for Boolean variables that
+    /// only occur positively, if the solver library declares them
+    bool halfReifications;
     /// Default constructor
-    FlatteningOptions(void) : keepOutputInFzn(false) {}
+    FlatteningOptions(void) : keepOutputInFzn(false), halfReifications(false) {}
   };
   
   /// Flatten model \a m
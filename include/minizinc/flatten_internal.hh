@@ -17,6 +17,8 @@
 #include <minizinc/optimize.hh>
 #include <minizinc/eval_par.hh>
 
+#include <random>
+
 namespace MiniZinc {
 
   /// Result of evaluation
@@ -61,6 +63,172 @@ namespace MiniZinc {
   /// Negate context \a c
   BCtx operator -(const BCtx& c);
   
+  /**
+   * \brief Cache for bounds computed from right hand sides of declarations
+   *
+   * Entries are keyed by declaration and refer to it weakly. Each entry
+   * records the declarations and type-insts its bounds were computed from,
+   * and is removed together with the entries depending on it when one of
+   * these changes. The whole cache is only cleared after a collection.
+   */
+  template<class Val>
+  class BoundsCache : public DeclObserver {
+  protected:
+    /// A cache entry
+    struct Entry {
+      /// The declaration
+      WeakRef vd;
+      /// The right hand side the bounds were computed from
+      Expression* e;
+      /// Lower bound
+      Val l;
+      /// Upper bound
+      Val u;
+      /// Whether the bounds are valid
+      bool valid;
+      /// Number of links to this entry in the dependents map
+      size_t links;
+    };
+    typedef UNORDERED_NAMESPACE::unordered_map<const ASTNode*,Entry> Map;
+    typedef UNORDERED_NAMESPACE::unordered_multimap<const ASTNode*,const ASTNode*> Dependents;
+    /// The entries
+    Map _m;
+    /// The declarations whose entries depend on each node
+    Dependents _dependents;
+    /// Number of links to current entries
+    size_t _links;
+    /// Number of changes observed so far
+    unsigned long int _changes;
+  public:
+    /// Constructor
+    BoundsCache(void) : _links(0), _changes(0) {}
+    /// Look up bounds for \a vd, return whether they were found
+    bool find(VarDecl* vd, Val& l, Val& u, bool& valid) {
+      typename Map::iterator it = _m.find(vd);
+      if (it==_m.end() || it->second.vd() != vd || it->second.e != vd->e())
+        return false;
+      l = it->second.l;
+      u = it->second.u;
+      valid = it->second.valid;
+      return true;
+    }
+    /// Return number of changes observed so far
+    unsigned long int changes(void) const { return _changes; }
+    /**
+     * \brief Add bounds for \a vd computed from the nodes \a deps
+     *
+     * The bounds are dropped if anything changed since \a changes,
+     * as the change may not have been recorded as a dependency yet.
+     */
+    void insert(VarDecl* vd, unsigned long int changes,
+                const std::vector<const ASTNode*>& deps,
+                const Val& l, const Val& u, bool valid) {
+      if (changes != _changes)
+        return;
+      // Links from unchanged nodes to removed entries are left behind
+      if (_dependents.size() > 2*_links+4096) {
+        _m.clear();
+        _dependents.clear();
+        _links = 0;
+      }
+      typename Map::iterator it = _m.find(vd);
+      if (it != _m.end())
+        _links -= it->second.links;
+      Entry& entry = _m[vd];
+      entry.vd = WeakRef(vd);
+      entry.e = vd->e();
+      entry.l = l;
+      entry.u = u;
+      entry.valid = valid;
+      entry.links = deps.size()+1;
+      _links += entry.links;
+      // An entry depends on its own declaration
+      _dependents.insert(std::make_pair(vd,vd));
+      for (unsigned int i=0; i<deps.size(); i++)
+        if (deps[i] != vd)
+          _dependents.insert(std::make_pair(deps[i],vd));
+    }
+    /// Remove the entries that depend on \a n
+    virtual void changed(const ASTNode* n) {
+      _changes++;
+      if (_dependents.empty() || _dependents.find(n)==_dependents.end())
+        return;
+      std::vector<const ASTNode*> todo(1,n);
+      while (!todo.empty()) {
+        const ASTNode* cur = todo.back();
+        todo.pop_back();
+        typename Map::iterator it = _m.find(cur);
+        if (it != _m.end()) {
+          _links -= it->second.links;
+          _m.erase(it);
+        }
+        std::pair<typename Dependents::iterator,typename Dependents::iterator>
+          r = _dependents.equal_range(cur);
+        for (typename Dependents::iterator dit = r.first; dit != r.second; ++dit)
+          todo.push_back(dit->second);
+        _dependents.erase(r.first,r.second);
+      }
+    }
+    /// Remove all entries
+    virtual void changedAll(void) {
+      _changes++;
+      _m.clear();
+      _dependents.clear();
+      _links = 0;
+    }
+  };
+
+  /**
+   * \brief Key for the map of flattened expressions
+   *
+   * Calls whose arguments are all identifiers, literals, or arrays of
+   * identifiers and literals (which is the case for all flattened calls)
+   * are keyed by a packed sequence of words made from the declaration,
+   * the argument kinds and types, and the identifier declarations or literal
+   * values. Such keys are hashed with a 64-bit mixer. All other expressions
+   * are hashed and compared structurally.
+   *
+   * Only keys stored in the map keep the packed words and keep their
+   * expression alive. Keys used for lookups hash the expression on the
+   * fly and compare it word by word against the stored key, so that a
+   * lookup does not allocate.
+   */
+  class CSEKey {
+  protected:
+    /// The expression of a stored key
+    KeepAlive _e;
+    /// The expression of a lookup key
+    Expression* _lookup;
+    /// The packed words of a stored key
+    std::vector<unsigned long long> _k;
+    /// The hash value
+    size_t _hash;
+    /// Whether the expression is packed rather than compared structurally
+    bool _packed;
+    /// Pack call \a c into \a sink, return false if not possible
+    template<class Sink>
+    static bool pack(Call* c, Sink& sink);
+    /// Pack argument \a a into \a sink, return false if not possible
+    template<class Sink>
+    static bool packArg(Expression* a, Sink& sink);
+  public:
+    /// Constructor for a key stored in the map if \a store, otherwise for a lookup key
+    CSEKey(Expression* e, bool store);
+    /// Return the expression
+    Expression* operator ()(void) const { return _lookup ? _lookup : _e(); }
+    /// Return hash value
+    size_t hash(void) const { return _hash; }
+    /// Test whether the key is equal to \a k
+    bool operator ==(const CSEKey& k) const;
+  };
+
+  /// Hash class for CSEKey objects
+  struct CSEKeyHash {
+    size_t operator() (const CSEKey& k) const {
+      return k.hash();
+    }
+  };
+
   class EnvI {
   public:
     Model* orig;
@@ -74,7 +242,7 @@ namespace MiniZinc {
       WeakRef b;
       WW(WeakRef r0, WeakRef b0) : r(r0), b(b0) {}
     };
-    typedef KeepAliveMap<WW> Map;
+    typedef UNORDERED_NAMESPACE::unordered_map<CSEKey,WW,CSEKeyHash> Map;
     bool ignorePartial;
     std::vector<const Expression*> callStack;
     std::vector<const Expression*> errorStack;
@@ -83,15 +251,40 @@ namespace MiniZinc {
     std::vector<std::string> warnings;
     bool collect_vardecls;
     std::vector<int> modifiedVarDecls;
+    /// Indices of flat declarations whose domains were narrowed, see propagateDomains
+    std::vector<int> domainQueue;
     int in_redundant_constraint;
+    /// Nesting depth of regions where par bytecode must not be used
+    int bytecode_disabled;
+    /// Whether half-reified predicates may be used, see FlatteningOptions
+    bool halfReifications;
+    /// Random number generator used by the random distribution builtins
+    std::default_random_engine rnd_generator;
+    /// Integer bounds of right hand sides, see compute_int_bounds
+    BoundsCache<IntVal> intBounds;
+    /// Float bounds of right hand sides, see compute_float_bounds
+    BoundsCache<FloatVal> floatBounds;
+    /// Map from nodes of frozen library models to their copies, see libraryFn
+    CopyMap libraryMap;
   protected:
     Map map;
     Model* _flat;
+    /// Copies of library functions made by libraryFn
+    Model* _libraryFns;
     unsigned int ids;
     ASTStringMap<ASTString>::t reifyMap;
   public:
     EnvI(Model* orig0);
     ~EnvI(void);
+    /**
+     * \brief Return the function to use for calls to \a fi
+     *
+     * Functions of a frozen library must not be modified, since other
+     * environments may use them concurrently. The first time a function
+     * with a body is used, it is copied, together with the library
+     * functions it calls, and the copy is returned from then on.
+     */
+    FunctionI* libraryFn(FunctionI* fi);
     long long int genId(void);
     void map_insert(Expression* e, const EE& ee);
     Map::iterator map_find(Expression* e);
@@ -102,9 +295,14 @@ namespace MiniZinc {
     void flat_addItem(Item* i);
     void flat_removeItem(int i);
     void flat_removeItem(Item* i);
+    /// Remove all items marked as removed from the flat model
+    void flat_compact(void);
     void vo_add_exp(VarDecl* vd);
+    /// Queue the flat declaration \a vd after its domain has been narrowed
+    void domainChanged(VarDecl* vd);
     Model* flat(void);
     ASTString reifyId(const ASTString& id);
+    ASTString halfReifyId(const ASTString& id);
     std::ostream& dumpStack(std::ostream& os, bool errStack);
     void addWarning(const std::string& msg);
     void collectVarDecls(bool b);
@@ -116,22 +314,8 @@ namespace MiniZinc {
   Expression* follow_id_to_value(Expression* e);
 
   EE flat_exp(EnvI& env, Ctx ctx, Expression* e, VarDecl* r, VarDecl* b);
+  KeepAlive bind(EnvI& env, Ctx ctx, VarDecl* vd, Expression* e);
 
-  class CmpExpIdx {
-  public:
-    std::vector<KeepAlive>& x;
-    CmpExpIdx(std::vector<KeepAlive>& x0) : x(x0) {}
-    bool operator ()(int i, int j) const {
-      if (Expression::equal(x[i](),x[j]()))
-        return false;
-      if (x[i]()->isa<Id>() && x[j]()->isa<Id>() &&
-          x[i]()->cast<Id>()->idn() != -1 &&
-          x[j]()->cast<Id>()->idn() != -1)
-        return x[i]()->cast<Id>()->idn() < x[j]()->cast<Id>()->idn();
-      return x[i]()<x[j]();
-    }
-  };
-  
   template<class Lit>
   class LinearTraits {
   };
@@ -376,46 +560,43 @@ namespace MiniZinc {
     static FloatLit* newLit(Val v) { return new FloatLit(Location().introduce(),v); }
   };
 
+  /**
+   * \brief Merge terms of linear expression \a c * \a x + \a d
+   *
+   * Identical terms are aggregated using a hash map keyed by the term,
+   * literal terms are folded into \a d, and terms with zero coefficients
+   * are removed. The remaining terms keep the order of their first
+   * occurrence.
+   */
   template<class Lit>
   void simplify_lin(std::vector<typename LinearTraits<Lit>::Val>& c,
                     std::vector<KeepAlive>& x,
                     typename LinearTraits<Lit>::Val& d) {
-    std::vector<int> idx(c.size());
-    for (unsigned int i=idx.size(); i--;) {
-      idx[i]=i;
+    ExpressionMap<unsigned int> first;
+    for (unsigned int i=0; i<x.size(); i++) {
       Expression* e = follow_id_to_decl(x[i]());
       if (VarDecl* vd = e->dyn_cast<VarDecl>()) {
         if (vd->e() && vd->e()->isa<Lit>()) {
-          x[i] = vd->e();
+          e = vd->e();
         } else {
-          x[i] = e->cast<VarDecl>()->id();
+          e = vd->id();
         }
-      } else {
-        x[i] = e;
       }
-    }
-    std::sort(idx.begin(),idx.end(),CmpExpIdx(x));
-    unsigned int ci = 0;
-    for (; ci<x.size(); ci++) {
-      if (Lit* il = x[idx[ci]]()->dyn_cast<Lit>()) {
-        d += c[idx[ci]]*il->v();
-        c[idx[ci]] = 0;
+      x[i] = e;
+      if (Lit* il = e->dyn_cast<Lit>()) {
+        d += c[i]*il->v();
+        c[i] = 0;
       } else {
-        break;
-      }
-    }
-    for (unsigned int i=ci+1; i<x.size(); i++) {
-      if (Expression::equal(x[idx[i]](),x[idx[ci]]())) {
-        c[idx[ci]] += c[idx[i]];
-        c[idx[i]] = 0;
-      } else if (Lit* il = x[idx[i]]()->dyn_cast<Lit>()) {
-        d += c[idx[i]]*il->v();
-        c[idx[i]] = 0;
-      } else {
-        ci=i;
+        ExpressionMap<unsigned int>::iterator it = first.find(e);
+        if (it == first.end()) {
+          first.insert(e, i);
+        } else {
+          c[it->second] += c[i];
+          c[i] = 0;
+        }
       }
     }
-    ci = 0;
+    unsigned int ci = 0;
     for (unsigned int i=0; i<c.size(); i++) {
       if (c[i] != 0) {
         c[ci] = c[i];
@@ -15,6 +15,9 @@
 #include <cstdlib>
 #include <cassert>
 #include <new>
+#include <vector>
+#include <atomic>
+#include <iosfwd>
 
 namespace MiniZinc {
   
@@ -24,8 +27,14 @@ namespace MiniZinc {
   class ASTNode {
     friend class GC;
   protected:
-    /// Mark for garbage collection
-    mutable unsigned int _gc_mark : 1;
+    /**
+     * \brief Mark for garbage collection
+     *
+     * The mark is a byte of its own rather than a bit field, so that the
+     * threads of a parallel mark phase can set it atomically without
+     * touching the other fields of the node (see setMark).
+     */
+    mutable unsigned char _gc_mark;
     /// Id of the node
     unsigned int _id : 7;
     /// Secondary id
@@ -34,13 +43,44 @@ namespace MiniZinc {
     unsigned int _flag_1 : 1;
     /// Flag
     unsigned int _flag_2 : 1;
+    /// Whether the node has been sealed in the immortal region
+    unsigned int _immortal : 1;
     
     enum BaseNodes { NID_FL, NID_CHUNK, NID_VEC, NID_END = NID_VEC };
 
     /// Constructor
-    ASTNode(unsigned int id) : _gc_mark(0), _id(id) {}
+    ASTNode(unsigned int id) : _gc_mark(0), _id(id), _immortal(0) {}
+
+    /// Return the mark as an atomic variable
+    std::atomic<unsigned char>& atomicMark(void) const {
+      return reinterpret_cast<std::atomic<unsigned char>&>(_gc_mark);
+    }
+    /**
+     * \brief Set the mark, return whether the node was unmarked
+     *
+     * Safe to call from several marking threads at once, although more
+     * than one of them may find the node unmarked. Nodes that are already
+     * marked are only read, so that immortal nodes, which are shared by
+     * all threads and always marked, are never written.
+     */
+    bool setMark(void) const {
+      std::atomic<unsigned char>& m = atomicMark();
+      if (m.load(std::memory_order_relaxed) != 0)
+        return false;
+      m.store(1, std::memory_order_relaxed);
+      return true;
+    }
+    /// Like setMark, but only one of several threads finds the node unmarked
+    bool claimMark(void) const {
+      std::atomic<unsigned char>& m = atomicMark();
+      return m.load(std::memory_order_relaxed)==0 &&
+        m.exchange(1, std::memory_order_relaxed)==0;
+    }
 
   public:
+    /// Return whether the node is sealed in the immortal region
+    bool immortal(void) const { return _immortal; }
+
     /// Allocate node
     void* operator new(size_t size);
 
@@ -105,9 +145,11 @@ namespace MiniZinc {
 
   class Model;
   class Expression;
+  class ASTStringO;
 
   class KeepAlive;
   class WeakRef;
+  class Bindings;
 
   /// Garbage collector
   class GC {
@@ -116,12 +158,18 @@ namespace MiniZinc {
     friend class ASTChunk;
     friend class KeepAlive;
     friend class WeakRef;
+    friend class Bindings;
+    friend class ASTStringO;
   private:
     class Heap;
     /// The memory controlled by the collector
     Heap* _heap;
     /// Count how many locks are currently active
     unsigned int _lock_count;
+    /// Count how many immortal allocation scopes are currently active
+    unsigned int _immortal_count;
+    /// Nodes allocated in the immortal region that still need to be sealed
+    std::vector<ASTNode*> _immortal_nodes;
     /// Return thread-local GC object
     static GC*& gc(void);
     /// Constructor
@@ -134,6 +182,19 @@ namespace MiniZinc {
     static void removeKeepAlive(KeepAlive* e);
     static void addWeakRef(WeakRef* e);
     static void removeWeakRef(WeakRef* e);
+    static void pushBindings(Bindings* b);
+    static void popBindings(Bindings* b);
+
+    /**
+     * \brief Return interned string equal to \a s of length \a n with hash \a h, or NULL
+     *
+     * Strings interned in the immortal region are shared by all threads and
+     * are found first; other strings are only visible to the thread that
+     * interned them.
+     */
+    static ASTStringO* findString(const char* s, size_t n, size_t h);
+    /// Add \a s to the immortal or the thread's table of interned strings
+    static void internString(ASTStringO* s);
   public:
     /// Acquire garbage collector lock for this thread
     static void lock(void);
@@ -141,20 +202,33 @@ namespace MiniZinc {
     static void unlock(void);
     /// Test if garbage collector is locked
     static bool locked(void);
+    /// Allocate subsequent nodes in the shared immortal region
+    static void beginImmortal(void);
+    /// Seal nodes allocated since the outermost beginImmortal
+    static void endImmortal(void);
     /// Add model \a m to root set
     static void add(Model* m);
     /// Remove model \a m from root set
     static void remove(Model* m);
     
-    /// Put a mark on the trail
-    static void mark(void);
-    /// Add a trail entry
-    static void trail(Expression**,Expression*);
-    /// Untrail to previous mark
-    static void untrail(void);
-    
     /// Return maximum allocated memory (high water mark)
     static size_t maxMem(void);
+
+    /**
+     * \brief Set number of threads used for marking and sweeping (1 = sequential)
+     *
+     * The collector of each thread keeps its helper threads between
+     * collections. Setting the number back to 1 stops them, which a thread
+     * that used more should do before it exits.
+     */
+    static void threads(unsigned int n);
+    /// Return number of threads used for marking and sweeping
+    static unsigned int threads(void);
+
+    /// Enable or disable recording of collection statistics
+    static void stats(bool b);
+    /// Print heap and collection statistics in JSON format to \a os
+    static void printStats(std::ostream& os);
   };
 
   /// Automatic garbage collection lock
@@ -166,6 +240,25 @@ namespace MiniZinc {
     ~GCLock(void);
   };
 
+  /**
+   * \brief Automatic immortal allocation scope
+   *
+   * All nodes allocated while an object of this class is alive are placed
+   * in a process-wide region that is never collected. When the outermost
+   * scope ends, the nodes are sealed by setting their mark permanently, so
+   * that the collectors of all threads treat them as live without ever
+   * traversing (or writing to) them. Immortal nodes must therefore only
+   * refer to other immortal nodes, and must not be modified after sealing.
+   * A GCLock must be held for the whole lifetime of the scope.
+   */
+  class GCImmortal {
+  public:
+    /// Enter immortal allocation scope
+    GCImmortal(void);
+    /// Seal nodes and leave scope upon destruction
+    ~GCImmortal(void);
+  };
+
   /// Expression wrapper that is a member of the root set
   class KeepAlive {
     friend class GC;
@@ -0,0 +1,36 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_LINEARIZE_HH__
+#define __MINIZINC_LINEARIZE_HH__
+
+#include <minizinc/flatten_internal.hh>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Linearise the indicator constraints of the flat model in \a env
+   *
+   * Rewrites the constraints mzn_int_lin_le_ind, mzn_int_lin_eq_ind and
+   * mzn_int_lin_ne_ind (posted by the linear library) into int_lin_le and
+   * int_lin_eq constraints. Indicators of equivalent constraints are shared,
+   * equalities of a variable with several constants are merged into an
+   * equality encoding of its domain, and Big-M coefficients are computed
+   * from the variable bounds of the flat model.
+   *
+   * Declarations that may have become unused are added to
+   * \a deletedVarDecls. Returns whether any constraint was rewritten.
+   */
+  bool linearize(EnvI& env, std::vector<VarDecl*>& deletedVarDecls);
+
+}
+
+#endif
@@ -58,6 +58,8 @@ namespace MiniZinc {
     std::string _docComment;
     /// Flag whether model is failed
     bool _failed;
+    /// Flag whether model is frozen for sharing between environments
+    bool _frozen;
   public:
     
     /// Construct empty model
@@ -150,6 +152,20 @@ namespace MiniZinc {
 
     /// Return whether model is known to be failed
     bool failed(void) const;
+
+    /**
+     * \brief Freeze the model and all its included models for sharing
+     *
+     * All nodes of the model must have been allocated in the immortal
+     * region (see GCImmortal), and the model must have been typechecked
+     * and its builtins registered. The model is removed from the root
+     * set, since its nodes are never collected. A frozen model can then
+     * be used as the library of models parsed on any thread (see parse),
+     * and must not be modified or deleted while any of them is alive.
+     */
+    void freeze(void);
+    /// Return whether model is frozen
+    bool frozen(void) const { return _frozen; }
   };
 
   class VarDeclIterator {
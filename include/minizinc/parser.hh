@@ -116,6 +116,26 @@ namespace MiniZinc {
                          bool ignoreStdlib, bool parseDocComments, bool verbose,
                          std::ostream& err);
 
+  /**
+   * \brief Parse model \a filename with data files \a datafiles
+   *
+   * Instead of parsing its own copy of the standard library, the model
+   * includes the frozen \a library (see Model::freeze). Include items
+   * for files that are part of the library refer to the library's models.
+   */
+  Model* parseWithLibrary(const std::string& filename,
+                          const std::vector<std::string>& datafiles,
+                          const std::vector<std::string>& includePaths,
+                          Model* library, bool parseDocComments, bool verbose,
+                          std::ostream& err);
+
+  /// Parse \a model from a string, including the frozen \a library
+  Model* parseFromStringWithLibrary(const std::string& model,
+                                    const std::string& filename,
+                                    const std::vector<std::string>& includePaths,
+                                    Model* library, bool parseDocComments, bool verbose,
+                                    std::ostream& err);
+
   Model* parseData(Model* m,
                    const std::vector<std::string>& datafiles,
                    const std::vector<std::string>& includePaths,
@@ -0,0 +1,35 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_PROPAGATE_HH__
+#define __MINIZINC_PROPAGATE_HH__
+
+#include <minizinc/flatten_internal.hh>
+
+namespace MiniZinc {
+
+  /**
+   * \brief Propagate the domains queued by EnvI::domainChanged
+   *
+   * For every queued declaration, the items it occurs in are revisited:
+   * variables whose domains are implied by their definition get the
+   * bounds of that definition, and reified integer comparisons that are
+   * now entailed or disentailed are removed by fixing their Boolean.
+   * Newly narrowed domains are queued in turn until a fixpoint is reached.
+   *
+   * Variables whose last occurrence was removed are added to
+   * \a deletedVarDecls.
+   */
+  void propagateDomains(EnvI& env, std::vector<VarDecl*>& deletedVarDecls);
+
+}
+
+#endif
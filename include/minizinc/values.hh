@@ -15,6 +15,11 @@
 #include <minizinc/gc.hh>
 #include <minizinc/exception.hh>
 #include <minizinc/stl_map_set.hh>
+
+// C++11 compilers provide nullptr, SafeInt must not redefine it
+#if !defined(NEEDS_NULLPTR_DEFINED) && __cplusplus >= 201103L
+#define NEEDS_NULLPTR_DEFINED 0
+#endif
 #include <minizinc/thirdparty/SafeInt3.hpp>
 #include <algorithm>
 #include <functional>
@@ -57,8 +62,30 @@ namespace MiniZinc {
 
 #undef MZN_NORETURN
 
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_add_overflow) && \
+    __has_builtin(__builtin_sub_overflow) && \
+    __has_builtin(__builtin_mul_overflow)
+#define MZN_HAS_OVERFLOW_BUILTINS
+#endif
+#endif
+#if !defined(MZN_HAS_OVERFLOW_BUILTINS) && !defined(__clang__) && \
+    defined(__GNUC__) && __GNUC__ >= 5
+#define MZN_HAS_OVERFLOW_BUILTINS
+#endif
+
 namespace MiniZinc {
   
+  /**
+   * \brief Integer value
+   *
+   * An IntVal is a single machine word. The two extreme values
+   * LLONG_MAX and -LLONG_MAX are reserved for plus and minus infinity,
+   * so finite values lie in [-LLONG_MAX+1,LLONG_MAX-1], and the
+   * comparison operators work on the raw representation. Constructing an
+   * IntVal from a value outside the finite range (including LLONG_MIN),
+   * or arithmetic whose result leaves it, throws an ArithmeticError.
+   */
   class IntVal {
     friend IntVal operator +(const IntVal& x, const IntVal& y);
     friend IntVal operator -(const IntVal& x, const IntVal& y);
@@ -67,16 +94,64 @@ namespace MiniZinc {
     friend IntVal operator %(const IntVal& x, const IntVal& y);
     friend IntVal std::abs(const MiniZinc::IntVal& x);
     friend bool operator ==(const IntVal& x, const IntVal& y);
+    friend bool operator <=(const IntVal& x, const IntVal& y);
+    friend bool operator <(const IntVal& x, const IntVal& y);
   private:
     long long int _v;
-    bool _infinity;
-    IntVal(long long int v, bool infinity) : _v(v), _infinity(infinity) {}
+    /// Representation of plus infinity (minus infinity is its negation)
+    static long long int inf(void) { return LLONG_MAX; }
     typedef SafeInt<long long int, MiniZincSafeIntExceptionHandler> SI;
-    SI toSafeInt(void) const { return _v; }
-    IntVal(SI v) : _v(v), _infinity(false) {}
+    /// Check that \a r is in the finite range
+    static long long int finite(long long int r) {
+      if (r >= inf() || r <= -inf())
+        throw ArithmeticError("integer overflow");
+      return r;
+    }
+    /// Check that both \a x and \a y are finite
+    static void checkFinite(const IntVal& x, const IntVal& y) {
+      if (! (x.isFinite() && y.isFinite()))
+        throw ArithmeticError("arithmetic operation on infinite value");
+    }
+    /// Tag for constructing an IntVal from a value known to be in range
+    struct Unchecked {};
+    /// Construct from representation \a v without checking the range
+    IntVal(long long int v, Unchecked) : _v(v) {}
+    /// Overflow-checked addition of finite values
+    static long long int add(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      if (__builtin_add_overflow(x,y,&r))
+        throw ArithmeticError("integer overflow");
+      return finite(r);
+#else
+      return finite(static_cast<long long int>(SI(x)+y));
+#endif
+    }
+    /// Overflow-checked subtraction of finite values
+    static long long int sub(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      if (__builtin_sub_overflow(x,y,&r))
+        throw ArithmeticError("integer overflow");
+      return finite(r);
+#else
+      return finite(static_cast<long long int>(SI(x)-y));
+#endif
+    }
+    /// Overflow-checked multiplication of finite values
+    static long long int mul(long long int x, long long int y) {
+#ifdef MZN_HAS_OVERFLOW_BUILTINS
+      long long int r;
+      if (__builtin_mul_overflow(x,y,&r))
+        throw ArithmeticError("integer overflow");
+      return finite(r);
+#else
+      return finite(static_cast<long long int>(SI(x)*y));
+#endif
+    }
   public:
-    IntVal(void) : _v(0), _infinity(false) {}
-    IntVal(long long int v) : _v(v), _infinity(false) {}
+    IntVal(void) : _v(0) {}
+    IntVal(long long int v) : _v(finite(v)) {}
     
     long long int toInt(void) const {
       if (!isFinite())
@@ -84,31 +159,27 @@ namespace MiniZinc {
       return _v;
     }
     
-    bool isFinite(void) const { return !_infinity; }
-    bool isPlusInfinity(void) const { return _infinity && _v==1; }
-    bool isMinusInfinity(void) const { return _infinity && _v==-1; }
+    bool isFinite(void) const { return _v != inf() && _v != -inf(); }
+    bool isPlusInfinity(void) const { return _v == inf(); }
+    bool isMinusInfinity(void) const { return _v == -inf(); }
     
     IntVal& operator +=(const IntVal& x) {
-      if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v += x._v;
+      checkFinite(*this,x);
+      _v = add(_v,x._v);
       return *this;
     }
     IntVal& operator -=(const IntVal& x) {
-      if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v -= x._v;
+      checkFinite(*this,x);
+      _v = sub(_v,x._v);
       return *this;
     }
     IntVal& operator *=(const IntVal& x) {
-      if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
-      _v *= x._v;
+      checkFinite(*this,x);
+      _v = mul(_v,x._v);
       return *this;
     }
     IntVal& operator /=(const IntVal& x) {
-      if (! (isFinite() && x.isFinite()))
-        throw ArithmeticError("arithmetic operation on infinite value");
+      checkFinite(*this,x);
       _v /= x._v;
       return *this;
     }
@@ -120,38 +191,38 @@ namespace MiniZinc {
     void operator ++() {
       if (!isFinite())
         throw ArithmeticError("arithmetic operation on infinite value");
-      ++_v;
+      _v = add(_v,1);
     }
     void operator ++(int) {
       if (!isFinite())
         throw ArithmeticError("arithmetic operation on infinite value");
-      ++_v;
+      _v = add(_v,1);
     }
     void operator --() {
       if (!isFinite())
         throw ArithmeticError("arithmetic operation on infinite value");
-      --_v;
+      _v = sub(_v,1);
     }
     void operator --(int) {
       if (!isFinite())
         throw ArithmeticError("arithmetic operation on infinite value");
-      --_v;
+      _v = sub(_v,1);
     }
     static const IntVal minint;
     static const IntVal maxint;
     static const IntVal infinity;
     
     /// Infinity-safe addition
-    IntVal plus(int x) {
+    IntVal plus(int x) const {
       if (isFinite())
-        return toSafeInt()+x;
+        return IntVal(add(_v,x),Unchecked());
       else
         return *this;
     }
     /// Infinity-safe subtraction
-    IntVal minus(int x) {
+    IntVal minus(int x) const {
       if (isFinite())
-        return toSafeInt()-x;
+        return IntVal(sub(_v,x),Unchecked());
       else
         return *this;
     }
@@ -159,18 +230,15 @@ namespace MiniZinc {
 
   inline
   bool operator ==(const IntVal& x, const IntVal& y) {
-    return x.isFinite()==y.isFinite() && x._v == y._v;
+    return x._v == y._v;
   }
   inline
   bool operator <=(const IntVal& x, const IntVal& y) {
-    return y.isPlusInfinity() || x.isMinusInfinity() || (x.isFinite() && y.isFinite() && x.toInt() <= y.toInt());
+    return x._v <= y._v;
   }
   inline
   bool operator <(const IntVal& x, const IntVal& y) {
-    return
-      (y.isPlusInfinity() && !x.isPlusInfinity()) ||
-      (x.isMinusInfinity() && !y.isMinusInfinity()) ||
-      (x.isFinite() && y.isFinite() && x.toInt() < y.toInt());
+    return x._v < y._v;
   }
   inline
   bool operator >=(const IntVal& x, const IntVal& y) {
@@ -186,33 +254,28 @@ namespace MiniZinc {
   }
   inline
   IntVal operator +(const IntVal& x, const IntVal& y) {
-    if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()+y.toSafeInt();
+    IntVal::checkFinite(x,y);
+    return IntVal(IntVal::add(x._v,y._v),IntVal::Unchecked());
   }
   inline
   IntVal operator -(const IntVal& x, const IntVal& y) {
-    if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()-y.toSafeInt();
+    IntVal::checkFinite(x,y);
+    return IntVal(IntVal::sub(x._v,y._v),IntVal::Unchecked());
   }
   inline
   IntVal operator *(const IntVal& x, const IntVal& y) {
-    if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toSafeInt()*y.toSafeInt();
+    IntVal::checkFinite(x,y);
+    return IntVal(IntVal::mul(x._v,y._v),IntVal::Unchecked());
   }
   inline
   IntVal operator /(const IntVal& x, const IntVal& y) {
-    if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toInt()/y.toInt();
+    IntVal::checkFinite(x,y);
+    return IntVal(x._v/y._v,IntVal::Unchecked());
   }
   inline
   IntVal operator %(const IntVal& x, const IntVal& y) {
-    if (! (x.isFinite() && y.isFinite()))
-      throw ArithmeticError("arithmetic operation on infinite value");
-    return x.toInt()%y.toInt();
+    IntVal::checkFinite(x,y);
+    return IntVal(x._v%y._v,IntVal::Unchecked());
   }
   template<class Char, class Traits>
   std::basic_ostream<Char,Traits>&
@@ -231,8 +294,7 @@ namespace std {
   inline
   MiniZinc::IntVal abs(const MiniZinc::IntVal& x) {
     if (!x.isFinite()) return MiniZinc::IntVal::infinity;
-    MiniZinc::IntVal::SI y(x.toInt());
-    return y < 0 ? MiniZinc::IntVal(static_cast<long long int>(-y)) : x;
+    return x._v < 0 ? -x : x;
   }
   
   inline
@@ -316,6 +378,18 @@ namespace MiniZinc {
       for (unsigned int i=s.size(); i--;)
         get(i) = s[i];
     }
+    /// Construct set from the \a n ranges in \a s
+    IntSetVal(const Range* s, int n)
+      : ASTChunk(sizeof(Range)*n) {
+      for (int i=n; i--;)
+        get(i) = s[i];
+    }
+    /// Allocate set from the \a n ranges in \a s
+    static IntSetVal* a(const Range* s, int n) {
+      IntSetVal* r = static_cast<IntSetVal*>(ASTChunk::alloc(sizeof(Range)*n));
+      new (r) IntSetVal(s,n);
+      return r;
+    }
 
     /// Disabled
     IntSetVal(const IntSetVal& r);
@@ -412,6 +486,15 @@ namespace MiniZinc {
       return r;
     }
     
+    /// Return union of \a x and \a y
+    static IntSetVal* unite(IntSetVal* x, IntSetVal* y);
+    /// Return intersection of \a x and \a y
+    static IntSetVal* intersect(IntSetVal* x, IntSetVal* y);
+    /// Return difference of \a x and \a y
+    static IntSetVal* diff(IntSetVal* x, IntSetVal* y);
+    /// Return symmetric difference of \a x and \a y
+    static IntSetVal* symdiff(IntSetVal* x, IntSetVal* y);
+
     /// Check if set contains \a v
     bool contains(const IntVal& v) {
       for (int i=0; i<size(); i++) {
@@ -435,7 +518,7 @@ namespace MiniZinc {
     
     /// Mark for garbage collection
     void mark(void) {
-      _gc_mark = 1;
+      setMark();
     }
   };
   
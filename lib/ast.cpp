@@ -16,6 +16,7 @@
 #include <minizinc/model.hh>
 
 #include <minizinc/prettyprinter.hh>
+#include <minizinc/config.hh>
 
 namespace MiniZinc {
 
@@ -69,83 +70,91 @@ namespace MiniZinc {
       const Expression* cur = stack.back(); stack.pop_back();
       if (cur->_gc_mark==0) {
         cur->_gc_mark = 1;
-        cur->loc().mark();
-        pushann(cur->ann());
-        switch (cur->eid()) {
-        case Expression::E_INTLIT:
-        case Expression::E_FLOATLIT:
-        case Expression::E_BOOLLIT:
-        case Expression::E_ANON:
-          break;
-        case Expression::E_SETLIT:
-          if (cur->cast<SetLit>()->isv())
-            cur->cast<SetLit>()->isv()->mark();
-          else
-            pushall(cur->cast<SetLit>()->v());
-          break;
-        case Expression::E_STRINGLIT:
-          cur->cast<StringLit>()->v().mark();
-          break;
-        case Expression::E_ID:
-          if (cur->cast<Id>()->idn()==-1)
-            cur->cast<Id>()->v().mark();
-          pushstack(cur->cast<Id>()->decl());
-          break;
-        case Expression::E_ARRAYLIT:
-          pushall(cur->cast<ArrayLit>()->v());
-          cur->cast<ArrayLit>()->_dims.mark();
-          break;
-        case Expression::E_ARRAYACCESS:
-          pushstack(cur->cast<ArrayAccess>()->v());
-          pushall(cur->cast<ArrayAccess>()->idx());
-          break;
-        case Expression::E_COMP:
-          pushstack(cur->cast<Comprehension>()->_e);
-          pushstack(cur->cast<Comprehension>()->_where);
-          pushall(cur->cast<Comprehension>()->_g);
-          cur->cast<Comprehension>()->_g_idx.mark();
-          break;
-        case Expression::E_ITE:
-          pushstack(cur->cast<ITE>()->e_else());
-          pushall(cur->cast<ITE>()->_e_if_then);
-          break;
-        case Expression::E_BINOP:
-          pushstack(cur->cast<BinOp>()->lhs());
-          pushstack(cur->cast<BinOp>()->rhs());
-          break;
-        case Expression::E_UNOP:
-          pushstack(cur->cast<UnOp>()->e());
-          break;
-        case Expression::E_CALL:
-          cur->cast<Call>()->id().mark();
-          pushall(cur->cast<Call>()->_args);
-          if (FunctionI* fi = cur->cast<Call>()->_decl) {
-            fi->mark();
-            fi->id().mark();
-            pushstack(fi->ti());
-            pushann(fi->ann());
-            pushstack(fi->e());
-            pushall(fi->params());
-          }
-          break;
-        case Expression::E_VARDECL:
-          pushstack(cur->cast<VarDecl>()->ti());
-          pushstack(cur->cast<VarDecl>()->e());
-          pushstack(cur->cast<VarDecl>()->id());
-          break;
-        case Expression::E_LET:
-          pushall(cur->cast<Let>()->let());
-          pushstack(cur->cast<Let>()->in());
-          break;
-        case Expression::E_TI:
-          pushstack(cur->cast<TypeInst>()->domain());
-          pushall(cur->cast<TypeInst>()->ranges());
-          break;
-        case Expression::E_TIID:
-          cur->cast<TIId>()->v().mark();
-          break;
-        }
+        markChildren(cur, stack);
+      }
+    }
+  }
+
+  void
+  Expression::markChildren(const Expression* cur,
+                           std::vector<const Expression*>& stack) {
+    cur->loc().mark();
+    pushann(cur->ann());
+    switch (cur->eid()) {
+    case Expression::E_INTLIT:
+    case Expression::E_FLOATLIT:
+    case Expression::E_BOOLLIT:
+    case Expression::E_ANON:
+      break;
+    case Expression::E_SETLIT:
+      if (cur->cast<SetLit>()->isv())
+        cur->cast<SetLit>()->isv()->mark();
+      else
+        pushall(cur->cast<SetLit>()->v());
+      break;
+    case Expression::E_STRINGLIT:
+      cur->cast<StringLit>()->v().mark();
+      break;
+    case Expression::E_ID:
+      if (cur->cast<Id>()->idn()==-1)
+        cur->cast<Id>()->v().mark();
+      pushstack(cur->cast<Id>()->decl());
+      break;
+    case Expression::E_ARRAYLIT:
+      pushall(cur->cast<ArrayLit>()->_v);
+      cur->cast<ArrayLit>()->_dims.mark();
+      if (cur->cast<ArrayLit>()->_packed)
+        cur->cast<ArrayLit>()->_packed->mark();
+      break;
+    case Expression::E_ARRAYACCESS:
+      pushstack(cur->cast<ArrayAccess>()->v());
+      pushall(cur->cast<ArrayAccess>()->idx());
+      break;
+    case Expression::E_COMP:
+      pushstack(cur->cast<Comprehension>()->_e);
+      pushstack(cur->cast<Comprehension>()->_where);
+      pushall(cur->cast<Comprehension>()->_g);
+      cur->cast<Comprehension>()->_g_idx.mark();
+      break;
+    case Expression::E_ITE:
+      pushstack(cur->cast<ITE>()->e_else());
+      pushall(cur->cast<ITE>()->_e_if_then);
+      break;
+    case Expression::E_BINOP:
+      pushstack(cur->cast<BinOp>()->lhs());
+      pushstack(cur->cast<BinOp>()->rhs());
+      break;
+    case Expression::E_UNOP:
+      pushstack(cur->cast<UnOp>()->e());
+      break;
+    case Expression::E_CALL:
+      cur->cast<Call>()->id().mark();
+      pushall(cur->cast<Call>()->_args);
+      if (FunctionI* fi = cur->cast<Call>()->_decl) {
+        fi->mark();
+        fi->id().mark();
+        pushstack(fi->ti());
+        pushann(fi->ann());
+        pushstack(fi->e());
+        pushall(fi->params());
       }
+      break;
+    case Expression::E_VARDECL:
+      pushstack(cur->cast<VarDecl>()->ti());
+      pushstack(cur->cast<VarDecl>()->e());
+      pushstack(cur->cast<VarDecl>()->id());
+      break;
+    case Expression::E_LET:
+      pushall(cur->cast<Let>()->let());
+      pushstack(cur->cast<Let>()->in());
+      break;
+    case Expression::E_TI:
+      pushstack(cur->cast<TypeInst>()->domain());
+      pushall(cur->cast<TypeInst>()->ranges());
+      break;
+    case Expression::E_TIID:
+      cur->cast<TIId>()->v().mark();
+      break;
     }
   }
 #undef pushstack
@@ -223,6 +232,43 @@ namespace MiniZinc {
     init_hash();
   }
 
+  ArrayLit::ArrayLit(const Location& loc,
+                     ASTParVecO* packed,
+                     const std::vector<std::pair<int,int> >& dims)
+  : Expression(loc,E_ARRAYLIT,Type()), _packed(packed) {
+    _flag_1 = false;
+    std::vector<int> d(dims.size()*2);
+    for (unsigned int i=dims.size(); i--;) {
+      d[i*2] = dims[i].first;
+      d[i*2+1] = dims[i].second;
+    }
+    _dims = ASTIntVec(d);
+    rehash();
+  }
+
+  Expression*
+  ArrayLit::packedElement(unsigned int i) const {
+    switch (_packed->kind()) {
+    case ASTParVecO::PV_INT:
+      return IntLit::a(_packed->i(i));
+    case ASTParVecO::PV_FLOAT:
+      return new FloatLit(Location().introduce(),_packed->f(i));
+    case ASTParVecO::PV_BOOL:
+    default:
+      return constants().boollit(_packed->b(i));
+    }
+  }
+
+  void
+  ArrayLit::materialise(void) {
+    GCLock lock;
+    std::vector<Expression*> v(_packed->size());
+    for (unsigned int i=v.size(); i--;)
+      v[i] = packedElement(i);
+    _v = ASTExprVec<Expression>(v);
+    _packed = NULL;
+  }
+
   void
   ArrayLit::rehash(void) {
     init_hash();
@@ -231,6 +277,33 @@ namespace MiniZinc {
       cmb_hash(h(_dims[i]));
       cmb_hash(h(_dims[i+1]));
     }
+    if (_packed) {
+      // Same hash values as the literals that materialise() would create
+      for (unsigned int i=_packed->size(); i--;) {
+        cmb_hash(h(i));
+        switch (_packed->kind()) {
+        case ASTParVecO::PV_INT:
+          {
+            HASH_NAMESPACE::hash<IntVal> hv;
+            cmb_hash(cmb_hash(cmb_hash(0,E_INTLIT),hv(_packed->i(i))));
+          }
+          break;
+        case ASTParVecO::PV_FLOAT:
+          {
+            HASH_NAMESPACE::hash<FloatVal> hv;
+            cmb_hash(cmb_hash(cmb_hash(0,E_FLOATLIT),hv(_packed->f(i))));
+          }
+          break;
+        case ASTParVecO::PV_BOOL:
+          {
+            HASH_NAMESPACE::hash<bool> hv;
+            cmb_hash(cmb_hash(cmb_hash(0,E_BOOLLIT),hv(_packed->b(i))));
+          }
+          break;
+        }
+      }
+      return;
+    }
     for (unsigned int i=_v.size(); i--;) {
       cmb_hash(h(i));
       cmb_hash(Expression::hash(_v[i]));
@@ -371,8 +444,6 @@ namespace MiniZinc {
   namespace {
     
     class OpToString {
-    protected:
-      Model* rootSetModel;
     public:
       Id* sBOT_PLUS;
       Id* sBOT_MINUS;
@@ -405,65 +476,35 @@ namespace MiniZinc {
       
       OpToString(void) {
         GCLock lock;
-        rootSetModel = new Model();
-        std::vector<Expression*> rootSet;
+        GCImmortal immortal;
         sBOT_PLUS = new Id(Location(),"+",NULL);
-        rootSet.push_back(sBOT_PLUS);
         sBOT_MINUS = new Id(Location(),"-",NULL);
-        rootSet.push_back(sBOT_MINUS);
         sBOT_MULT = new Id(Location(),"*",NULL);
-        rootSet.push_back(sBOT_MULT);
         sBOT_DIV = new Id(Location(),"/",NULL);
-        rootSet.push_back(sBOT_DIV);
         sBOT_IDIV = new Id(Location(),"div",NULL);
-        rootSet.push_back(sBOT_IDIV);
         sBOT_MOD = new Id(Location(),"mod",NULL);
-        rootSet.push_back(sBOT_MOD);
         sBOT_LE = new Id(Location(),"<",NULL);
-        rootSet.push_back(sBOT_LE);
         sBOT_LQ = new Id(Location(),"<=",NULL);
-        rootSet.push_back(sBOT_LQ);
         sBOT_GR = new Id(Location(),">",NULL);
-        rootSet.push_back(sBOT_GR);
         sBOT_GQ = new Id(Location(),">=",NULL);
-        rootSet.push_back(sBOT_GQ);
         sBOT_EQ = new Id(Location(),"=",NULL);
-        rootSet.push_back(sBOT_EQ);
         sBOT_NQ = new Id(Location(),"!=",NULL);
-        rootSet.push_back(sBOT_NQ);
         sBOT_IN = new Id(Location(),"in",NULL);
-        rootSet.push_back(sBOT_IN);
         sBOT_SUBSET = new Id(Location(),"subset",NULL);
-        rootSet.push_back(sBOT_SUBSET);
         sBOT_SUPERSET = new Id(Location(),"superset",NULL);
-        rootSet.push_back(sBOT_SUPERSET);
         sBOT_UNION = new Id(Location(),"union",NULL);
-        rootSet.push_back(sBOT_UNION);
         sBOT_DIFF = new Id(Location(),"diff",NULL);
-        rootSet.push_back(sBOT_DIFF);
         sBOT_SYMDIFF = new Id(Location(),"symdiff",NULL);
-        rootSet.push_back(sBOT_SYMDIFF);
         sBOT_INTERSECT = new Id(Location(),"intersect",NULL);
-        rootSet.push_back(sBOT_INTERSECT);
         sBOT_PLUSPLUS = new Id(Location(),"++",NULL);
-        rootSet.push_back(sBOT_PLUSPLUS);
         sBOT_EQUIV = new Id(Location(),"<->",NULL);
-        rootSet.push_back(sBOT_EQUIV);
         sBOT_IMPL = new Id(Location(),"->",NULL);
-        rootSet.push_back(sBOT_IMPL);
         sBOT_RIMPL = new Id(Location(),"<-",NULL);
-        rootSet.push_back(sBOT_RIMPL);
         sBOT_OR = new Id(Location(),"\\/",NULL);
-        rootSet.push_back(sBOT_OR);
         sBOT_AND = new Id(Location(),"/\\",NULL);
-        rootSet.push_back(sBOT_AND);
         sBOT_XOR = new Id(Location(),"xor",NULL);
-        rootSet.push_back(sBOT_XOR);
         sBOT_DOTDOT = new Id(Location(),"..",NULL);
-        rootSet.push_back(sBOT_DOTDOT);
         sBOT_NOT = new Id(Location(),"not",NULL);
-        rootSet.push_back(sBOT_NOT);
-        rootSetModel->addItem(new ConstraintI(Location(), new ArrayLit(Location(),rootSet)));
       }
             
       static OpToString& o(void) {
@@ -542,6 +583,34 @@ namespace MiniZinc {
       cmb_hash(Expression::hash(_args[i]));
   }
 
+  DeclObserver*&
+  VarDecl::_observers(void) {
+#if defined(HAS_DECLSPEC_THREAD)
+    __declspec (thread) static DeclObserver* observers = NULL;
+#elif defined(HAS_ATTR_THREAD)
+    static __thread DeclObserver* observers = NULL;
+#else
+#error Need thread-local storage
+#endif
+    return observers;
+  }
+
+  DeclObserver::DeclObserver(void)
+    : _prev(NULL), _next(VarDecl::_observers()) {
+    if (_next)
+      _next->_prev = this;
+    VarDecl::_observers() = this;
+  }
+
+  DeclObserver::~DeclObserver(void) {
+    if (_prev)
+      _prev->_next = _next;
+    else
+      VarDecl::_observers() = _next;
+    if (_next)
+      _next->_prev = _prev;
+  }
+
   void
   VarDecl::rehash(void) {
     init_hash();
@@ -560,22 +629,44 @@ namespace MiniZinc {
     for (unsigned int i=_let.size(); i--;)
       cmb_hash(Expression::hash(_let[i]));
   }
-  void
-  Let::pushbindings(void) {
-    GC::mark();
-    for (unsigned int i=_let.size(); i--;) {
-      if (_let[i]->isa<VarDecl>()) {
-        VarDecl* vd = _let[i]->cast<VarDecl>();
-        GC::trail(&vd->_e,vd->e());
-        if (vd->ti()->ranges().size() > 0) {
-          GC::trail(reinterpret_cast<Expression**>(&vd->_ti),vd->ti());
-        }
-      }
+  Bindings::Bindings(void) : _size(0) {
+    GC::pushBindings(this);
+  }
+  Bindings::Bindings(Let* let) : _size(0) {
+    GC::pushBindings(this);
+    ASTExprVec<Expression> decls = let->let();
+    for (unsigned int i=0; i<decls.size(); i++) {
+      if (VarDecl* vd = decls[i]->dyn_cast<VarDecl>())
+        save(vd);
+    }
+  }
+  Bindings::~Bindings(void) {
+    for (unsigned int i=_size; i--;) {
+      const Binding& b = (*this)[i];
+      b.vd->e(b.e);
+      b.vd->ti(b.ti);
+      b.vd->flat(b.flat);
     }
+    GC::popBindings(this);
   }
   void
-  Let::popbindings(void) {
-    GC::untrail();
+  Bindings::save(VarDecl* vd) {
+    Binding b;
+    b.vd = vd;
+    b.e = vd->e();
+    b.ti = vd->ti();
+    b.flat = vd->flat();
+    if (_size < _inlineSize)
+      _inline[_size] = b;
+    else
+      _more.push_back(b);
+    _size++;
+  }
+  void
+  Bindings::bind(VarDecl* vd, Expression* e) {
+    save(vd);
+    vd->flat(vd);
+    vd->e(e);
   }
 
   void
@@ -809,15 +900,40 @@ namespace MiniZinc {
       {
         const ArrayLit* a0 = e0->cast<ArrayLit>();
         const ArrayLit* a1 = e1->cast<ArrayLit>();
-        if (a0->v().size() != a1->v().size()) return false;
+        if (a0->size() != a1->size()) return false;
         if (a0->_dims.size() != a1->_dims.size()) return false;
         for (unsigned int i=0; i<a0->_dims.size(); i++) {
           if ( a0->_dims[i] != a1->_dims[i] ) {
             return false;
           }
         }
-        for (unsigned int i=0; i<a0->v().size(); i++) {
-          if (!Expression::equal( a0->v()[i], a1->v()[i] )) {
+        if (a0->_packed && a1->_packed)
+          return a0->_packed->equal(a1->_packed);
+        if (a1->_packed)
+          std::swap(a0,a1);
+        if (const ASTParVecO* pv = a0->_packed) {
+          // Compare with the literals of a1 without materialising a0
+          for (unsigned int i=0; i<pv->size(); i++) {
+            const Expression* e = a1->_v[i];
+            switch (pv->kind()) {
+              case ASTParVecO::PV_INT:
+                if (!e->isa<IntLit>() || e->cast<IntLit>()->v() != pv->i(i))
+                  return false;
+                break;
+              case ASTParVecO::PV_FLOAT:
+                if (!e->isa<FloatLit>() || e->cast<FloatLit>()->v() != pv->f(i))
+                  return false;
+                break;
+              case ASTParVecO::PV_BOOL:
+                if (!e->isa<BoolLit>() || e->cast<BoolLit>()->v() != pv->b(i))
+                  return false;
+                break;
+            }
+          }
+          return true;
+        }
+        for (unsigned int i=0; i<a0->_v.size(); i++) {
+          if (!Expression::equal( a0->_v[i], a1->_v[i] )) {
             return false;
           }
         }
@@ -935,6 +1051,7 @@ namespace MiniZinc {
   
   Constants::Constants(void) {
     GCLock lock;
+    GCImmortal immortal;
     TypeInst* ti = new TypeInst(Location(), Type::parbool());
     lit_true = new BoolLit(Location(), true);
     var_true = new VarDecl(Location(), ti, "_bool_true", lit_true);
@@ -1068,126 +1185,11 @@ namespace MiniZinc {
     var_redef = new FunctionI(Location(),"__internal_var_redef",new TypeInst(Location(),Type::varbool()),
                               std::vector<VarDecl*>());
     
-    std::vector<Expression*> v;
-    v.push_back(ti);
-    v.push_back(lit_true);
-    v.push_back(var_true);
-    v.push_back(lit_false);
-    v.push_back(var_false);
-    v.push_back(absent);
-    v.push_back(infinity);
-    v.push_back(new StringLit(Location(),ids.forall));
-    v.push_back(new StringLit(Location(),ids.exists));
-    v.push_back(new StringLit(Location(),ids.clause));
-    v.push_back(new StringLit(Location(),ids.bool2int));
-    v.push_back(new StringLit(Location(),ids.int2float));
-    v.push_back(new StringLit(Location(),ids.bool2float));
-    v.push_back(new StringLit(Location(),ids.sum));
-    v.push_back(new StringLit(Location(),ids.lin_exp));
-    v.push_back(new StringLit(Location(),ids.element));
-    v.push_back(new StringLit(Location(),ids.show));
-    v.push_back(new StringLit(Location(),ids.output));
-    v.push_back(new StringLit(Location(),ids.fix));
-    
-    v.push_back(new StringLit(Location(),ids.int_.lin_eq));
-    v.push_back(new StringLit(Location(),ids.int_.lin_le));
-    v.push_back(new StringLit(Location(),ids.int_.lin_ne));
-    v.push_back(new StringLit(Location(),ids.int_.plus));
-    v.push_back(new StringLit(Location(),ids.int_.minus));
-    v.push_back(new StringLit(Location(),ids.int_.times));
-    v.push_back(new StringLit(Location(),ids.int_.div));
-    v.push_back(new StringLit(Location(),ids.int_.mod));
-    v.push_back(new StringLit(Location(),ids.int_.lt));
-    v.push_back(new StringLit(Location(),ids.int_.le));
-    v.push_back(new StringLit(Location(),ids.int_.gt));
-    v.push_back(new StringLit(Location(),ids.int_.ge));
-    v.push_back(new StringLit(Location(),ids.int_.eq));
-    v.push_back(new StringLit(Location(),ids.int_.ne));
-
-    v.push_back(new StringLit(Location(),ids.int_reif.lin_eq));
-    v.push_back(new StringLit(Location(),ids.int_reif.lin_le));
-    v.push_back(new StringLit(Location(),ids.int_reif.lin_ne));
-    v.push_back(new StringLit(Location(),ids.int_reif.plus));
-    v.push_back(new StringLit(Location(),ids.int_reif.minus));
-    v.push_back(new StringLit(Location(),ids.int_reif.times));
-    v.push_back(new StringLit(Location(),ids.int_reif.div));
-    v.push_back(new StringLit(Location(),ids.int_reif.mod));
-    v.push_back(new StringLit(Location(),ids.int_reif.lt));
-    v.push_back(new StringLit(Location(),ids.int_reif.le));
-    v.push_back(new StringLit(Location(),ids.int_reif.gt));
-    v.push_back(new StringLit(Location(),ids.int_reif.ge));
-    v.push_back(new StringLit(Location(),ids.int_reif.eq));
-    v.push_back(new StringLit(Location(),ids.int_reif.ne));
-
-    v.push_back(new StringLit(Location(),ids.float_.lin_eq));
-    v.push_back(new StringLit(Location(),ids.float_.lin_le));
-    v.push_back(new StringLit(Location(),ids.float_.lin_lt));
-    v.push_back(new StringLit(Location(),ids.float_.lin_ne));
-    v.push_back(new StringLit(Location(),ids.float_.plus));
-    v.push_back(new StringLit(Location(),ids.float_.minus));
-    v.push_back(new StringLit(Location(),ids.float_.times));
-    v.push_back(new StringLit(Location(),ids.float_.div));
-    v.push_back(new StringLit(Location(),ids.float_.mod));
-    v.push_back(new StringLit(Location(),ids.float_.lt));
-    v.push_back(new StringLit(Location(),ids.float_.le));
-    v.push_back(new StringLit(Location(),ids.float_.gt));
-    v.push_back(new StringLit(Location(),ids.float_.ge));
-    v.push_back(new StringLit(Location(),ids.float_.eq));
-    v.push_back(new StringLit(Location(),ids.float_.ne));
-
-    v.push_back(new StringLit(Location(),ids.float_reif.lin_eq));
-    v.push_back(new StringLit(Location(),ids.float_reif.lin_le));
-    v.push_back(new StringLit(Location(),ids.float_reif.lin_lt));
-    v.push_back(new StringLit(Location(),ids.float_reif.lin_ne));
-    v.push_back(new StringLit(Location(),ids.float_reif.plus));
-    v.push_back(new StringLit(Location(),ids.float_reif.minus));
-    v.push_back(new StringLit(Location(),ids.float_reif.times));
-    v.push_back(new StringLit(Location(),ids.float_reif.div));
-    v.push_back(new StringLit(Location(),ids.float_reif.mod));
-    v.push_back(new StringLit(Location(),ids.float_reif.lt));
-    v.push_back(new StringLit(Location(),ids.float_reif.le));
-    v.push_back(new StringLit(Location(),ids.float_reif.gt));
-    v.push_back(new StringLit(Location(),ids.float_reif.ge));
-    v.push_back(new StringLit(Location(),ids.float_reif.eq));
-    v.push_back(new StringLit(Location(),ids.float_reif.ne));
-
-    v.push_back(new StringLit(Location(),ids.bool_eq));
-    v.push_back(new StringLit(Location(),ids.bool_eq_reif));
-    v.push_back(new StringLit(Location(),ids.bool_clause));
-    v.push_back(new StringLit(Location(),ids.bool_clause_reif));
-    v.push_back(new StringLit(Location(),ids.bool_xor));
-    v.push_back(new StringLit(Location(),ids.array_bool_or));
-    v.push_back(new StringLit(Location(),ids.array_bool_and));
-    v.push_back(new StringLit(Location(),ids.set_eq));
-    v.push_back(new StringLit(Location(),ids.set_in));
-    v.push_back(new StringLit(Location(),ids.set_card));
-
-    v.push_back(new StringLit(Location(),ids.assert));
-    v.push_back(new StringLit(Location(),ids.trace));
-    v.push_back(new StringLit(Location(),ids.introduced_var));
-    v.push_back(ctx.root);
-    v.push_back(ctx.pos);
-    v.push_back(ctx.neg);
-    v.push_back(ctx.mix);
-    v.push_back(ann.output_var);
-    v.push_back(new StringLit(Location(),ann.output_array));
-    v.push_back(ann.is_defined_var);
-    v.push_back(new StringLit(Location(),ann.defines_var));
-    v.push_back(ann.is_reverse_map);
-    v.push_back(ann.promise_total);
-    v.push_back(new StringLit(Location(),ann.doc_comment));
-    v.push_back(new StringLit(Location(), ann.is_introduced));
-    
-    
     std::vector<Expression*> v_ints(maxConstInt*2+1);
     for (int i=-maxConstInt; i<=maxConstInt; i++)
       v_ints[i+maxConstInt] = new IntLit(Location().introduce(), i);
     integers = new ArrayLit(Location().introduce(), v_ints);
     
-    m = new Model();
-    m->addItem(new ConstraintI(Location(),new ArrayLit(Location(),v)));
-    m->addItem(new ConstraintI(Location(),integers));
-    m->addItem(var_redef);
   }
   
   const int Constants::maxConstInt;
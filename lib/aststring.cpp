@@ -22,19 +22,23 @@ namespace {
 
 namespace MiniZinc {
 
-  ASTStringO::ASTStringO(const std::string& s)
+  ASTStringO::ASTStringO(const std::string& s, size_t h)
     : ASTChunk(s.size()+sizeof(size_t)+1) {
     memcpy_s(_data+sizeof(size_t),s.size()+1,s.c_str(),s.size());
     *(_data+sizeof(size_t)+s.size())=0;
-    HASH_NAMESPACE::hash<std::string> h;
-    reinterpret_cast<size_t*>(_data)[0] = h(s);
+    reinterpret_cast<size_t*>(_data)[0] = h;
   }
 
   ASTStringO*
   ASTStringO::a(const std::string& s) {
+    HASH_NAMESPACE::hash<std::string> hs;
+    size_t h = hs(s);
+    if (ASTStringO* as = GC::findString(s.c_str(), s.size(), h))
+      return as;
     ASTStringO* as =
       static_cast<ASTStringO*>(alloc(1+sizeof(size_t)+s.size()));
-    new (as) ASTStringO(s);
+    new (as) ASTStringO(s,h);
+    GC::internString(as);
     return as;
   }
   
@@ -11,6 +11,8 @@
 
 #include <minizinc/astvec.hh>
 
+#include <cstring>
+
 namespace MiniZinc {
 
   ASTIntVecO::ASTIntVecO(const std::vector<int>& v)
@@ -25,5 +27,60 @@ namespace MiniZinc {
     new (ao) ASTIntVecO(v);
     return ao;
   }
+
+  size_t
+  ASTParVecO::bytes(Kind k, unsigned int n) {
+    switch (k) {
+    case PV_INT: return sizeof(long long int)*n;
+    case PV_FLOAT: return sizeof(double)*n;
+    case PV_BOOL: return (n+7)/8;
+    }
+    assert(false);
+    return 0;
+  }
+  
+  ASTParVecO::ASTParVecO(Kind k, unsigned int n)
+    : ASTChunk(sizeof(Header)+bytes(k,n)) {
+    header().kind = k;
+    header().n = n;
+    std::memset(values(),0,bytes(k,n));
+  }
+  
+  ASTParVecO*
+  ASTParVecO::a(Kind k, unsigned int n) {
+    size_t s = sizeof(Header)+bytes(k,n);
+    ASTParVecO* ao = static_cast<ASTParVecO*>(alloc(s));
+    new (ao) ASTParVecO(k,n);
+    return ao;
+  }
+  
+  unsigned int
+  ASTParVecO::count(void) const {
+    assert(kind()==PV_BOOL);
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(values());
+    unsigned int c = 0;
+    for (unsigned int j=bytes(kind(),size()); j--;) {
+#if defined(__GNUC__)
+      c += __builtin_popcount(b[j]);
+#else
+      for (unsigned char x = b[j]; x != 0; x &= x-1)
+        c++;
+#endif
+    }
+    return c;
+  }
+
+  bool
+  ASTParVecO::equal(const ASTParVecO* v) const {
+    if (kind() != v->kind() || size() != v->size())
+      return false;
+    if (kind()==PV_FLOAT) {
+      for (unsigned int j=size(); j--;)
+        if (f(j) != v->f(j))
+          return false;
+      return true;
+    }
+    return std::memcmp(values(),v->values(),bytes(kind(),size()))==0;
+  }
   
 }
\ No newline at end of file
@@ -17,6 +17,8 @@
 #include <minizinc/prettyprinter.hh>
 #include <minizinc/flatten_internal.hh>
 #include <minizinc/file_utils.hh>
+#include <minizinc/parser.hh>
+#include <minizinc/typecheck.hh>
 
 #include <iomanip>
 #include <climits>
@@ -25,11 +27,13 @@
 
 namespace MiniZinc {
   
+  /// Register builtin \a b for \a id (frozen library functions already have theirs)
   void rb(EnvI& env, Model* m, const ASTString& id, const std::vector<Type>& t,
           FunctionI::builtin_e b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.e = b;
+      if (!fi->immortal())
+        fi->_builtins.e = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
@@ -38,7 +42,8 @@ namespace MiniZinc {
           FunctionI::builtin_f b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.f = b;
+      if (!fi->immortal())
+        fi->_builtins.f = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
@@ -47,7 +52,8 @@ namespace MiniZinc {
           FunctionI::builtin_i b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.i = b;
+      if (!fi->immortal())
+        fi->_builtins.i = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
@@ -56,7 +62,8 @@ namespace MiniZinc {
           FunctionI::builtin_b b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.b = b;
+      if (!fi->immortal())
+        fi->_builtins.b = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
@@ -65,7 +72,8 @@ namespace MiniZinc {
           FunctionI::builtin_s b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.s = b;
+      if (!fi->immortal())
+        fi->_builtins.s = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
@@ -74,12 +82,127 @@ namespace MiniZinc {
           FunctionI::builtin_str b) {
     FunctionI* fi = m->matchFn(env,id,t);
     if (fi) {
-      fi->_builtins.str = b;
+      if (!fi->immortal())
+        fi->_builtins.str = b;
     } else {
       throw InternalError("no definition found for builtin "+id.str());
     }
   }
 
+  /**
+   * \brief Return the values of par integer array \a al
+   *
+   * Packed arrays are read in place, arrays of integer literals are
+   * copied into \a buf. Returns NULL if \a al is empty or contains
+   * an element that is not a literal.
+   */
+  const long long int* par_int_values(ArrayLit* al,
+                                      std::vector<long long int>& buf) {
+    if (ASTParVecO* pv = al->packed())
+      return pv->kind()==ASTParVecO::PV_INT ? pv->ints() : NULL;
+    ASTExprVec<Expression> v = al->v();
+    if (v.size()==0)
+      return NULL;
+    buf.resize(v.size());
+    for (unsigned int i=v.size(); i--;) {
+      IntLit* il = v[i]->dyn_cast<IntLit>();
+      if (il==NULL || !il->v().isFinite())
+        return NULL;
+      buf[i] = il->v().toInt();
+    }
+    return &buf[0];
+  }
+
+  /// Return the values of par float array \a al (see par_int_values)
+  const double* par_float_values(ArrayLit* al, std::vector<double>& buf) {
+    if (ASTParVecO* pv = al->packed())
+      return pv->kind()==ASTParVecO::PV_FLOAT ? pv->floats() : NULL;
+    ASTExprVec<Expression> v = al->v();
+    if (v.size()==0)
+      return NULL;
+    buf.resize(v.size());
+    for (unsigned int i=v.size(); i--;) {
+      FloatLit* fl = v[i]->dyn_cast<FloatLit>();
+      if (fl==NULL)
+        return NULL;
+      buf[i] = fl->v();
+    }
+    return &buf[0];
+  }
+
+  /// Number of integers summed between two overflow checks
+  const unsigned int sumBlockSize = 1024;
+
+  /// Return sum of the \a n integers in \a x
+  IntVal sum_ints(const long long int* x, unsigned int n) {
+    // Sums of a block of values within these bounds cannot overflow
+    const long long int bound = (LLONG_MAX-1) / sumBlockSize;
+    IntVal s = 0;
+    for (unsigned int b=0; b<n; b+=sumBlockSize) {
+      unsigned int e = std::min(n,b+sumBlockSize);
+      long long int lo = x[b];
+      long long int hi = x[b];
+      for (unsigned int i=b+1; i<e; i++) {
+        lo = x[i] < lo ? x[i] : lo;
+        hi = x[i] > hi ? x[i] : hi;
+      }
+      if (lo >= -bound && hi <= bound) {
+        long long int bs = 0;
+        for (unsigned int i=b; i<e; i++)
+          bs += x[i];
+        s += bs;
+      } else {
+        for (unsigned int i=b; i<e; i++)
+          s += x[i];
+      }
+    }
+    return s;
+  }
+
+  /// Return minimum of the \a n > 0 integers in \a x
+  long long int min_ints(const long long int* x, unsigned int n) {
+    long long int m = x[0];
+    for (unsigned int i=1; i<n; i++)
+      m = x[i] < m ? x[i] : m;
+    return m;
+  }
+
+  /// Return maximum of the \a n > 0 integers in \a x
+  long long int max_ints(const long long int* x, unsigned int n) {
+    long long int m = x[0];
+    for (unsigned int i=1; i<n; i++)
+      m = x[i] > m ? x[i] : m;
+    return m;
+  }
+
+  /**
+   * \brief Return whether Boolean array \a al contains \a b
+   *
+   * Sets \a known to false if \a al has elements that are not literals.
+   */
+  bool par_bool_contains(ArrayLit* al, bool b, bool& known) {
+    known = true;
+    if (ASTParVecO* pv = al->packed()) {
+      if (pv->kind()==ASTParVecO::PV_BOOL) {
+        unsigned int c = pv->count();
+        return b ? c > 0 : c < pv->size();
+      }
+      known = false;
+      return false;
+    }
+    ASTExprVec<Expression> v = al->v();
+    bool found = false;
+    for (unsigned int i=v.size(); i--;) {
+      BoolLit* bl = v[i]->dyn_cast<BoolLit>();
+      if (bl==NULL) {
+        known = false;
+        return false;
+      }
+      found = found || bl->v()==b;
+    }
+    return found;
+  }
+
   IntVal b_int_min(EnvI& env, Call* call) {
     ASTExprVec<Expression> args = call->args();
     switch (args.size()) {
@@ -89,8 +212,11 @@ namespace MiniZinc {
       } else {
         GCLock lock;
         ArrayLit* al = eval_array_lit(env,args[0]);
-        if (al->v().size()==0)
+        if (al->size()==0)
           throw EvalError(env, al->loc(), "Array is empty");
+        std::vector<long long int> buf;
+        if (const long long int* x = par_int_values(al,buf))
+          return min_ints(x,al->size());
         IntVal m = eval_int(env,al->v()[0]);
         for (unsigned int i=1; i<al->v().size(); i++)
           m = std::min(m, eval_int(env,al->v()[i]));
@@ -114,8 +240,11 @@ namespace MiniZinc {
       } else {
         GCLock lock;
         ArrayLit* al = eval_array_lit(env,args[0]);
-        if (al->v().size()==0)
+        if (al->size()==0)
           throw EvalError(env, al->loc(), "Array is empty");
+        std::vector<long long int> buf;
+        if (const long long int* x = par_int_values(al,buf))
+          return max_ints(x,al->size());
         IntVal m = eval_int(env,al->v()[0]);
         for (unsigned int i=1; i<al->v().size(); i++)
           m = std::max(m, eval_int(env,al->v()[i]));
@@ -376,8 +505,11 @@ namespace MiniZinc {
     assert(args.size()==1);
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
-    if (al->v().size()==0)
+    if (al->size()==0)
       return 0;
+    std::vector<long long int> buf;
+    if (const long long int* x = par_int_values(al,buf))
+      return sum_ints(x,al->size());
     IntVal m = 0;
     for (unsigned int i=0; i<al->v().size(); i++)
       m += eval_int(env,al->v()[i]);
@@ -389,9 +521,15 @@ namespace MiniZinc {
     assert(args.size()==1);
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
-    if (al->v().size()==0)
+    if (al->size()==0)
       return 1;
     IntVal m = 1;
+    std::vector<long long int> buf;
+    if (const long long int* x = par_int_values(al,buf)) {
+      for (unsigned int i=0; i<al->size() && m != 0; i++)
+        m *= x[i];
+      return m;
+    }
     for (unsigned int i=0; i<al->v().size(); i++)
       m *= eval_int(env,al->v()[i]);
     return m;
@@ -402,9 +540,15 @@ namespace MiniZinc {
     assert(args.size()==1);
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
-    if (al->v().size()==0)
+    if (al->size()==0)
       return 1;
     FloatVal m = 1.0;
+    std::vector<double> buf;
+    if (const double* x = par_float_values(al,buf)) {
+      for (unsigned int i=0; i<al->size(); i++)
+        m *= x[i];
+      return m;
+    }
     for (unsigned int i=0; i<al->v().size(); i++)
       m *= eval_float(env,al->v()[i]);
     return m;
@@ -545,9 +689,15 @@ namespace MiniZinc {
     assert(args.size()==1);
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
-    if (al->v().size()==0)
+    if (al->size()==0)
       return 0;
     FloatVal m = 0;
+    std::vector<double> buf;
+    if (const double* x = par_float_values(al,buf)) {
+      for (unsigned int i=0; i<al->size(); i++)
+        m += x[i];
+      return m;
+    }
     for (unsigned int i=0; i<al->v().size(); i++)
       m += eval_float(env,al->v()[i]);
     return m;
@@ -562,8 +712,15 @@ namespace MiniZinc {
         } else {
           GCLock lock;
           ArrayLit* al = eval_array_lit(env,args[0]);
-          if (al->v().size()==0)
+          if (al->size()==0)
             throw EvalError(env, al->loc(), "min on empty array undefined");
+          std::vector<double> buf;
+          if (const double* x = par_float_values(al,buf)) {
+            FloatVal m = x[0];
+            for (unsigned int i=1; i<al->size(); i++)
+              m = x[i] < m ? x[i] : m;
+            return m;
+          }
           FloatVal m = eval_float(env,al->v()[0]);
           for (unsigned int i=1; i<al->v().size(); i++)
             m = std::min(m, eval_float(env,al->v()[i]));
@@ -587,8 +744,15 @@ namespace MiniZinc {
         } else {
           GCLock lock;
           ArrayLit* al = eval_array_lit(env,args[0]);
-          if (al->v().size()==0)
+          if (al->size()==0)
             throw EvalError(env, al->loc(), "max on empty array undefined");
+          std::vector<double> buf;
+          if (const double* x = par_float_values(al,buf)) {
+            FloatVal m = x[0];
+            for (unsigned int i=1; i<al->size(); i++)
+              m = x[i] > m ? x[i] : m;
+            return m;
+          }
           FloatVal m = eval_float(env,al->v()[0]);
           for (unsigned int i=1; i<al->v().size(); i++)
             m = std::max(m, eval_float(env,al->v()[i]));
@@ -739,10 +903,7 @@ namespace MiniZinc {
       throw EvalError(env, Location(), "upper bound of empty array undefined");
     IntSetVal* ub = b_ub_set(env,al->v()[0]);
     for (unsigned int i=1; i<al->v().size(); i++) {
-      IntSetRanges isr(ub);
-      IntSetRanges r(b_ub_set(env,al->v()[i]));
-      Ranges::Union<IntSetRanges,IntSetRanges> u(isr,r);
-      ub = IntSetVal::ai(u);
+      ub = IntSetVal::unite(ub,b_ub_set(env,al->v()[i]));
     }
     return ub;
   }
@@ -878,10 +1039,7 @@ namespace MiniZinc {
       return IntSetVal::a();
     IntSetVal* isv = b_dom_varint(env,al->v()[0]);
     for (unsigned int i=1; i<al->v().size(); i++) {
-      IntSetRanges isr(isv);
-      IntSetRanges r(b_dom_varint(env,al->v()[i]));
-      Ranges::Union<IntSetRanges,IntSetRanges> u(isr,r);
-      isv = IntSetVal::ai(u);
+      isv = IntSetVal::unite(isv,b_dom_varint(env,al->v()[i]));
     }
     return isv;
   }
@@ -945,9 +1103,10 @@ namespace MiniZinc {
         dim1d *= dims[i].second-dims[i].first+1;
       }
     }
-    if (dim1d != al->v().size())
+    if (dim1d != al->size())
       throw EvalError(env, al->loc(), "mismatch in array dimensions");
-    ArrayLit* ret = new ArrayLit(al->loc(), al->v(), dims);
+    ArrayLit* ret = al->packed() ? new ArrayLit(al->loc(), al->packed(), dims)
+                                 : new ArrayLit(al->loc(), al->v(), dims);
     Type t = al->type();
     t.dim(d);
     ret->type(t);
@@ -961,7 +1120,14 @@ namespace MiniZinc {
     if (al->dims()==1 && al->min(0)==1) {
       return args[0]->isa<Id>() ? args[0] : al;
     }
-    ArrayLit* ret = new ArrayLit(al->loc(), al->v());
+    ArrayLit* ret;
+    if (al->packed()) {
+      std::vector<std::pair<int,int> > dims(1);
+      dims[0] = std::pair<int,int>(1,al->size());
+      ret = new ArrayLit(al->loc(), al->packed(), dims);
+    } else {
+      ret = new ArrayLit(al->loc(), al->v());
+    }
     Type t = al->type();
     t.dim(1);
     ret->type(t);
@@ -1039,6 +1205,10 @@ namespace MiniZinc {
       throw EvalError(env, Location(), "forall needs exactly one argument");
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
+    bool known;
+    bool hasFalse = par_bool_contains(al,false,known);
+    if (known)
+      return !hasFalse;
     for (unsigned int i=al->v().size(); i--;)
       if (!eval_bool(env,al->v()[i]))
         return false;
@@ -1050,6 +1220,10 @@ namespace MiniZinc {
       throw EvalError(env, Location(), "exists needs exactly one argument");
     GCLock lock;
     ArrayLit* al = eval_array_lit(env,args[0]);
+    bool known;
+    bool hasTrue = par_bool_contains(al,true,known);
+    if (known)
+      return hasTrue;
     for (unsigned int i=al->v().size(); i--;)
       if (eval_bool(env,al->v()[i]))
         return true;
@@ -1506,14 +1680,30 @@ namespace MiniZinc {
     ArrayLit* al = eval_array_lit(env,args[0]);
     if (al->v().size()==0)
       return IntSetVal::a();
-    IntSetVal* isv = eval_intset(env,al->v()[0]);
+    if (al->v().size()==1)
+      return eval_intset(env,al->v()[0]);
+    // Sort the ranges of all sets by lower bound and merge them in one pass
+    std::vector<IntSetVal::Range> ranges;
     for (unsigned int i=0; i<al->v().size(); i++) {
-      IntSetRanges i0(isv);
-      IntSetRanges i1(eval_intset(env,al->v()[i]));
-      Ranges::Union<IntSetRanges, IntSetRanges> u(i0,i1);
-      isv = IntSetVal::ai(u);
+      IntSetVal* isv = eval_intset(env,al->v()[i]);
+      for (int j=0; j<isv->size(); j++)
+        ranges.push_back(IntSetVal::Range(isv->min(j),isv->max(j)));
     }
-    return isv;
+    struct RangeOrd {
+      bool operator()(const IntSetVal::Range& r0, const IntSetVal::Range& r1) const {
+        return r0.min < r1.min;
+      }
+    } _ord;
+    std::sort(ranges.begin(),ranges.end(),_ord);
+    std::vector<IntSetVal::Range> merged;
+    for (unsigned int i=0; i<ranges.size(); i++) {
+      if (!merged.empty() && ranges[i].min <= merged.back().max.plus(1)) {
+        merged.back().max = std::max(merged.back().max,ranges[i].max);
+      } else {
+        merged.push_back(ranges[i]);
+      }
+    }
+    return IntSetVal::a(merged);
   }
   
   IntSetVal* b_array_intersect(EnvI& env, Call* call) {
@@ -1621,6 +1811,20 @@ namespace MiniZinc {
     ASTExprVec<Expression> args = call->args();
     assert(args.size()==1);
     ArrayLit* al = eval_array_lit(env,args[0]);
+    if (al->type().bt()==Type::BT_INT) {
+      std::vector<long long int> buf;
+      if (const long long int* x = par_int_values(al,buf)) {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_INT,al->size());
+        for (unsigned int i=al->size(); i--;)
+          pv->i(i) = x[i];
+        std::sort(&pv->i(0),&pv->i(0)+pv->size());
+        std::vector<std::pair<int,int> > dims(1);
+        dims[0] = std::pair<int,int>(1,pv->size());
+        ArrayLit* al_sorted = new ArrayLit(al->loc(), pv, dims);
+        al_sorted->type(al->type());
+        return al_sorted;
+      }
+    }
     std::vector<Expression*> sorted(al->v().size());
     for (unsigned int i=sorted.size(); i--;)
       sorted[i] = al->v()[i];
@@ -1642,12 +1846,6 @@ namespace MiniZinc {
     return al_sorted;
   }
   
-  std::default_random_engine& rnd_generator(void) {
-    // TODO: initiate with seed if given as annotation/in command line
-    static std::default_random_engine g;
-    return g;
-  }
-
   FloatVal b_normal_float_float(EnvI& env, Call* call) {
     ASTExprVec<Expression> args = call->args();
     assert(args.size() ==2);
@@ -1655,7 +1853,7 @@ namespace MiniZinc {
     const double stdv = eval_float(env,args[1]);
     std::normal_distribution<double> distribution(mean,stdv);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_normal_int_float(EnvI& env, Call* call) {
@@ -1665,7 +1863,7 @@ namespace MiniZinc {
     const double stdv = double(eval_int(env,args[1]).toInt());
     std::normal_distribution<double> distribution(mean,stdv);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_uniform_float(EnvI& env, Call* call) {
@@ -1680,7 +1878,7 @@ namespace MiniZinc {
     }
     std::uniform_real_distribution<double> distribution(lb,ub);
     // return a sample from the distribution
-    return distribution(rnd_generator());   
+    return distribution(env.rnd_generator);   
   }
   
   IntVal b_uniform_int(EnvI& env, Call* call) {
@@ -1695,7 +1893,7 @@ namespace MiniZinc {
     }
     std::uniform_int_distribution<long long int> distribution(lb,ub);
     // return a sample from the distribution
-    return IntVal(distribution(rnd_generator()));
+    return IntVal(distribution(env.rnd_generator));
   }
   
   IntVal b_poisson_int(EnvI& env, Call* call) {
@@ -1704,7 +1902,7 @@ namespace MiniZinc {
     long long int mean = eval_int(env,args[0]).toInt();
     std::poisson_distribution<long long int> distribution(mean);
     // return a sample from the distribution
-    return IntVal(distribution(rnd_generator()));  
+    return IntVal(distribution(env.rnd_generator));  
   }
   
   IntVal b_poisson_float(EnvI& env, Call* call) {
@@ -1713,7 +1911,7 @@ namespace MiniZinc {
     double mean = eval_float(env,args[0]);
     std::poisson_distribution<long long int> distribution(mean);
     // return a sample from the distribution
-    return IntVal(distribution(rnd_generator())); 
+    return IntVal(distribution(env.rnd_generator)); 
   }
 
   FloatVal b_gamma_float_float(EnvI& env, Call* call) {
@@ -1723,7 +1921,7 @@ namespace MiniZinc {
     const double beta = eval_float(env,args[1]);
     std::gamma_distribution<double> distribution(alpha,beta);
     // return a sample from the distribution
-    return distribution(rnd_generator());     
+    return distribution(env.rnd_generator);     
   }
   
   FloatVal b_gamma_int_float(EnvI& env, Call* call) {
@@ -1733,7 +1931,7 @@ namespace MiniZinc {
     const double beta = eval_float(env,args[1]);
     std::gamma_distribution<double> distribution(alpha,beta);
     // return a sample from the distribution
-    return distribution(rnd_generator());   
+    return distribution(env.rnd_generator);   
   }
   
   FloatVal b_weibull_int_float(EnvI& env, Call* call) {
@@ -1755,7 +1953,7 @@ namespace MiniZinc {
     }
     std::weibull_distribution<double> distribution(shape, scale);
     // return a sample from the distribution
-    return distribution(rnd_generator());  
+    return distribution(env.rnd_generator);  
   }
   
   FloatVal b_weibull_float_float(EnvI& env, Call* call) {
@@ -1777,7 +1975,7 @@ namespace MiniZinc {
     }
     std::weibull_distribution<double> distribution(shape, scale);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_exponential_float(EnvI& env, Call* call) {
@@ -1792,7 +1990,7 @@ namespace MiniZinc {
     }
     std::exponential_distribution<double> distribution(lambda);
     // return a sample from the distribution
-    return distribution(rnd_generator());     
+    return distribution(env.rnd_generator);     
   }
   
   FloatVal b_exponential_int(EnvI& env, Call* call) {
@@ -1807,7 +2005,7 @@ namespace MiniZinc {
     }      
     std::exponential_distribution<double> distribution(lambda);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_lognormal_float_float(EnvI& env, Call* call) {
@@ -1817,7 +2015,7 @@ namespace MiniZinc {
     const double stdv = eval_float(env,args[1]);
     std::lognormal_distribution<double> distribution(mean,stdv);
     // return a sample from the distribution
-    return distribution(rnd_generator()); 
+    return distribution(env.rnd_generator); 
   }
   
   FloatVal b_lognormal_int_float(EnvI& env, Call* call) {
@@ -1827,7 +2025,7 @@ namespace MiniZinc {
     const double stdv = eval_float(env,args[1]);
     std::lognormal_distribution<double> distribution(mean,stdv);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_chisquared_float(EnvI& env, Call* call) {
@@ -1836,7 +2034,7 @@ namespace MiniZinc {
     const double lambda = eval_float(env,args[0]);
     std::exponential_distribution<double> distribution(lambda);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_chisquared_int(EnvI& env, Call* call) {
@@ -1845,7 +2043,7 @@ namespace MiniZinc {
     const double lambda = double(eval_int(env,args[0]).toInt());
     std::exponential_distribution<double> distribution(lambda);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_cauchy_float_float(EnvI& env, Call* call) {
@@ -1855,7 +2053,7 @@ namespace MiniZinc {
     const double scale = eval_float(env,args[1]);
     std::cauchy_distribution<double> distribution(mean,scale);
     // return a sample from the distribution
-    return distribution(rnd_generator());   
+    return distribution(env.rnd_generator);   
   }
   
   FloatVal b_cauchy_int_float(EnvI& env, Call* call) {
@@ -1865,7 +2063,7 @@ namespace MiniZinc {
     const double scale = eval_float(env,args[1]);
     std::cauchy_distribution<double> distribution(mean,scale);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_fdistribution_float_float(EnvI& env, Call* call) {
@@ -1875,7 +2073,7 @@ namespace MiniZinc {
     const double d2 = eval_float(env,args[1]);
     std::fisher_f_distribution<double> distribution(d1,d2);
     // return a sample from the distribution
-    return distribution(rnd_generator());    
+    return distribution(env.rnd_generator);    
   }  
   
   FloatVal b_fdistribution_int_int(EnvI& env, Call* call) {
@@ -1885,7 +2083,7 @@ namespace MiniZinc {
     const double d2 = double(eval_int(env,args[1]).toInt());
     std::fisher_f_distribution<double> distribution(d1,d2);
     // return a sample from the distribution
-    return distribution(rnd_generator());   
+    return distribution(env.rnd_generator);   
   }  
   
   FloatVal b_tdistribution_float(EnvI& env, Call* call) {
@@ -1894,7 +2092,7 @@ namespace MiniZinc {
     const double sampleSize = eval_float(env,args[0]);
     std::student_t_distribution<double> distribution(sampleSize);
     // return a sample from the distribution
-    return distribution(rnd_generator());
+    return distribution(env.rnd_generator);
   }
   
   FloatVal b_tdistribution_int(EnvI& env, Call* call) {
@@ -1903,7 +2101,7 @@ namespace MiniZinc {
     const double sampleSize = double(eval_int(env,args[0]).toInt());
     std::student_t_distribution<double> distribution(sampleSize);
     // return a sample from the distribution
-    return distribution(rnd_generator());   
+    return distribution(env.rnd_generator);   
   }
   
   IntVal b_discrete_distribution(EnvI& env, Call* call) {
@@ -1929,7 +2127,7 @@ namespace MiniZinc {
     std::discrete_distribution<long long int> distribution(weights.begin(), weights.end());
 #endif
     // return a sample from the distribution
-    IntVal iv = IntVal(distribution(rnd_generator()));
+    IntVal iv = IntVal(distribution(env.rnd_generator));
     return iv;         
   }
 
@@ -1939,7 +2137,7 @@ namespace MiniZinc {
     const double p = eval_float(env,args[0]);
     std::bernoulli_distribution distribution(p);
     // return a sample from the distribution
-    return distribution(rnd_generator());         
+    return distribution(env.rnd_generator);         
   }
   
   IntVal b_binomial(EnvI& env, Call* call) {
@@ -1949,7 +2147,7 @@ namespace MiniZinc {
     double p = eval_float(env,args[1]);
     std::binomial_distribution<long long int> distribution(t,p);
     // return a sample from the distribution
-    return IntVal(distribution(rnd_generator()));    
+    return IntVal(distribution(env.rnd_generator));    
   }  
   
   FloatVal b_atan(EnvI& env, Call* call) {
@@ -2656,7 +2854,35 @@ namespace MiniZinc {
       rb(env, m, ASTString("binomial"),t,b_binomial);  
     }    
   }
-  
-}
 
+  Model* parseLibrary(const std::vector<std::string>& includes,
+                      const std::vector<std::string>& includePaths,
+                      std::ostream& err) {
+    GCLock lock;
+    Model* m;
+    {
+      GCImmortal immortal;
+      std::string text;
+      for (unsigned int i=0; i<includes.size(); i++)
+        text += "include \""+includes[i]+"\";\n";
+      m = parseFromString(text, "library.mzn", includePaths, false, false, false, err);
+      if (m==NULL)
+        return NULL;
+      Env env(m);
+      std::vector<TypeError> typeErrors;
+      typecheck(env, m, typeErrors);
+      if (!typeErrors.empty()) {
+        for (unsigned int i=0; i<typeErrors.size(); i++) {
+          err << typeErrors[i].loc() << ":" << std::endl;
+          err << typeErrors[i].what() << ": " << typeErrors[i].msg() << std::endl;
+        }
+        delete m;
+        return NULL;
+      }
+      registerBuiltins(env, m);
+    }
+    m->freeze();
+    return m;
+  }
 
+}
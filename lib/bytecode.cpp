@@ -0,0 +1,1162 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/bytecode.hh>
+#include <minizinc/eval_par.hh>
+#include <minizinc/astiterator.hh>
+#include <minizinc/flatten_internal.hh>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__)
+/// Use computed gotos for instruction dispatch
+#define MZN_BC_THREADED
+#endif
+
+namespace MiniZinc {
+
+  /// Applies \a X to the name of every bytecode instruction
+#define MZN_BC_OPS(X) \
+  X(LOADK) X(MOV) X(LOADID) X(EVAL) X(ALOAD) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(NEG) X(ABS) X(MIN) X(MAX) \
+  X(NOT) X(AND) X(OR) X(EQ) X(NE) X(LT) X(LE) X(INSET) \
+  X(JMP) X(JF) X(JT) \
+  X(RANGE) X(SETEVAL) X(ARREVAL) X(ITER) X(NEXT) \
+  X(CALL) X(EMIT) X(CHKRANGE) X(CHKSET) X(FAIL) X(RET)
+
+  /**
+   * \brief Register-based bytecode for a par int or bool expression
+   *
+   * A program runs on a frame of integer registers (Booleans are stored
+   * as 0 and 1) and iteration slots that hold the ranges or elements
+   * a generator iterates over. For a function body, the first registers
+   * hold the parameters. Sub-expressions that cannot be compiled but do
+   * not depend on any register are evaluated by the tree-walking
+   * evaluator (instruction EVAL and friends).
+   */
+  class ParBytecode {
+  public:
+    /// Instruction codes
+    enum Op {
+#define MZN_BC_ENUM(op) OP_##op,
+      MZN_BC_OPS(MZN_BC_ENUM)
+#undef MZN_BC_ENUM
+      OP_END
+    };
+    /// A single instruction
+    struct Instr {
+      /// Instruction code
+      int op;
+      /// Register or jump target operands
+      int a, b, c;
+      union {
+        /// Constant or iteration slot
+        long long int k;
+        /// Expression the instruction refers to
+        Expression* e;
+      };
+    };
+    /// The instructions
+    std::vector<Instr> code;
+    /// Whether each function parameter is passed in a register
+    std::vector<bool> regParam;
+    /// Number of parameters that are bound like in the tree-walking evaluator
+    int nbound;
+    /// Number of registers
+    int nregs;
+    /// Number of iteration slots
+    int nslots;
+    /// Constructor
+    ParBytecode(void) : nbound(0), nregs(0), nslots(0) {}
+  };
+
+  ParBytecode* function_bytecode(FunctionI* fi);
+
+  void bytecode_delete(ParBytecode* bc) {
+    delete bc;
+  }
+
+  BytecodeDisabler::BytecodeDisabler(EnvI& env) : _env(env) {
+    _env.bytecode_disabled++;
+  }
+  BytecodeDisabler::~BytecodeDisabler(void) {
+    _env.bytecode_disabled--;
+  }
+
+  namespace {
+
+    /// Whether values of type \a t can be held in a register
+    bool scalar(const Type& t) {
+      return t.ispar() && !t.isopt() && (t.isint() || t.isbool());
+    }
+
+    /// Thrown to abandon the execution of bytecode
+    class BytecodeAbort : public Exception {
+    public:
+      BytecodeAbort(void) : Exception("bytecode execution abandoned") {}
+      ~BytecodeAbort(void) throw() {}
+      virtual const char* what(void) const throw() {
+        return "MiniZinc: bytecode error";
+      }
+    };
+
+    /// Values a generator iterates over
+    struct IterSlot {
+      /// Whether \a v holds pairs of range bounds (otherwise elements)
+      bool ranges;
+      /// Range bounds or elements
+      std::vector<IntVal> v;
+    };
+
+    /// Return the value identifier \a id is currently bound to (or NULL)
+    Expression* bound_value(Id* id) {
+      VarDecl* vd = id->decl();
+      if (vd==NULL)
+        return NULL;
+      while (vd->flat() && vd->flat() != vd)
+        vd = vd->flat();
+      return vd->e();
+    }
+
+    /// Evaluate par int or bool identifier \a id
+    IntVal load_id(EnvI& env, Id* id) {
+      if (Expression* v = bound_value(id)) {
+        if (v->isa<IntLit>())
+          return v->cast<IntLit>()->v();
+        if (v->isa<BoolLit>())
+          return v->cast<BoolLit>()->v();
+      }
+      GCLock lock;
+      return eval_int(env,id);
+    }
+
+    /// Evaluate array expression \a e
+    ArrayLit* load_array(EnvI& env, Expression* e) {
+      if (Id* id = e->dyn_cast<Id>()) {
+        Expression* v = bound_value(id);
+        if (v && v->isa<ArrayLit>())
+          return v->cast<ArrayLit>();
+      }
+      return eval_array_lit(env,e);
+    }
+
+    /// Return element \a i of par int or bool array \a al
+    IntVal load_element(EnvI& env, ArrayLit* al, unsigned int i) {
+      if (const ASTParVecO* pv = al->packed()) {
+        switch (pv->kind()) {
+        case ASTParVecO::PV_INT: return pv->i(i);
+        case ASTParVecO::PV_BOOL: return pv->b(i);
+        default: throw BytecodeAbort();
+        }
+      }
+      Expression* e = al->v()[i];
+      if (e->isa<IntLit>())
+        return e->cast<IntLit>()->v();
+      if (e->isa<BoolLit>())
+        return e->cast<BoolLit>()->v();
+      return eval_int(env,e);
+    }
+
+    /**
+     * \brief Binds the parameters of a call that are not passed in registers
+     *
+     * Parameters are bound and restored exactly like in the
+     * tree-walking evaluator.
+     */
+    class ParamBinding {
+    protected:
+      /// The recorded bindings, restored on destruction
+      Bindings _bindings;
+    public:
+      /// Bind parameters of \a ce not held in registers of \a bc
+      ParamBinding(EnvI& env, const ParBytecode& bc, Call* ce) {
+        ASTExprVec<VarDecl> params = ce->decl()->params();
+        for (unsigned int i=params.size(); i--;) {
+          if (!bc.regParam[i])
+            _bindings.bind(params[i], eval_par(env,ce->args()[i]));
+        }
+      }
+    };
+
+    IntVal invoke(EnvI& env, const ParBytecode& bc, Call* ce,
+                  const IntVal* args);
+
+    /// Run program \a bc on \a args, appending emitted values to \a out
+    IntVal run(EnvI& env, const ParBytecode& bc, const IntVal* args,
+               std::vector<IntVal>* out) {
+      IntVal frame[32];
+      std::vector<IntVal> bigFrame;
+      IntVal* r = frame;
+      if (bc.nregs > 32) {
+        bigFrame.resize(bc.nregs);
+        r = &bigFrame[0];
+      }
+      for (unsigned int i=bc.regParam.size(); i--;)
+        if (bc.regParam[i])
+          r[i] = args[i];
+      std::vector<IterSlot> slots(bc.nslots);
+      const ParBytecode::Instr* code = &bc.code[0];
+      const ParBytecode::Instr* pc = code;
+
+#ifdef MZN_BC_THREADED
+#define MZN_BC_LABEL(op) &&L_##op,
+      static void* const labels[] = { MZN_BC_OPS(MZN_BC_LABEL) };
+#undef MZN_BC_LABEL
+#define BC_OP(op) L_##op:
+#define BC_DISPATCH goto *labels[pc->op]
+      BC_DISPATCH;
+#else
+#define BC_OP(op) case ParBytecode::OP_##op:
+#define BC_DISPATCH continue
+      for (;;) switch (pc->op) {
+#endif
+#define BC_NEXT ++pc; BC_DISPATCH
+#define BC_JUMP(t) pc = code+(t); BC_DISPATCH
+
+      BC_OP(LOADK)
+        r[pc->a] = pc->k;
+        BC_NEXT;
+      BC_OP(MOV)
+        r[pc->a] = r[pc->b];
+        BC_NEXT;
+      BC_OP(LOADID)
+        r[pc->a] = load_id(env,static_cast<Id*>(pc->e));
+        BC_NEXT;
+      BC_OP(EVAL)
+        {
+          GCLock lock;
+          r[pc->a] = eval_int(env,pc->e);
+        }
+        BC_NEXT;
+      BC_OP(ALOAD)
+        {
+          GCLock lock;
+          ArrayAccess* aa = static_cast<ArrayAccess*>(pc->e);
+          ArrayLit* al = load_array(env,aa->v());
+          if (al->dims() != pc->c)
+            throw BytecodeAbort();
+          long long int idx = 0;
+          for (int i=0; i<pc->c; i++) {
+            const IntVal& ix = r[pc->b+i];
+            if (ix < al->min(i) || ix > al->max(i))
+              throw BytecodeAbort();
+            idx = idx*(al->max(i)-al->min(i)+1)+(ix.toInt()-al->min(i));
+          }
+          r[pc->a] = load_element(env,al,static_cast<unsigned int>(idx));
+        }
+        BC_NEXT;
+      BC_OP(ADD)
+        r[pc->a] = r[pc->b]+r[pc->c];
+        BC_NEXT;
+      BC_OP(SUB)
+        r[pc->a] = r[pc->b]-r[pc->c];
+        BC_NEXT;
+      BC_OP(MUL)
+        r[pc->a] = r[pc->b]*r[pc->c];
+        BC_NEXT;
+      BC_OP(DIV)
+        if (r[pc->c]==0)
+          throw BytecodeAbort();
+        r[pc->a] = r[pc->b]/r[pc->c];
+        BC_NEXT;
+      BC_OP(MOD)
+        if (r[pc->c]==0)
+          throw BytecodeAbort();
+        r[pc->a] = r[pc->b]%r[pc->c];
+        BC_NEXT;
+      BC_OP(NEG)
+        r[pc->a] = -r[pc->b];
+        BC_NEXT;
+      BC_OP(ABS)
+        r[pc->a] = std::abs(r[pc->b]);
+        BC_NEXT;
+      BC_OP(MIN)
+        r[pc->a] = std::min(r[pc->b],r[pc->c]);
+        BC_NEXT;
+      BC_OP(MAX)
+        r[pc->a] = std::max(r[pc->b],r[pc->c]);
+        BC_NEXT;
+      BC_OP(NOT)
+        r[pc->a] = r[pc->b]==0;
+        BC_NEXT;
+      BC_OP(AND)
+        r[pc->a] = r[pc->b]!=0 && r[pc->c]!=0;
+        BC_NEXT;
+      BC_OP(OR)
+        r[pc->a] = r[pc->b]!=0 || r[pc->c]!=0;
+        BC_NEXT;
+      BC_OP(EQ)
+        r[pc->a] = r[pc->b]==r[pc->c];
+        BC_NEXT;
+      BC_OP(NE)
+        r[pc->a] = r[pc->b]!=r[pc->c];
+        BC_NEXT;
+      BC_OP(LT)
+        r[pc->a] = r[pc->b]<r[pc->c];
+        BC_NEXT;
+      BC_OP(LE)
+        r[pc->a] = r[pc->b]<=r[pc->c];
+        BC_NEXT;
+      BC_OP(INSET)
+        {
+          GCLock lock;
+          r[pc->a] = eval_intset(env,pc->e)->contains(r[pc->b]);
+        }
+        BC_NEXT;
+      BC_OP(JMP)
+        BC_JUMP(pc->a);
+      BC_OP(JF)
+        if (r[pc->a]==0) {
+          BC_JUMP(pc->b);
+        }
+        BC_NEXT;
+      BC_OP(JT)
+        if (r[pc->a]!=0) {
+          BC_JUMP(pc->b);
+        }
+        BC_NEXT;
+      BC_OP(RANGE)
+        {
+          IterSlot& s = slots[pc->a];
+          s.ranges = true;
+          s.v.clear();
+          if (!r[pc->b].isFinite() || !r[pc->c].isFinite())
+            throw BytecodeAbort();
+          if (r[pc->b] <= r[pc->c]) {
+            s.v.push_back(r[pc->b]);
+            s.v.push_back(r[pc->c]);
+          }
+        }
+        BC_NEXT;
+      BC_OP(SETEVAL)
+        {
+          IterSlot& s = slots[pc->a];
+          s.ranges = true;
+          s.v.clear();
+          GCLock lock;
+          IntSetVal* isv = eval_intset(env,pc->e);
+          for (int i=0; i<isv->size(); i++) {
+            if (!isv->min(i).isFinite() || !isv->max(i).isFinite())
+              throw BytecodeAbort();
+            s.v.push_back(isv->min(i));
+            s.v.push_back(isv->max(i));
+          }
+        }
+        BC_NEXT;
+      BC_OP(ARREVAL)
+        {
+          IterSlot& s = slots[pc->a];
+          s.ranges = false;
+          GCLock lock;
+          ArrayLit* al = load_array(env,pc->e);
+          s.v.resize(al->size());
+          for (unsigned int i=0; i<al->size(); i++)
+            s.v[i] = load_element(env,al,i);
+        }
+        BC_NEXT;
+      BC_OP(ITER)
+        {
+          const IterSlot& s = slots[pc->k];
+          if (s.v.empty()) {
+            BC_JUMP(pc->c);
+          }
+          r[pc->a] = s.v[0];
+          r[pc->b] = 0;
+        }
+        BC_NEXT;
+      BC_OP(NEXT)
+        {
+          const IterSlot& s = slots[pc->k];
+          unsigned int p = static_cast<unsigned int>(r[pc->b].toInt());
+          if (s.ranges) {
+            if (r[pc->a] < s.v[2*p+1]) {
+              r[pc->a] = r[pc->a].plus(1);
+              BC_JUMP(pc->c);
+            }
+            if (2*(p+1) < s.v.size()) {
+              r[pc->b] = p+1;
+              r[pc->a] = s.v[2*(p+1)];
+              BC_JUMP(pc->c);
+            }
+          } else if (p+1 < s.v.size()) {
+            r[pc->b] = p+1;
+            r[pc->a] = s.v[p+1];
+            BC_JUMP(pc->c);
+          }
+        }
+        BC_NEXT;
+      BC_OP(CALL)
+        {
+          Call* ce = static_cast<Call*>(pc->e);
+          ParBytecode* callee = function_bytecode(ce->decl());
+          if (callee==NULL)
+            throw BytecodeAbort();
+          r[pc->a] = invoke(env,*callee,ce,r+pc->b);
+        }
+        BC_NEXT;
+      BC_OP(EMIT)
+        out->push_back(r[pc->a]);
+        BC_NEXT;
+      BC_OP(CHKRANGE)
+        if (r[pc->a] < r[pc->b] || r[pc->a] > r[pc->c])
+          throw BytecodeAbort();
+        BC_NEXT;
+      BC_OP(CHKSET)
+        {
+          GCLock lock;
+          if (!eval_intset(env,pc->e)->contains(r[pc->a]))
+            throw BytecodeAbort();
+        }
+        BC_NEXT;
+      BC_OP(FAIL)
+        throw BytecodeAbort();
+      BC_OP(RET)
+        return r[pc->a];
+
+#ifndef MZN_BC_THREADED
+      default:
+        assert(false);
+        throw BytecodeAbort();
+      }
+#endif
+#undef BC_OP
+#undef BC_DISPATCH
+#undef BC_NEXT
+#undef BC_JUMP
+    }
+
+    /// Run function bytecode \a bc for call \a ce with register arguments \a args
+    IntVal invoke(EnvI& env, const ParBytecode& bc, Call* ce,
+                  const IntVal* args) {
+      if (bc.nbound==0)
+        return run(env,bc,args,NULL);
+      ParamBinding binding(env,bc,ce);
+      return run(env,bc,args,NULL);
+    }
+
+    /// Whether calls to the builtin \a id print output or draw random numbers
+    bool impure_builtin(const ASTString& id) {
+      static const char* names[] = {
+        "trace", "normal", "uniform", "poisson", "gamma", "weibull",
+        "exponential", "lognormal", "chisquared", "cauchy", "fdistribution",
+        "tdistribution", "discrete_distribution", "bernoulli", "binomial"
+      };
+      for (unsigned int i=0; i<sizeof(names)/sizeof(names[0]); i++)
+        if (strcmp(id.c_str(),names[i])==0)
+          return true;
+      return false;
+    }
+
+    /**
+     * \brief Collects whether evaluating an expression has side effects
+     *
+     * Side effects are calls to impure builtins, directly or through the
+     * bodies of the functions called. Bytecode must not evaluate such
+     * expressions, since the tree-walking evaluator would repeat the
+     * side effects if execution is abandoned.
+     */
+    class SideEffects : public EVisitor {
+    public:
+      /// Whether a side effect has been found
+      bool found;
+      /// Functions whose bodies have been visited
+      UNORDERED_NAMESPACE::unordered_set<FunctionI*> visited;
+      /// Constructor
+      SideEffects(void) : found(false) {}
+      /// Skip subtrees once a side effect has been found, and packed arrays
+      bool enter(Expression* e) {
+        if (found)
+          return false;
+        if (ArrayLit* al = e->dyn_cast<ArrayLit>())
+          return al->packed()==NULL;
+        return true;
+      }
+      /// Visit call
+      void vCall(const Call& c) {
+        if (impure_builtin(c.id())) {
+          found = true;
+          return;
+        }
+        FunctionI* fi = c.decl();
+        if (fi==NULL || fi->e()==NULL || !visited.insert(fi).second)
+          return;
+        if (fi->_bytecodeDone && !fi->immortal()) {
+          if (fi->_bytecodeImpure)
+            found = true;
+        } else
+          TopDownIterator<SideEffects>(*this).run(fi->e());
+      }
+    };
+
+    /// Whether evaluating \a e may have side effects
+    bool side_effects(Expression* e) {
+      SideEffects se;
+      TopDownIterator<SideEffects>(se).run(e);
+      return se.found;
+    }
+
+    /// Collects whether an expression refers to a register or has side effects
+    class RegisterRefs : public SideEffects {
+    public:
+      /// Declarations held in registers
+      const std::vector<std::pair<VarDecl*,int> >& scope;
+      /// Constructor
+      RegisterRefs(const std::vector<std::pair<VarDecl*,int> >& scope0)
+        : scope(scope0) {}
+      /// Visit identifier
+      void vId(const Id& id) {
+        VarDecl* vd = id.decl();
+        for (unsigned int i=scope.size(); i--;) {
+          if (scope[i].first==vd) {
+            found = true;
+            return;
+          }
+        }
+      }
+    };
+
+    /// Compiles par expressions into a ParBytecode program
+    class BytecodeCompiler {
+    public:
+      /// How the elements of a comprehension are combined
+      enum Agg { AGG_EMIT, AGG_SUM, AGG_FORALL, AGG_EXISTS, AGG_MIN, AGG_MAX };
+      /// The program
+      ParBytecode& bc;
+      /// Declarations held in registers, innermost last
+      std::vector<std::pair<VarDecl*,int> > scope;
+      /// Next free register
+      int nextReg;
+      /// Next free iteration slot
+      int nextSlot;
+
+      /// Constructor for a program with \a nparams parameters
+      BytecodeCompiler(ParBytecode& bc0, int nparams)
+        : bc(bc0), nextReg(nparams), nextSlot(0) {
+        bc.nregs = std::max(bc.nregs,nparams);
+      }
+
+      /// Allocate a register
+      int alloc(void) {
+        int r = nextReg++;
+        bc.nregs = std::max(bc.nregs,nextReg);
+        return r;
+      }
+      /// Allocate an iteration slot
+      int allocSlot(void) {
+        int s = nextSlot++;
+        bc.nslots = std::max(bc.nslots,nextSlot);
+        return s;
+      }
+      /// Emit instruction, return its position
+      int emit(int op, int a=0, int b=0, int c=0, Expression* e=NULL) {
+        ParBytecode::Instr i;
+        i.op = op; i.a = a; i.b = b; i.c = c;
+        i.k = 0;
+        i.e = e;
+        bc.code.push_back(i);
+        return static_cast<int>(bc.code.size())-1;
+      }
+      /// Emit instruction with constant or slot \a k
+      int emitK(int op, int a, long long int k, int b=0, int c=0) {
+        int pos = emit(op,a,b,c);
+        bc.code[pos].k = k;
+        return pos;
+      }
+      /// Position of the next instruction
+      int here(void) const { return static_cast<int>(bc.code.size()); }
+      /// Make jump at \a pos (with target operand \a t) point to here
+      void patch(int pos, int ParBytecode::Instr::* t) {
+        bc.code[pos].*t = here();
+      }
+
+      /// Register holding \a vd (or -1)
+      int reg(VarDecl* vd) const {
+        for (unsigned int i=scope.size(); i--;)
+          if (scope[i].first==vd)
+            return scope[i].second;
+        return -1;
+      }
+      /// Whether \a e can be evaluated without access to registers or side effects
+      bool independent(Expression* e) const {
+        RegisterRefs rr(scope);
+        TopDownIterator<RegisterRefs>(rr).run(e);
+        return !rr.found;
+      }
+
+      /// Compile \a e into register \a dst
+      bool expr(Expression* e, int dst) {
+        if (!scalar(e->type()))
+          return false;
+        int reg0 = nextReg;
+        int slot0 = nextSlot;
+        int pc0 = here();
+        unsigned int scope0 = scope.size();
+        bool ok = native(e,dst);
+        nextReg = reg0;
+        nextSlot = slot0;
+        scope.resize(scope0);
+        if (ok)
+          return true;
+        bc.code.resize(pc0);
+        if (independent(e)) {
+          emit(ParBytecode::OP_EVAL,dst,0,0,e);
+          return true;
+        }
+        return false;
+      }
+
+      /// Compile \a e into register \a dst without falling back to EVAL
+      bool native(Expression* e, int dst) {
+        switch (e->eid()) {
+        case Expression::E_INTLIT:
+          {
+            IntVal v = e->cast<IntLit>()->v();
+            if (!v.isFinite())
+              return false;
+            emitK(ParBytecode::OP_LOADK,dst,v.toInt());
+            return true;
+          }
+        case Expression::E_BOOLLIT:
+          emitK(ParBytecode::OP_LOADK,dst,e->cast<BoolLit>()->v() ? 1 : 0);
+          return true;
+        case Expression::E_ID:
+          {
+            VarDecl* vd = e->cast<Id>()->decl();
+            int r = vd ? reg(vd) : -1;
+            if (r >= 0)
+              emit(ParBytecode::OP_MOV,dst,r);
+            else
+              emit(ParBytecode::OP_LOADID,dst,0,0,e);
+            return true;
+          }
+        case Expression::E_ARRAYACCESS:
+          {
+            ArrayAccess* aa = e->cast<ArrayAccess>();
+            int n = aa->idx().size();
+            if (!aa->v()->type().ispar() || aa->v()->type().dim() != n ||
+                !independent(aa->v()))
+              return false;
+            int base = nextReg;
+            for (int i=0; i<n; i++)
+              alloc();
+            for (int i=0; i<n; i++)
+              if (!expr(aa->idx()[i],base+i))
+                return false;
+            emit(ParBytecode::OP_ALOAD,dst,base,n,e);
+            return true;
+          }
+        case Expression::E_ITE:
+          {
+            ITE* ite = e->cast<ITE>();
+            std::vector<int> ends;
+            int cond = alloc();
+            for (int i=0; i<ite->size(); i++) {
+              if (!expr(ite->e_if(i),cond))
+                return false;
+              int skip = emit(ParBytecode::OP_JF,cond);
+              if (!expr(ite->e_then(i),dst))
+                return false;
+              ends.push_back(emit(ParBytecode::OP_JMP));
+              patch(skip,&ParBytecode::Instr::b);
+            }
+            if (!expr(ite->e_else(),dst))
+              return false;
+            for (unsigned int i=0; i<ends.size(); i++)
+              patch(ends[i],&ParBytecode::Instr::a);
+            return true;
+          }
+        case Expression::E_BINOP:
+          return binop(e->cast<BinOp>(),dst);
+        case Expression::E_UNOP:
+          {
+            UnOp* uo = e->cast<UnOp>();
+            if (!expr(uo->e(),dst))
+              return false;
+            switch (uo->op()) {
+            case UOT_NOT:
+              emit(ParBytecode::OP_NOT,dst,dst);
+              return true;
+            case UOT_MINUS:
+              emit(ParBytecode::OP_NEG,dst,dst);
+              return true;
+            case UOT_PLUS:
+              return true;
+            default:
+              return false;
+            }
+          }
+        case Expression::E_CALL:
+          return call(e->cast<Call>(),dst);
+        case Expression::E_LET:
+          {
+            Let* let = e->cast<Let>();
+            ASTExprVec<Expression> items = let->let();
+            for (unsigned int i=0; i<items.size(); i++) {
+              VarDecl* vd = items[i]->dyn_cast<VarDecl>();
+              if (vd==NULL || vd->e()==NULL || !scalar(vd->type()) ||
+                  vd->ti()->domain() != NULL)
+                return false;
+              int r = alloc();
+              if (!expr(vd->e(),r))
+                return false;
+              scope.push_back(std::pair<VarDecl*,int>(vd,r));
+            }
+            return expr(let->in(),dst);
+          }
+        default:
+          return false;
+        }
+      }
+
+      /// Compile binary operator \a bo into register \a dst
+      bool binop(BinOp* bo, int dst) {
+        Expression* lhs = bo->lhs();
+        Expression* rhs = bo->rhs();
+        int op;
+        bool swap = false;
+        switch (bo->op()) {
+        case BOT_PLUS: op = ParBytecode::OP_ADD; break;
+        case BOT_MINUS: op = ParBytecode::OP_SUB; break;
+        case BOT_MULT: op = ParBytecode::OP_MUL; break;
+        case BOT_IDIV: op = ParBytecode::OP_DIV; break;
+        case BOT_MOD: op = ParBytecode::OP_MOD; break;
+        case BOT_LE: op = ParBytecode::OP_LT; break;
+        case BOT_LQ: op = ParBytecode::OP_LE; break;
+        case BOT_GR: op = ParBytecode::OP_LT; swap = true; break;
+        case BOT_GQ: op = ParBytecode::OP_LE; swap = true; break;
+        case BOT_EQ:
+        case BOT_EQUIV:
+          op = ParBytecode::OP_EQ; break;
+        case BOT_NQ:
+        case BOT_XOR:
+          op = ParBytecode::OP_NE; break;
+        case BOT_AND:
+        case BOT_OR:
+          {
+            // Short-circuit evaluation like the tree-walking evaluator
+            if (!expr(lhs,dst))
+              return false;
+            int skip = emit(bo->op()==BOT_AND ? ParBytecode::OP_JF
+                                              : ParBytecode::OP_JT, dst);
+            if (!expr(rhs,dst))
+              return false;
+            patch(skip,&ParBytecode::Instr::b);
+            return true;
+          }
+        case BOT_IMPL:
+        case BOT_RIMPL:
+          {
+            Expression* cond = bo->op()==BOT_IMPL ? lhs : rhs;
+            if (!expr(cond,dst))
+              return false;
+            emit(ParBytecode::OP_NOT,dst,dst);
+            int skip = emit(ParBytecode::OP_JT,dst);
+            if (!expr(cond==lhs ? rhs : lhs,dst))
+              return false;
+            patch(skip,&ParBytecode::Instr::b);
+            return true;
+          }
+        case BOT_IN:
+          {
+            if (!lhs->type().isint() || !rhs->type().ispar() ||
+                !rhs->type().isintset())
+              return false;
+            int x = alloc();
+            if (!expr(lhs,x))
+              return false;
+            BinOp* range = rhs->dyn_cast<BinOp>();
+            if (range && range->op()==BOT_DOTDOT) {
+              int lb = alloc();
+              int ub = alloc();
+              if (!expr(range->lhs(),lb) || !expr(range->rhs(),ub))
+                return false;
+              emit(ParBytecode::OP_LE,lb,lb,x);
+              emit(ParBytecode::OP_LE,ub,x,ub);
+              emit(ParBytecode::OP_AND,dst,lb,ub);
+              return true;
+            }
+            if (!independent(rhs))
+              return false;
+            emit(ParBytecode::OP_INSET,dst,x,0,rhs);
+            return true;
+          }
+        default:
+          return false;
+        }
+        if (lhs->type().bt() != rhs->type().bt())
+          return false;
+        int l = alloc();
+        int r = alloc();
+        if (!expr(lhs,l) || !expr(rhs,r))
+          return false;
+        if (swap)
+          emit(op,dst,r,l);
+        else
+          emit(op,dst,l,r);
+        return true;
+      }
+
+      /// Compile call \a ce into register \a dst
+      bool call(Call* ce, int dst) {
+        FunctionI* fi = ce->decl();
+        if (fi==NULL)
+          return false;
+        ASTExprVec<Expression> args = ce->args();
+        if (fi->_builtins.e==NULL && fi->_builtins.i==NULL &&
+            fi->_builtins.f==NULL && fi->_builtins.b==NULL &&
+            fi->_builtins.s==NULL && fi->_builtins.str==NULL) {
+          ParBytecode* callee = function_bytecode(fi);
+          if (callee==NULL || callee->regParam.size() != args.size())
+            return false;
+          int base = nextReg;
+          for (unsigned int i=0; i<args.size(); i++)
+            alloc();
+          for (unsigned int i=0; i<args.size(); i++) {
+            if (callee->regParam[i]) {
+              if (!expr(args[i],base+i))
+                return false;
+            } else if (!independent(args[i])) {
+              return false;
+            }
+          }
+          emit(ParBytecode::OP_CALL,dst,base,0,ce);
+          return true;
+        }
+        if (args.size()==1 && ce->id()==constants().ids.bool2int)
+          return expr(args[0],dst);
+        if (args.size()==1 && ce->id()=="abs" && args[0]->type().isint()) {
+          if (!expr(args[0],dst))
+            return false;
+          emit(ParBytecode::OP_ABS,dst,dst);
+          return true;
+        }
+        if (args.size()==2 && (ce->id()=="min" || ce->id()=="max") &&
+            args[0]->type().isint() && args[1]->type().isint()) {
+          int x = alloc();
+          if (!expr(args[0],dst) || !expr(args[1],x))
+            return false;
+          emit(ce->id()=="min" ? ParBytecode::OP_MIN : ParBytecode::OP_MAX,
+               dst,dst,x);
+          return true;
+        }
+        if (args.size()==1 && args[0]->isa<Comprehension>()) {
+          Comprehension* c = args[0]->cast<Comprehension>();
+          if (c->set())
+            return false;
+          if (ce->id()==constants().ids.sum) {
+            emitK(ParBytecode::OP_LOADK,dst,0);
+            return comprehension(c,AGG_SUM,dst,-1);
+          }
+          if (ce->id()==constants().ids.forall) {
+            emitK(ParBytecode::OP_LOADK,dst,1);
+            return comprehension(c,AGG_FORALL,dst,-1);
+          }
+          if (ce->id()==constants().ids.exists) {
+            emitK(ParBytecode::OP_LOADK,dst,0);
+            return comprehension(c,AGG_EXISTS,dst,-1);
+          }
+          if (ce->id()=="min" || ce->id()=="max") {
+            // The flag records whether any element has been seen
+            int seen = alloc();
+            emitK(ParBytecode::OP_LOADK,seen,0);
+            if (!comprehension(c,ce->id()=="min" ? AGG_MIN : AGG_MAX,dst,seen))
+              return false;
+            int ok = emit(ParBytecode::OP_JT,seen);
+            emit(ParBytecode::OP_FAIL);
+            patch(ok,&ParBytecode::Instr::b);
+            return true;
+          }
+        }
+        return false;
+      }
+
+      /// Compile comprehension \a c, combining its elements using \a agg
+      bool comprehension(Comprehension* c, Agg agg, int acc, int seen) {
+        int reg0 = nextReg;
+        int slot0 = nextSlot;
+        unsigned int scope0 = scope.size();
+        bool ok = generator(c,0,0,-1,agg,acc,seen);
+        nextReg = reg0;
+        nextSlot = slot0;
+        scope.resize(scope0);
+        return ok;
+      }
+
+      /// Compile loop for declaration \a d of generator \a g of \a c
+      bool generator(Comprehension* c, int g, int d, int slot,
+                     Agg agg, int acc, int seen) {
+        if (d==0) {
+          Expression* in = c->in(g);
+          const Type& t = in->type();
+          if (!t.ispar() || t.isopt())
+            return false;
+          slot = allocSlot();
+          if (t.dim()==0) {
+            if (!t.isintset())
+              return false;
+            BinOp* range = in->dyn_cast<BinOp>();
+            if (range && range->op()==BOT_DOTDOT) {
+              int lb = alloc();
+              int ub = alloc();
+              if (!expr(range->lhs(),lb) || !expr(range->rhs(),ub))
+                return false;
+              emit(ParBytecode::OP_RANGE,slot,lb,ub);
+            } else if (independent(in)) {
+              emit(ParBytecode::OP_SETEVAL,slot,0,0,in);
+            } else {
+              return false;
+            }
+          } else {
+            if ((t.bt() != Type::BT_INT && t.bt() != Type::BT_BOOL) ||
+                t.st() != Type::ST_PLAIN || !independent(in))
+              return false;
+            emit(ParBytecode::OP_ARREVAL,slot,0,0,in);
+          }
+        }
+        VarDecl* vd = c->decl(g,d);
+        if (!scalar(vd->type()))
+          return false;
+        int v = alloc();
+        int pos = alloc();
+        scope.push_back(std::pair<VarDecl*,int>(vd,v));
+        int iter = emitK(ParBytecode::OP_ITER,v,slot,pos);
+        int start = here();
+        bool ok;
+        if (d+1 < c->n_decls(g))
+          ok = generator(c,g,d+1,slot,agg,acc,seen);
+        else if (g+1 < c->n_generators())
+          ok = generator(c,g+1,0,-1,agg,acc,seen);
+        else
+          ok = element(c,agg,acc,seen);
+        if (!ok)
+          return false;
+        emitK(ParBytecode::OP_NEXT,v,slot,pos,start);
+        patch(iter,&ParBytecode::Instr::c);
+        return true;
+      }
+
+      /// Compile the where-clause and element of \a c
+      bool element(Comprehension* c, Agg agg, int acc, int seen) {
+        int skip = -1;
+        if (c->where()) {
+          int w = alloc();
+          if (!c->where()->type().isbool() || !expr(c->where(),w))
+            return false;
+          skip = emit(ParBytecode::OP_JF,w);
+        }
+        int v = alloc();
+        if (!expr(c->e(),v))
+          return false;
+        switch (agg) {
+        case AGG_EMIT:
+          emit(ParBytecode::OP_EMIT,v);
+          break;
+        case AGG_SUM:
+          emit(ParBytecode::OP_ADD,acc,acc,v);
+          break;
+        case AGG_FORALL:
+          emit(ParBytecode::OP_AND,acc,acc,v);
+          break;
+        case AGG_EXISTS:
+          emit(ParBytecode::OP_OR,acc,acc,v);
+          break;
+        case AGG_MIN:
+        case AGG_MAX:
+          {
+            int cmp = emit(ParBytecode::OP_JT,seen);
+            emit(ParBytecode::OP_MOV,acc,v);
+            emitK(ParBytecode::OP_LOADK,seen,1);
+            int done = emit(ParBytecode::OP_JMP);
+            patch(cmp,&ParBytecode::Instr::b);
+            emit(agg==AGG_MIN ? ParBytecode::OP_MIN : ParBytecode::OP_MAX,
+                 acc,acc,v);
+            patch(done,&ParBytecode::Instr::a);
+          }
+          break;
+        }
+        if (skip >= 0)
+          patch(skip,&ParBytecode::Instr::b);
+        return true;
+      }
+
+      /// Compile check that parameter register \a r lies in domain \a dom
+      bool domain(int r, Expression* dom) {
+        BinOp* range = dom->dyn_cast<BinOp>();
+        if (range && range->op()==BOT_DOTDOT) {
+          int lb = alloc();
+          int ub = alloc();
+          if (!expr(range->lhs(),lb) || !expr(range->rhs(),ub))
+            return false;
+          emit(ParBytecode::OP_CHKRANGE,r,lb,ub);
+          return true;
+        }
+        if (!dom->type().ispar() || !dom->type().isintset() || !independent(dom))
+          return false;
+        emit(ParBytecode::OP_CHKSET,r,0,0,dom);
+        return true;
+      }
+
+      /// Compile the body of function \a fi
+      bool function(FunctionI* fi) {
+        ASTExprVec<VarDecl> params = fi->params();
+        for (unsigned int i=0; i<params.size(); i++)
+          if (bc.regParam[i])
+            scope.push_back(std::pair<VarDecl*,int>(params[i],i));
+        for (unsigned int i=0; i<params.size(); i++) {
+          Expression* dom = params[i]->ti()->domain();
+          if (bc.regParam[i] && dom && !dom->isa<TIId>()) {
+            int reg0 = nextReg;
+            if (!domain(i,dom))
+              return false;
+            nextReg = reg0;
+          }
+        }
+        int res = alloc();
+        if (!expr(fi->e(),res))
+          return false;
+        emit(ParBytecode::OP_RET,res);
+        return true;
+      }
+    };
+
+  }
+
+  /**
+   * \brief Return the bytecode for function \a fi (or NULL)
+   *
+   * Functions are compiled on first use and the result is cached in the
+   * FunctionI. Only functions with a par int or bool body without side
+   * effects are compiled. Their par int and bool parameters are passed in
+   * registers, all other par parameters are bound as in the tree-walking
+   * evaluator. Functions of a frozen library are never compiled, since
+   * they must not be modified.
+   */
+  ParBytecode* function_bytecode(FunctionI* fi) {
+    if (fi->_bytecodeDone || fi->immortal())
+      return fi->_bytecode;
+    bool impure = false;
+    if (fi->e()) {
+      SideEffects se;
+      se.visited.insert(fi);
+      TopDownIterator<SideEffects>(se).run(fi->e());
+      impure = se.found;
+    }
+    delete fi->_bytecode;
+    fi->_bytecode = NULL;
+    fi->_bytecodeDone = true;
+    fi->_bytecodeImpure = impure;
+    if (impure || fi->e()==NULL || !scalar(fi->e()->type()) ||
+        fi->_builtins.e || fi->_builtins.i || fi->_builtins.f ||
+        fi->_builtins.b || fi->_builtins.s || fi->_builtins.str)
+      return NULL;
+    ASTExprVec<VarDecl> params = fi->params();
+    ParBytecode* bc = new ParBytecode;
+    bc->regParam.resize(params.size());
+    for (unsigned int i=0; i<params.size(); i++) {
+      VarDecl* vd = params[i];
+      if (!vd->type().ispar()) {
+        delete bc;
+        return NULL;
+      }
+      bc->regParam[i] = scalar(vd->type());
+      if (!bc->regParam[i]) {
+        bc->nbound++;
+        Expression* dom = vd->ti()->domain();
+        if (dom && !dom->isa<TIId>()) {
+          delete bc;
+          return NULL;
+        }
+      }
+    }
+    // Make the (incomplete) program visible for recursive calls
+    fi->_bytecode = bc;
+    BytecodeCompiler cc(*bc,params.size());
+    if (!cc.function(fi)) {
+      fi->_bytecode = NULL;
+      delete bc;
+    }
+    return fi->_bytecode;
+  }
+
+  BytecodeResult bytecode_call(EnvI& env, Call* ce, IntVal& r) {
+    if (env.bytecode_disabled > 0)
+      return BC_UNSUPPORTED;
+    ParBytecode* bc = function_bytecode(ce->decl());
+    if (bc==NULL)
+      return BC_UNSUPPORTED;
+    try {
+      ASTExprVec<Expression> args = ce->args();
+      IntVal frame[8];
+      std::vector<IntVal> bigFrame;
+      IntVal* a = frame;
+      if (args.size() > 8) {
+        bigFrame.resize(args.size());
+        a = &bigFrame[0];
+      }
+      for (unsigned int i=args.size(); i--;)
+        if (side_effects(args[i]))
+          return BC_UNSUPPORTED;
+      for (unsigned int i=args.size(); i--;)
+        if (bc->regParam[i])
+          a[i] = eval_int(env,args[i]);
+      r = invoke(env,*bc,ce,a);
+      return BC_OK;
+    } catch (Exception&) {
+      return BC_FAILED;
+    }
+  }
+
+  /// Compile comprehension \a c into a new program (or return NULL)
+  ParBytecode* compile_comprehension(Comprehension* c) {
+    ParBytecode* bc = new ParBytecode;
+    BytecodeCompiler cc(*bc,0);
+    if (!scalar(c->e()->type()) ||
+        !cc.comprehension(c,BytecodeCompiler::AGG_EMIT,-1,-1)) {
+      delete bc;
+      return NULL;
+    }
+    cc.emit(ParBytecode::OP_RET,cc.alloc());
+    return bc;
+  }
+
+  BytecodeResult bytecode_comp(EnvI& env, Comprehension* c,
+                               std::vector<IntVal>& a) {
+    if (env.bytecode_disabled > 0)
+      return BC_UNSUPPORTED;
+    // The program is cached in the comprehension, except for
+    // comprehensions of a frozen library, which must not be modified
+    ParBytecode* bc;
+    if (c->immortal()) {
+      bc = compile_comprehension(c);
+    } else {
+      if (!c->_bytecodeDone) {
+        delete c->_bytecode;
+        c->_bytecode = compile_comprehension(c);
+        c->_bytecodeDone = true;
+      }
+      bc = c->_bytecode;
+    }
+    if (bc==NULL)
+      return BC_UNSUPPORTED;
+    BytecodeResult result = BC_OK;
+    try {
+      run(env,*bc,NULL,&a);
+    } catch (Exception&) {
+      a.clear();
+      result = BC_FAILED;
+    }
+    if (c->immortal())
+      delete bc;
+    return result;
+  }
+
+}
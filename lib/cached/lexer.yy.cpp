@@ -779,7 +779,7 @@ int yy_input_proc(char* buf, int size, yyscan_t yyscanner);
 bool strtointval(const char* s, long long int& v) {
   std::istringstream iss(s);
   iss >> v;
-  return !iss.fail();
+  return !iss.fail() && v != LLONG_MAX; // LLONG_MAX is infinity, see IntVal
 }
 
 bool strtofloatval(const char* s, double& v) {
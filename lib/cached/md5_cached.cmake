@@ -1,2 +1,2 @@
-set(lexer_lxx_md5_cached "2519048554e50060cca5b436e2a13f8c")
+set(lexer_lxx_md5_cached "79f2fac6f608206dae6a4fb4f3abb5da")
 set(parser_yxx_md5_cached "bc84cecc1dc783b8f5e4f2592b5c1135")
\ No newline at end of file
@@ -85,10 +85,59 @@ namespace MiniZinc {
 
   void copy_ann(EnvI& env, CopyMap& m, Annotation& oldAnn, Annotation& newAnn, bool followIds, bool copyFundecls);
   
+  /**
+   * \brief Check if \a e can be shared instead of copied
+   *
+   * Literals (and array literals containing only literals) are never
+   * modified after type checking, except for the literals that hold the
+   * current value of a comprehension generator (see the copies of
+   * Comprehension and Id below), so the original, flat and output models can
+   * refer to the same node. Expressions with annotations are always
+   * copied, since annotations may be added or removed per model.
+   */
+  bool is_shareable(Expression* e) {
+    if (!e->ann().isEmpty())
+      return false;
+    switch (e->eid()) {
+      case Expression::E_INTLIT:
+      case Expression::E_FLOATLIT:
+      case Expression::E_BOOLLIT:
+      case Expression::E_STRINGLIT:
+        return true;
+      case Expression::E_SETLIT:
+        return e->cast<SetLit>()->isv() != NULL;
+      case Expression::E_ARRAYLIT:
+        {
+          ArrayLit* al = e->cast<ArrayLit>();
+          if (al->packed())
+            return false;
+          ASTExprVec<Expression> v = al->v();
+          for (unsigned int i=v.size(); i--;) {
+            switch (v[i]->eid()) {
+              case Expression::E_INTLIT:
+              case Expression::E_FLOATLIT:
+              case Expression::E_BOOLLIT:
+              case Expression::E_STRINGLIT:
+                if (!v[i]->ann().isEmpty())
+                  return false;
+                break;
+              default:
+                return false;
+            }
+          }
+          return true;
+        }
+      default:
+        return false;
+    }
+  }
+
   Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copyFundecls) {
     if (e==NULL) return NULL;
     if (Expression* cached = m.find(e))
       return cached;
+    if (is_shareable(e))
+      return e;
     Expression* ret = NULL;
     switch (e->eid()) {
     case Expression::E_INTLIT:
@@ -166,6 +215,12 @@ namespace MiniZinc {
           return e;
         Id* id = e->cast<Id>();
         
+        if (followIds && id->decl()) {
+          // Identifiers bound inside the copied expression, such as the
+          // generators of a comprehension, refer to the copied declaration
+          if (Expression* cd = m.find(id->decl()))
+            return cd->cast<VarDecl>()->id();
+        }
         if (followIds) {
           Id* prevId = id;
           Expression* cur = e;
@@ -195,6 +250,10 @@ namespace MiniZinc {
           } while (!done);
           if (cur->isa<Id>()) {
             return cur;
+          } else if (cur->isa<IntLit>()) {
+            // The literal may hold the current value of a generator, which
+            // is overwritten during evaluation, so it must not be shared
+            return IntLit::a(cur->cast<IntLit>()->v());
           } else {
             return copy(env,m,cur,false);
           }
@@ -237,6 +296,13 @@ namespace MiniZinc {
           dims[i].first = al->min(i);
           dims[i].second = al->max(i);
         }
+        if (ASTParVecO* pv = al->packed()) {
+          // Packed values are immutable and can be shared
+          ArrayLit* c = new ArrayLit(copy_location(m,e),pv,dims);
+          m.insert(e,c);
+          ret = c;
+          break;
+        }
         ArrayLit* c = new ArrayLit(copy_location(m,e),std::vector<Expression*>(),dims);
         m.insert(e,c);
 
@@ -288,8 +354,14 @@ namespace MiniZinc {
         g._w = copy(env,m,c->where(),followIds,copyFundecls);
         for (int i=0; i<c->n_generators(); i++) {
           std::vector<VarDecl*> vv;
-          for (int j=0; j<c->n_decls(i); j++)
-            vv.push_back(static_cast<VarDecl*>(copy(env,m,c->decl(i,j),followIds,copyFundecls)));
+          for (int j=0; j<c->n_decls(i); j++) {
+            VarDecl* vd = static_cast<VarDecl*>(copy(env,m,c->decl(i,j),followIds,copyFundecls));
+            // The literal of a generator is overwritten during evaluation,
+            // so it must not be shared with the original
+            if (vd->e() && vd->e()->isa<IntLit>() && vd->e()==c->decl(i,j)->e())
+              vd->e(new IntLit(Location(),vd->e()->cast<IntLit>()->v()));
+            vv.push_back(vd);
+          }
           g._g.push_back(Generator(vv,copy(env,m,c->in(i),followIds,copyFundecls)));
         }
         cc->init(copy(env,m,c->e(),followIds,copyFundecls),g);
@@ -16,6 +16,8 @@
 #include <minizinc/copy.hh>
 #include <minizinc/astiterator.hh>
 #include <minizinc/flatten.hh>
+#include <minizinc/flatten_internal.hh>
+#include <minizinc/bytecode.hh>
 
 namespace MiniZinc {
 
@@ -58,6 +60,7 @@ namespace MiniZinc {
   class EvalFloatVal {
   public:
     typedef FloatVal Val;
+    typedef FloatVal ArrayVal;
     static FloatVal e(EnvI& env, Expression* e) {
       return eval_float(env, e);
     }
@@ -102,6 +105,7 @@ namespace MiniZinc {
   class EvalBoolVal {
   public:
     typedef bool Val;
+    typedef bool ArrayVal;
     static bool e(EnvI& env, Expression* e) {
       return eval_bool(env, e);
     }
@@ -206,12 +210,10 @@ namespace MiniZinc {
   
   template<class Eval>
   typename Eval::Val eval_call(EnvI& env, Call* ce) {
-    std::vector<Expression*> previousParameters(ce->decl()->params().size());
+    Bindings parameters;
     for (unsigned int i=ce->decl()->params().size(); i--;) {
       VarDecl* vd = ce->decl()->params()[i];
-      previousParameters[i] = vd->e();
-      vd->flat(vd);
-      vd->e(eval_par(env, ce->args()[i]));
+      parameters.bind(vd, eval_par(env, ce->args()[i]));
       if (vd->e()->type().ispar()) {
         if (Expression* dom = vd->ti()->domain()) {
           if (!dom->isa<TIId>()) {
@@ -236,26 +238,86 @@ namespace MiniZinc {
         }
       }
     }
-    typename Eval::Val ret = Eval::e(env,ce->decl()->e());
-    for (unsigned int i=ce->decl()->params().size(); i--;) {
-      VarDecl* vd = ce->decl()->params()[i];
-      vd->e(previousParameters[i]);
-      vd->flat(vd->e() ? vd : NULL);
-    }
-    return ret;
+    return Eval::e(env,ce->decl()->e());
   }
   
+  /// Evaluate par int or bool call \a ce, using bytecode if possible
+  IntVal eval_call_int(EnvI& env, Call* ce) {
+    IntVal r;
+    switch (bytecode_call(env,ce,r)) {
+    case BC_OK:
+      return r;
+    case BC_FAILED:
+      {
+        BytecodeDisabler noBytecode(env);
+        return eval_call<EvalIntVal>(env,ce);
+      }
+    default:
+      return eval_call<EvalIntVal>(env,ce);
+    }
+  }
+
+  /// Evaluate par int or bool comprehension \a e, using bytecode if possible
+  std::vector<IntVal> eval_comp_int(EnvI& env, Comprehension* e) {
+    std::vector<IntVal> a;
+    switch (bytecode_comp(env,e,a)) {
+    case BC_OK:
+      return a;
+    case BC_FAILED:
+      {
+        BytecodeDisabler noBytecode(env);
+        return eval_comp<EvalIntVal>(env,e);
+      }
+    default:
+      return eval_comp<EvalIntVal>(env,e);
+    }
+  }
+
+  /// Create one-dimensional array literal from packed values \a pv
+  ArrayLit* packed_array_lit(const Location& loc, ASTParVecO* pv) {
+    std::vector<std::pair<int,int> > dims(1);
+    dims[0] = std::pair<int,int>(1,pv->size());
+    return new ArrayLit(loc,pv,dims);
+  }
+
   ArrayLit* eval_array_comp(EnvI& env, Comprehension* e) {
     ArrayLit* ret;
     if (e->type() == Type::parint(1)) {
-      std::vector<Expression*> a = eval_comp<EvalIntLit>(env,e);
-      ret = new ArrayLit(e->loc(),a);
+      std::vector<IntVal> a = eval_comp_int(env,e);
+      bool finite = !a.empty();
+      for (unsigned int i=a.size(); finite && i--;)
+        finite = a[i].isFinite();
+      if (finite) {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_INT,a.size());
+        for (unsigned int i=a.size(); i--;)
+          pv->i(i) = a[i].toInt();
+        ret = packed_array_lit(e->loc(),pv);
+      } else {
+        std::vector<Expression*> ea(a.size());
+        for (unsigned int i=a.size(); i--;)
+          ea[i] = IntLit::a(a[i]);
+        ret = new ArrayLit(e->loc(),ea);
+      }
     } else if (e->type() == Type::parbool(1)) {
-      std::vector<Expression*> a = eval_comp<EvalBoolLit>(env,e);
-      ret = new ArrayLit(e->loc(),a);
+      std::vector<IntVal> a = eval_comp_int(env,e);
+      if (a.empty()) {
+        ret = new ArrayLit(e->loc(),std::vector<Expression*>());
+      } else {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_BOOL,a.size());
+        for (unsigned int i=a.size(); i--;)
+          pv->b(i,a[i]!=0);
+        ret = packed_array_lit(e->loc(),pv);
+      }
     } else if (e->type() == Type::parfloat(1)) {
-      std::vector<Expression*> a = eval_comp<EvalFloatLit>(env,e);
-      ret = new ArrayLit(e->loc(),a);
+      std::vector<FloatVal> a = eval_comp<EvalFloatVal>(env,e);
+      if (a.empty()) {
+        ret = new ArrayLit(e->loc(),std::vector<Expression*>());
+      } else {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_FLOAT,a.size());
+        for (unsigned int i=a.size(); i--;)
+          pv->f(i) = a[i];
+        ret = packed_array_lit(e->loc(),pv);
+      }
     } else if (e->type() == Type::parsetint(1)) {
       std::vector<Expression*> a = eval_comp<EvalSetLit>(env,e);
       ret = new ArrayLit(e->loc(),a);
@@ -338,11 +400,10 @@ namespace MiniZinc {
     case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         ArrayLit* l_in = eval_array_lit(env,l->in());
         ArrayLit* ret = copy(env,l_in,true)->cast<ArrayLit>();
         ret->flat(l_in->flat());
-        l->popbindings();
         return ret;
       }
     }
@@ -381,8 +442,19 @@ namespace MiniZinc {
       realdim /= al->max(i)-al->min(i)+1;
       realidx += (ix-al->min(i))*realdim;
     }
-    assert(realidx >= 0 && realidx <= al->v().size());
-    return al->v()[static_cast<unsigned int>(realidx.toInt())];
+    assert(realidx >= 0 && realidx <= al->size());
+    unsigned int idx = static_cast<unsigned int>(realidx.toInt());
+    if (const ASTParVecO* pv = al->packed()) {
+      switch (pv->kind()) {
+      case ASTParVecO::PV_INT:
+        return IntLit::a(pv->i(idx));
+      case ASTParVecO::PV_FLOAT:
+        return new FloatLit(Location().introduce(),pv->f(idx));
+      case ASTParVecO::PV_BOOL:
+        return constants().boollit(pv->b(idx));
+      }
+    }
+    return al->v()[idx];
   }
   Expression* eval_arrayaccess(EnvI& env, ArrayAccess* e, bool& success) {
     ArrayLit* al = eval_array_lit(env,e->v());
@@ -437,7 +509,7 @@ namespace MiniZinc {
     case Expression::E_COMP:
       {
         Comprehension* c = e->cast<Comprehension>();
-        std::vector<IntVal> a = eval_comp<EvalIntVal>(env,c);
+        std::vector<IntVal> a = eval_comp_int(env,c);
         return IntSetVal::a(a);
       }
     case Expression::E_ID:
@@ -468,32 +540,15 @@ namespace MiniZinc {
         if (bo->lhs()->type().isintset() && bo->rhs()->type().isintset()) {
           IntSetVal* v0 = eval_intset(env,bo->lhs());
           IntSetVal* v1 = eval_intset(env,bo->rhs());
-          IntSetRanges ir0(v0);
-          IntSetRanges ir1(v1);
           switch (bo->op()) {
           case BOT_UNION:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+            return IntSetVal::unite(v0,v1);
           case BOT_DIFF:
-            {
-              Ranges::Diff<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+            return IntSetVal::diff(v0,v1);
           case BOT_SYMDIFF:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              Ranges::Inter<IntSetRanges,IntSetRanges> i(ir0,ir1);
-              Ranges::Diff<Ranges::Union<IntSetRanges,IntSetRanges>,
-                           Ranges::Inter<IntSetRanges,IntSetRanges>> sd(u,i);
-              return IntSetVal::ai(sd);
-            }
+            return IntSetVal::symdiff(v0,v1);
           case BOT_INTERSECT:
-            {
-              Ranges::Inter<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+            return IntSetVal::intersect(v0,v1);
           default: throw EvalError(env, e->loc(),"not a set of int expression", bo->opToString());
           }
         } else if (bo->lhs()->type().isint() && bo->rhs()->type().isint()) {
@@ -527,9 +582,8 @@ namespace MiniZinc {
     case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         IntSetVal* ret = eval_intset(env,l->in());
-        l->popbindings();
         return ret;
       }
       break;
@@ -719,15 +773,14 @@ namespace MiniZinc {
         if (ce->decl()->e()==NULL)
           throw EvalError(env, ce->loc(), "internal error: missing builtin '"+ce->id().str()+"'");
         
-        return eval_call<EvalBoolVal>(env,ce);
+        return eval_call_int(env,ce)!=0;
       }
       break;
     case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         bool ret = eval_bool(env,l->in());
-        l->popbindings();
         return ret;
       }
       break;
@@ -801,32 +854,15 @@ namespace MiniZinc {
         if (bo->lhs()->type().isintset() && bo->rhs()->type().isintset()) {
           IntSetVal* v0 = eval_boolset(env,bo->lhs());
           IntSetVal* v1 = eval_boolset(env,bo->rhs());
-          IntSetRanges ir0(v0);
-          IntSetRanges ir1(v1);
           switch (bo->op()) {
             case BOT_UNION:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+              return IntSetVal::unite(v0,v1);
             case BOT_DIFF:
-            {
-              Ranges::Diff<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+              return IntSetVal::diff(v0,v1);
             case BOT_SYMDIFF:
-            {
-              Ranges::Union<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              Ranges::Inter<IntSetRanges,IntSetRanges> i(ir0,ir1);
-              Ranges::Diff<Ranges::Union<IntSetRanges,IntSetRanges>,
-              Ranges::Inter<IntSetRanges,IntSetRanges>> sd(u,i);
-              return IntSetVal::ai(sd);
-            }
+              return IntSetVal::symdiff(v0,v1);
             case BOT_INTERSECT:
-            {
-              Ranges::Inter<IntSetRanges,IntSetRanges> u(ir0,ir1);
-              return IntSetVal::ai(u);
-            }
+              return IntSetVal::intersect(v0,v1);
             default: throw EvalError(env, e->loc(),"not a set of bool expression", bo->opToString());
           }
         } else if (bo->lhs()->type().isbool() && bo->rhs()->type().isbool()) {
@@ -860,9 +896,8 @@ namespace MiniZinc {
       case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         IntSetVal* ret = eval_boolset(env,l->in());
-        l->popbindings();
         return ret;
       }
         break;
@@ -958,15 +993,14 @@ namespace MiniZinc {
           if (ce->decl()->e()==NULL)
             throw EvalError(env, ce->loc(), "internal error: missing builtin '"+ce->id().str()+"'");
           
-          return eval_call<EvalIntVal>(env,ce);
+          return eval_call_int(env,ce);
         }
           break;
         case Expression::E_LET:
         {
           Let* l = e->cast<Let>();
-          l->pushbindings();
+          Bindings bindings(l);
           IntVal ret = eval_int(env,l->in());
-          l->popbindings();
           return ret;
         }
           break;
@@ -1068,9 +1102,8 @@ namespace MiniZinc {
       case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         FloatVal ret = eval_float(env,l->in());
-        l->popbindings();
         return ret;
       }
         break;
@@ -1150,9 +1183,8 @@ namespace MiniZinc {
       case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         std::string ret = eval_string(env,l->in());
-        l->popbindings();
         return ret;
       }
         break;
@@ -1160,6 +1192,74 @@ namespace MiniZinc {
     }
   }
 
+  /**
+   * \brief Evaluate the elements of \a al into packed storage
+   *
+   * Returns NULL if \a al is not a non-empty par array of integers,
+   * floats or Booleans.
+   */
+  ASTParVecO* eval_packed(EnvI& env, ArrayLit* al) {
+    if (ASTParVecO* pv = al->packed())
+      return pv;
+    Type t = al->type();
+    if (!t.ispar() || t.st()!=Type::ST_PLAIN || t.isopt() || al->size()==0)
+      return NULL;
+    ASTExprVec<Expression> v = al->v();
+    switch (t.bt()) {
+    case Type::BT_INT:
+      {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_INT,v.size());
+        for (unsigned int i=v.size(); i--;) {
+          IntVal iv = eval_int(env,v[i]);
+          if (!iv.isFinite())
+            return NULL;
+          pv->i(i) = iv.toInt();
+        }
+        return pv;
+      }
+    case Type::BT_FLOAT:
+      {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_FLOAT,v.size());
+        for (unsigned int i=v.size(); i--;)
+          pv->f(i) = eval_float(env,v[i]);
+        return pv;
+      }
+    case Type::BT_BOOL:
+      {
+        ASTParVecO* pv = ASTParVecO::a(ASTParVecO::PV_BOOL,v.size());
+        for (unsigned int i=v.size(); i--;)
+          pv->b(i,eval_bool(env,v[i]));
+        return pv;
+      }
+    default:
+      return NULL;
+    }
+  }
+
+  /// Evaluate all elements of \a al, packing par integers, floats and Booleans
+  ArrayLit* eval_par_array(EnvI& env, ArrayLit* al) {
+    std::vector<std::pair<int,int> > dims(al->dims());
+    for (unsigned int i=al->dims(); i--;) {
+      dims[i].first = al->min(i);
+      dims[i].second = al->max(i);
+    }
+    if (ASTParVecO* pv = eval_packed(env,al)) {
+      ArrayLit* ret = new ArrayLit(al->loc(),pv,dims);
+      ret->type(al->type());
+      return ret;
+    }
+    std::vector<Expression*> args(al->v().size());
+    for (unsigned int i=al->v().size(); i--;)
+      args[i] = eval_par(env,al->v()[i]);
+    ArrayLit* ret = new ArrayLit(al->loc(),args,dims);
+    Type t = al->type();
+    if (t.isbot() && ret->v().size() > 0) {
+      t.bt(ret->v()[0]->type().bt());
+    }
+    ret->type(t);
+    return ret;
+  }
+
   Expression* eval_par(EnvI& env, Expression* e) {
     if (e==NULL) return NULL;
     switch (e->eid()) {
@@ -1173,24 +1273,7 @@ namespace MiniZinc {
         return EvalSetLit::e(env,e);
       // fall through
     case Expression::E_ARRAYLIT:
-      {
-        ArrayLit* al = eval_array_lit(env,e);
-        std::vector<Expression*> args(al->v().size());
-        for (unsigned int i=al->v().size(); i--;)
-          args[i] = eval_par(env,al->v()[i]);
-        std::vector<std::pair<int,int> > dims(al->dims());
-        for (unsigned int i=al->dims(); i--;) {
-          dims[i].first = al->min(i);
-          dims[i].second = al->max(i);
-        }
-        ArrayLit* ret = new ArrayLit(al->loc(),args,dims);
-        Type t = al->type();
-        if (t.isbot() && ret->v().size() > 0) {
-          t.bt(ret->v()[0]->type().bt());
-        }
-        ret->type(t);
-        return ret;
-      }
+      return eval_par_array(env,eval_array_lit(env,e));
     case Expression::E_VARDECL:
       {
         VarDecl* vd = e->cast<VarDecl>();
@@ -1246,22 +1329,7 @@ namespace MiniZinc {
     default:
       {
         if (e->type().dim() != 0) {
-          ArrayLit* al = eval_array_lit(env,e);
-          std::vector<Expression*> args(al->v().size());
-          for (unsigned int i=al->v().size(); i--;)
-            args[i] = eval_par(env,al->v()[i]);
-          std::vector<std::pair<int,int> > dims(al->dims());
-          for (unsigned int i=al->dims(); i--;) {
-            dims[i].first = al->min(i);
-            dims[i].second = al->max(i);
-          }
-          ArrayLit* ret = new ArrayLit(al->loc(),args,dims);
-          Type t = al->type();
-          if (t.isbot() && ret->v().size() > 0) {
-            t.bt(ret->v()[0]->type().bt());
-          }
-          ret->type(t);
-          return ret;
+          return eval_par_array(env,eval_array_lit(env,e));
         }
         if (e->type().isintset()) {
           return EvalSetLit::e(env,e);
@@ -1357,6 +1425,8 @@ namespace MiniZinc {
     typedef std::pair<IntVal,IntVal> Bounds;
     std::vector<Bounds> _bounds;
     bool valid;
+    /// Declarations and type-insts the bounds were computed from
+    std::vector<const ASTNode*> deps;
     EnvI& env;
     ComputeIntBounds(EnvI& env0) : valid(true), env(env0) {}
     bool enter(Expression* e) {
@@ -1429,11 +1499,24 @@ namespace MiniZinc {
       valid = false;
       _bounds.push_back(Bounds(0,0));
     }
+    /// Record the declarations \a e refers to through a chain of identifiers
+    void dependId(Expression* e) {
+      while (e && e->isa<Id>()) {
+        VarDecl* vd = e->cast<Id>()->decl();
+        deps.push_back(vd);
+        deps.push_back(vd->ti());
+        e = vd->e();
+      }
+    }
     /// Visit identifier
     void vId(const Id& id) {
       VarDecl* vd = id.decl();
-      while (vd->flat() && vd->flat() != vd)
+      deps.push_back(vd);
+      while (vd->flat() && vd->flat() != vd) {
         vd = vd->flat();
+        deps.push_back(vd);
+      }
+      deps.push_back(vd->ti());
       if (vd->ti()->domain()) {
         GCLock lock;
         IntSetVal* isv = eval_intset(env,vd->ti()->domain());
@@ -1445,8 +1528,24 @@ namespace MiniZinc {
         }
       } else {
         if (vd->e()) {
-          BottomUpIterator<ComputeIntBounds> cbi(*this);
-          cbi.run(vd->e());
+          IntVal l, u;
+          bool v;
+          if (!env.intBounds.find(vd,l,u,v)) {
+            unsigned long int changes = env.intBounds.changes();
+            ComputeIntBounds cb(env);
+            BottomUpIterator<ComputeIntBounds> cbi(cb);
+            cbi.run(vd->e());
+            v = cb.valid;
+            if (v) {
+              assert(cb._bounds.size() > 0);
+              l = cb._bounds.back().first;
+              u = cb._bounds.back().second;
+            }
+            env.intBounds.insert(vd,changes,cb.deps,l,u,v);
+          }
+          if (!v)
+            valid = false;
+          _bounds.push_back(Bounds(l,u));
         } else {
           _bounds.push_back(Bounds(-IntVal::infinity,IntVal::infinity));
         }
@@ -1469,6 +1568,7 @@ namespace MiniZinc {
           parAccess = false;
         }
       }
+      dependId(aa.v());
       if (Id* id = aa.v()->dyn_cast<Id>()) {
         while (id->decl()->e() && id->decl()->e()->isa<Id>()) {
           id = id->decl()->e()->cast<Id>();
@@ -1605,6 +1705,7 @@ namespace MiniZinc {
     void vCall(Call& c) {
       if (c.id() == constants().ids.lin_exp || c.id() == constants().ids.sum) {
         bool le = c.id() == constants().ids.lin_exp;
+        dependId(c.args()[le ? 1 : 0]);
         ArrayLit* coeff = le ? eval_array_lit(env,c.args()[0]): NULL;
         ArrayLit* al = eval_array_lit(env,c.args()[le ? 1 : 0]);
         IntVal d = le ? c.args()[2]->cast<IntLit>()->v() : 0;
@@ -1746,6 +1847,8 @@ namespace MiniZinc {
   public:
     std::vector<FBounds> _bounds;
     bool valid;
+    /// Declarations and type-insts the bounds were computed from
+    std::vector<const ASTNode*> deps;
     EnvI& env;
     ComputeFloatBounds(EnvI& env0) : valid(true), env(env0) {}
     bool enter(Expression* e) {
@@ -1789,19 +1892,49 @@ namespace MiniZinc {
       valid = false;
       _bounds.push_back(FBounds(0.0,0.0));
     }
+    /// Record the declarations \a e refers to through a chain of identifiers
+    void dependId(Expression* e) {
+      while (e && e->isa<Id>()) {
+        VarDecl* vd = e->cast<Id>()->decl();
+        deps.push_back(vd);
+        deps.push_back(vd->ti());
+        e = vd->e();
+      }
+    }
     /// Visit identifier
     void vId(const Id& id) {
       VarDecl* vd = id.decl();
-      while (vd->flat() && vd->flat() != vd)
+      deps.push_back(vd);
+      while (vd->flat() && vd->flat() != vd) {
         vd = vd->flat();
+        deps.push_back(vd);
+      }
+      deps.push_back(vd->ti());
       if (vd->ti()->domain()) {
         BinOp* bo = vd->ti()->domain()->cast<BinOp>();
         assert(bo->op() == BOT_DOTDOT);
         _bounds.push_back(FBounds(eval_float(env,bo->lhs()),eval_float(env,bo->rhs())));
       } else {
         if (vd->e()) {
-          BottomUpIterator<ComputeFloatBounds> cbi(*this);
-          cbi.run(vd->e());
+          FloatVal l = 0.0;
+          FloatVal u = 0.0;
+          bool v;
+          if (!env.floatBounds.find(vd,l,u,v)) {
+            unsigned long int changes = env.floatBounds.changes();
+            ComputeFloatBounds cb(env);
+            BottomUpIterator<ComputeFloatBounds> cbi(cb);
+            cbi.run(vd->e());
+            v = cb.valid;
+            if (v) {
+              assert(cb._bounds.size() > 0);
+              l = cb._bounds.back().first;
+              u = cb._bounds.back().second;
+            }
+            env.floatBounds.insert(vd,changes,cb.deps,l,u,v);
+          }
+          if (!v)
+            valid = false;
+          _bounds.push_back(FBounds(l,u));
         } else {
           valid = false;
           _bounds.push_back(FBounds(0,0));
@@ -1824,6 +1957,7 @@ namespace MiniZinc {
           parAccess = false;
         }
       }
+      dependId(aa.v());
       if (Id* id = aa.v()->dyn_cast<Id>()) {
         while (id->decl()->e() && id->decl()->e()->isa<Id>()) {
           id = id->decl()->e()->cast<Id>();
@@ -1926,6 +2060,7 @@ namespace MiniZinc {
     void vCall(Call& c) {
       if (c.id() == constants().ids.lin_exp || c.id() == constants().ids.sum) {
         bool le = c.id() == constants().ids.lin_exp;
+        dependId(c.args()[le ? 1 : 0]);
         ArrayLit* coeff = le ? eval_array_lit(env,c.args()[0]): NULL;
         ArrayLit* al = eval_array_lit(env,c.args()[le ? 1 : 0]);
         FloatVal d = le ? c.args()[2]->cast<FloatLit>()->v() : 0.0;
@@ -2147,10 +2282,7 @@ namespace MiniZinc {
         case BOT_INTERSECT:
         case BOT_UNION:
           {
-            IntSetRanges b0r(b0);
-            IntSetRanges b1r(b1);
-            Ranges::Union<IntSetRanges,IntSetRanges> u(b0r,b1r);
-            _bounds.push_back(IntSetVal::ai(u));
+            _bounds.push_back(IntSetVal::unite(b0,b1));
           }
           break;
         case BOT_DIFF:
@@ -2200,10 +2332,7 @@ namespace MiniZinc {
       if (c.id() == "set_intersect" || c.id() == "set_union") {
         IntSetVal* b0 = _bounds.back(); _bounds.pop_back();
         IntSetVal* b1 = _bounds.back(); _bounds.pop_back();
-        IntSetRanges b0r(b0);
-        IntSetRanges b1r(b1);
-        Ranges::Union<IntSetRanges,IntSetRanges> u(b0r,b1r);
-        _bounds.push_back(IntSetVal::ai(u));
+        _bounds.push_back(IntSetVal::unite(b0,b1));
       } else if (c.id() == "set_diff") {
         IntSetVal* b0 = _bounds.back(); _bounds.pop_back();
         _bounds.pop_back(); // don't need bounds of right hand side
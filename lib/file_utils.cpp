@@ -29,6 +29,8 @@
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fstream>
+#include <functional>
 
 namespace MiniZinc { namespace FileUtils {
   
@@ -128,4 +130,94 @@ namespace MiniZinc { namespace FileUtils {
 #endif
   }
   
+  bool read_file(const std::string& filename, std::string& contents) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in.is_open())
+      return false;
+    in.seekg(0, std::ios::end);
+    std::streamoff size = in.tellg();
+    if (size < 0)
+      return false;
+    contents.resize(static_cast<size_t>(size));
+    in.seekg(0, std::ios::beg);
+    if (size > 0)
+      in.read(&contents[0], contents.size());
+    return !in.fail();
+  }
+
+  namespace {
+    FileReader::Result read_first(const std::vector<std::string>& candidates) {
+      FileReader::Result r;
+      for (unsigned int i=0; i<candidates.size(); i++) {
+        if (file_exists(candidates[i]) && read_file(candidates[i], r.contents)) {
+          r.filename = candidates[i];
+          r.success = true;
+          break;
+        }
+      }
+      return r;
+    }
+  }
+
+  FileReader::FileReader(unsigned int nThreads)
+    : _maxThreads(nThreads), _idle(0), _done(false) {
+    if (_maxThreads==0) {
+      _maxThreads = std::thread::hardware_concurrency();
+      if (_maxThreads==0)
+        _maxThreads = 1;
+      else if (_maxThreads > 8)
+        _maxThreads = 8;
+    }
+  }
+
+  FileReader&
+  FileReader::shared(void) {
+    static FileReader reader;
+    return reader;
+  }
+
+  FileReader::~FileReader(void) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done = true;
+      _queue.clear();
+    }
+    _cv.notify_all();
+    for (unsigned int i=0; i<_threads.size(); i++)
+      _threads[i].join();
+  }
+
+  std::shared_future<FileReader::Result>
+  FileReader::read(const std::vector<std::string>& candidates) {
+    std::packaged_task<Result()> task(std::bind(read_first, candidates));
+    std::shared_future<Result> ret = task.get_future().share();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _queue.push_back(std::move(task));
+      if (_idle < _queue.size() && _threads.size() < _maxThreads)
+        _threads.push_back(std::thread(&FileReader::run, this));
+    }
+    _cv.notify_one();
+    return ret;
+  }
+
+  void
+  FileReader::run(void) {
+    for (;;) {
+      std::packaged_task<Result()> task;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle++;
+        while (!_done && _queue.empty())
+          _cv.wait(lock);
+        _idle--;
+        if (_done)
+          return;
+        task = std::move(_queue.front());
+        _queue.pop_front();
+      }
+      task();
+    }
+  }
+
 }}
@@ -15,9 +15,12 @@
 #include <minizinc/hash.hh>
 #include <minizinc/astexception.hh>
 #include <minizinc/optimize.hh>
+#include <minizinc/linearize.hh>
+#include <minizinc/propagate.hh>
 #include <minizinc/astiterator.hh>
 
 #include <minizinc/stl_map_set.hh>
+#include <cstring>
 
 #include <minizinc/flatten_internal.hh>
 
@@ -167,9 +170,362 @@ namespace MiniZinc {
     return vd;
   }
 
+  namespace {
+    /// Kinds of packed CSE key components
+    enum CSEKind { CK_ID, CK_INT, CK_FLOAT, CK_BOOL, CK_SET, CK_ARRAY, CK_ELEMS, CK_MIXED };
+    /// Return tag word for component kind \a k of type \a t
+    inline unsigned long long cse_tag(CSEKind k, const Type& t) {
+      return static_cast<unsigned long long>(k) |
+        (static_cast<unsigned long long>(static_cast<unsigned int>(t.toInt())) << 32);
+    }
+    /// Finalisation step of the 64-bit MurmurHash3
+    inline unsigned long long cse_mix(unsigned long long x) {
+      x ^= x >> 33;
+      x *= 0xff51afd7ed558ccdULL;
+      x ^= x >> 33;
+      x *= 0xc4ceb9fe1a85ec53ULL;
+      x ^= x >> 33;
+      return x;
+    }
+    /// Compute kind \a k and value \a v of scalar \a e, return false if not packable
+    bool cse_scalar(Expression* e, CSEKind& k, unsigned long long& v) {
+      switch (e->eid()) {
+        case Expression::E_ID:
+          {
+            VarDecl* vd = e->cast<Id>()->decl();
+            if (vd==NULL)
+              return false;
+            k = CK_ID;
+            v = reinterpret_cast<uintptr_t>(vd);
+            return true;
+          }
+        case Expression::E_INTLIT:
+          {
+            IntVal i = e->cast<IntLit>()->v();
+            if (!i.isFinite())
+              return false;
+            k = CK_INT;
+            v = static_cast<unsigned long long>(i.toInt());
+            return true;
+          }
+        case Expression::E_FLOATLIT:
+          {
+            FloatVal f = e->cast<FloatLit>()->v();
+            k = CK_FLOAT;
+            std::memcpy(&v, &f, sizeof(v));
+            return true;
+          }
+        case Expression::E_BOOLLIT:
+          k = CK_BOOL;
+          v = e->cast<BoolLit>()->v();
+          return true;
+        default:
+          return false;
+      }
+    }
+    /// Sink that hashes the words of a CSE key
+    class CSEHashSink {
+    public:
+      unsigned long long h;
+      unsigned int n;
+      CSEHashSink(void) : h(0), n(0) {}
+      void reserve(unsigned int) {}
+      bool put(unsigned long long w) { h = cse_mix(h ^ w); n++; return true; }
+      /// Return the hash of all words
+      size_t hash(void) const { return static_cast<size_t>(cse_mix(h ^ n)); }
+    };
+    /// Sink that stores the words of a CSE key
+    class CSEStoreSink {
+    public:
+      std::vector<unsigned long long>& k;
+      CSEStoreSink(std::vector<unsigned long long>& k0) : k(k0) {}
+      void reserve(unsigned int n) { k.reserve(n); }
+      bool put(unsigned long long w) { k.push_back(w); return true; }
+    };
+    /// Sink that compares the words of a CSE key against stored words
+    class CSECompareSink {
+    public:
+      const std::vector<unsigned long long>& k;
+      unsigned int n;
+      CSECompareSink(const std::vector<unsigned long long>& k0) : k(k0), n(0) {}
+      void reserve(unsigned int) {}
+      bool put(unsigned long long w) { return n < k.size() && k[n++]==w; }
+      /// Return whether all stored words have been matched
+      bool done(void) const { return n==k.size(); }
+    };
+  }
+
+  CSEKey::CSEKey(Expression* e, bool store)
+    : _e(store ? e : NULL), _lookup(store ? NULL : e), _packed(false) {
+    if (Call* c = e->dyn_cast<Call>()) {
+      if (store) {
+        CSEStoreSink sink(_k);
+        _packed = pack(c, sink);
+        if (_packed) {
+          CSEHashSink hs;
+          for (unsigned int i=0; i<_k.size(); i++)
+            hs.put(_k[i]);
+          _hash = hs.hash();
+        } else {
+          std::vector<unsigned long long>().swap(_k);
+        }
+      } else {
+        CSEHashSink hs;
+        _packed = pack(c, hs);
+        if (_packed)
+          _hash = hs.hash();
+      }
+    }
+    if (!_packed)
+      _hash = Expression::hash(e);
+  }
+
+  template<class Sink>
+  bool
+  CSEKey::pack(Call* c, Sink& sink) {
+    if (c->decl()==NULL)
+      return false;
+    // Reserve the size of the key assuming uniform arrays, so that keys
+    // stored in the map do not carry spare capacity
+    unsigned int words = 4;
+    for (unsigned int i=0; i<c->args().size(); i++) {
+      if (ArrayLit* al = c->args()[i]->dyn_cast<ArrayLit>())
+        words += 5 + 2*al->dims() + al->size();
+      else if (SetLit* sl = c->args()[i]->dyn_cast<SetLit>())
+        words += 2 + (sl->isv() ? 2*sl->isv()->size() : 0);
+      else
+        words += 2;
+    }
+    sink.reserve(words);
+    // Identifiers are interned, and the call keeps its identifier alive
+    // for as long as the key exists, so the string can be keyed by address
+    if (!sink.put(reinterpret_cast<uintptr_t>(c->decl())) ||
+        !sink.put(reinterpret_cast<uintptr_t>(c->id().aststr())) ||
+        !sink.put(cse_tag(CK_ARRAY, c->type())) ||
+        !sink.put(c->args().size()))
+      return false;
+    for (unsigned int i=0; i<c->args().size(); i++) {
+      if (!packArg(c->args()[i], sink))
+        return false;
+    }
+    return true;
+  }
+
+  template<class Sink>
+  bool
+  CSEKey::packArg(Expression* a, Sink& sink) {
+    CSEKind k;
+    unsigned long long v;
+    if (cse_scalar(a, k, v))
+      return sink.put(cse_tag(k, a->type())) && sink.put(v);
+    if (SetLit* sl = a->dyn_cast<SetLit>()) {
+      IntSetVal* isv = sl->isv();
+      if (isv==NULL)
+        return false;
+      if (!sink.put(cse_tag(CK_SET, a->type())) || !sink.put(isv->size()))
+        return false;
+      for (int i=0; i<isv->size(); i++) {
+        if (!isv->min(i).isFinite() || !isv->max(i).isFinite())
+          return false;
+        if (!sink.put(static_cast<unsigned long long>(isv->min(i).toInt())) ||
+            !sink.put(static_cast<unsigned long long>(isv->max(i).toInt())))
+          return false;
+      }
+      return true;
+    }
+    ArrayLit* al = a->dyn_cast<ArrayLit>();
+    if (al==NULL)
+      return false;
+    if (!sink.put(cse_tag(CK_ARRAY, a->type())) || !sink.put(al->dims()))
+      return false;
+    for (int i=0; i<al->dims(); i++) {
+      if (!sink.put(static_cast<unsigned long long>(al->min(i))) ||
+          !sink.put(static_cast<unsigned long long>(al->max(i))))
+        return false;
+    }
+    unsigned int n = al->size();
+    if (ASTParVecO* pv = al->packed()) {
+      // Same key as for the literals the array would be materialised into
+      Type t;
+      switch (pv->kind()) {
+        case ASTParVecO::PV_INT: k = CK_INT; t = Type::parint(); break;
+        case ASTParVecO::PV_FLOAT: k = CK_FLOAT; t = Type::parfloat(); break;
+        default: k = CK_BOOL; t = Type::parbool(); break;
+      }
+      if (!sink.put(cse_tag(CK_ELEMS, Type())) || !sink.put(n))
+        return false;
+      if (n > 0 && !sink.put(cse_tag(k, t)))
+        return false;
+      for (unsigned int i=0; i<n; i++) {
+        switch (k) {
+          case CK_INT:
+            {
+              long long int iv = pv->i(i);
+              if (!IntVal(iv).isFinite())
+                return false;
+              v = static_cast<unsigned long long>(iv);
+            }
+            break;
+          case CK_FLOAT:
+            {
+              FloatVal fv = pv->f(i);
+              std::memcpy(&v, &fv, sizeof(v));
+            }
+            break;
+          default:
+            v = pv->b(i);
+            break;
+        }
+        if (!sink.put(v))
+          return false;
+      }
+      return true;
+    }
+    // Arrays whose elements all have the same kind and type store a single tag
+    ASTExprVec<Expression> elems = al->v();
+    bool uniform = true;
+    CSEKind k0 = CK_ID;
+    for (unsigned int i=0; i<n; i++) {
+      if (!cse_scalar(elems[i], k, v))
+        return false;
+      if (i==0)
+        k0 = k;
+      else if (k != k0 || elems[i]->type() != elems[0]->type())
+        uniform = false;
+    }
+    if (!sink.put(cse_tag(uniform ? CK_ELEMS : CK_MIXED, Type())) || !sink.put(n))
+      return false;
+    if (uniform && n > 0 && !sink.put(cse_tag(k0, elems[0]->type())))
+      return false;
+    for (unsigned int i=0; i<n; i++) {
+      cse_scalar(elems[i], k, v);
+      if (!uniform && !sink.put(cse_tag(k, elems[i]->type())))
+        return false;
+      if (!sink.put(v))
+        return false;
+    }
+    return true;
+  }
+
+  bool
+  CSEKey::operator ==(const CSEKey& k) const {
+    if (_hash != k._hash || _packed != k._packed)
+      return false;
+    if (!_packed)
+      return Expression::equal((*this)(),k());
+    if (_lookup==NULL && k._lookup==NULL)
+      return _k.size()==k._k.size() &&
+        std::memcmp(&_k[0], &k._k[0], _k.size()*sizeof(unsigned long long))==0;
+    // Compare the expression of the lookup key against the stored words
+    const CSEKey& stored = _lookup==NULL ? *this : k;
+    const CSEKey& lookup = _lookup==NULL ? k : *this;
+    if (stored._lookup != NULL) {
+      CSEKey sk(lookup(), true);
+      return sk==stored;
+    }
+    CSECompareSink sink(stored._k);
+    return pack(lookup()->cast<Call>(), sink) && sink.done();
+  }
+
 #define MZN_FILL_REIFY_MAP(T,ID) reifyMap.insert(std::pair<ASTString,ASTString>(constants().ids.T.ID,constants().ids.T ## reif.ID));
 
-  EnvI::EnvI(Model* orig0) : orig(orig0), output(new Model), ignorePartial(false), maxCallStack(0), collect_vardecls(false), in_redundant_constraint(0), _flat(new Model), ids(0) {
+  namespace {
+    /// Make calls to frozen library functions use the copies of \a env
+    class LibraryCalls : public EVisitor {
+    public:
+      EnvI& env;
+      LibraryCalls(EnvI& env0) : env(env0) {}
+      void vCall(Call& c) {
+        c.decl(env.libraryFn(c.decl()));
+      }
+    };
+
+    /**
+     * \brief Return the view of frozen library model \a lib in \a env
+     *
+     * The view shares the function items of \a lib and contains copies of
+     * all other items, so that its declarations can be assigned, typechecked
+     * and flattened like those of any other model. Sets \a created if the
+     * view did not exist yet.
+     */
+    Model* libraryView(EnvI& env, Model* lib, Model* parent, bool& created) {
+      if (Model* v = env.libraryMap.find(lib)) {
+        created = false;
+        return v;
+      }
+      created = true;
+      Model* v = new Model;
+      env.libraryMap.insert(lib, v);
+      v->setParent(parent);
+      v->setFilename(lib->filename().str());
+      v->setFilepath(lib->filepath().str());
+      LibraryCalls lc(env);
+      for (unsigned int i=0; i<lib->size(); i++) {
+        Item* item = (*lib)[i];
+        if (item->removed())
+          continue;
+        switch (item->iid()) {
+        case Item::II_INC:
+          {
+            IncludeI* ii = item->cast<IncludeI>();
+            IncludeI* c = new IncludeI(ii->loc(), ii->f());
+            bool own;
+            Model* im = libraryView(env, ii->m(), v, own);
+            c->m(im, own);
+            v->addItem(c);
+          }
+          break;
+        case Item::II_FUN:
+          v->addItem(item);
+          break;
+        default:
+          {
+            Item* c = copy(env, env.libraryMap, item);
+            switch (c->iid()) {
+            case Item::II_VD:
+              topDown(lc, c->cast<VarDeclI>()->e());
+              break;
+            case Item::II_CON:
+              topDown(lc, c->cast<ConstraintI>()->e());
+              break;
+            case Item::II_SOL:
+              topDown(lc, c->cast<SolveI>()->e());
+              break;
+            case Item::II_OUT:
+              topDown(lc, c->cast<OutputI>()->e());
+              break;
+            default:
+              break;
+            }
+            v->addItem(c);
+          }
+          break;
+        }
+      }
+      return v;
+    }
+
+    /// Replace frozen library models included by \a m with their views
+    void includeLibraryViews(EnvI& env, Model* m,
+                             UNORDERED_NAMESPACE::unordered_set<Model*>& seen) {
+      if (!seen.insert(m).second)
+        return;
+      for (unsigned int i=0; i<m->size(); i++) {
+        if (IncludeI* ii = (*m)[i]->dyn_cast<IncludeI>()) {
+          if (ii->m()->frozen()) {
+            bool own;
+            Model* v = libraryView(env, ii->m(), m, own);
+            ii->m(NULL);
+            ii->m(v, own);
+          } else {
+            includeLibraryViews(env, ii->m(), seen);
+          }
+        }
+      }
+    }
+  }
+
+  EnvI::EnvI(Model* orig0) : orig(orig0), output(new Model), ignorePartial(false), maxCallStack(0), collect_vardecls(false), in_redundant_constraint(0), bytecode_disabled(0), halfReifications(false), _flat(new Model), _libraryFns(new Model), ids(0) {
     MZN_FILL_REIFY_MAP(int_,lin_eq);
     MZN_FILL_REIFY_MAP(int_,lin_le);
     MZN_FILL_REIFY_MAP(int_,lin_ne);
@@ -203,22 +559,43 @@ namespace MiniZinc {
     reifyMap.insert(std::pair<ASTString,ASTString>(constants().ids.bool_eq,constants().ids.bool_eq_reif));
     reifyMap.insert(std::pair<ASTString,ASTString>(constants().ids.bool_clause,constants().ids.bool_clause_reif));
     reifyMap.insert(std::pair<ASTString,ASTString>(constants().ids.clause,constants().ids.bool_clause_reif));
+    if (orig) {
+      GCLock lock;
+      UNORDERED_NAMESPACE::unordered_set<Model*> seen;
+      includeLibraryViews(*this, orig, seen);
+    }
   }
   EnvI::~EnvI(void) {
     delete _flat;
     delete output;
+    delete _libraryFns;
+  }
+  FunctionI* EnvI::libraryFn(FunctionI* fi) {
+    if (fi==NULL || !fi->immortal() || fi->e()==NULL)
+      return fi;
+    if (Item* c = libraryMap.find(fi))
+      return c->cast<FunctionI>();
+    GCLock lock;
+    FunctionI* c = copy(*this, libraryMap, fi)->cast<FunctionI>();
+    _libraryFns->addItem(c);
+    LibraryCalls lc(*this);
+    topDown(lc, c->ti());
+    for (unsigned int i=0; i<c->params().size(); i++)
+      topDown(lc, c->params()[i]);
+    for (ExpressionSetIter it = c->ann().begin(); it != c->ann().end(); ++it)
+      topDown(lc, *it);
+    topDown(lc, c->e());
+    return c;
   }
   long long int
   EnvI::genId(void) {
       return ids++;
     }
   void EnvI::map_insert(Expression* e, const EE& ee) {
-      KeepAlive ka(e);
-      map.insert(ka,WW(ee.r(),ee.b()));
+      map.insert(std::pair<CSEKey,WW>(CSEKey(e,true),WW(ee.r(),ee.b())));
     }
   EnvI::Map::iterator EnvI::map_find(Expression* e) {
-    KeepAlive ka(e);
-    Map::iterator it = map.find(ka);
+    Map::iterator it = map.find(CSEKey(e,false));
     if (it != map.end()) {
       if (it->second.r()) {
         if (it->second.r()->isa<VarDecl>()) {
@@ -233,21 +610,15 @@ namespace MiniZinc {
     return it;
   }
   void EnvI::map_remove(Expression* e) {
-    KeepAlive ka(e);
-    map.remove(ka);
+    map.erase(CSEKey(e,false));
   }
   EnvI::Map::iterator EnvI::map_end(void) {
     return map.end();
   }
   void EnvI::dump(void) {
-    struct EED {
-      static std::string d(const WW& ee) {
-        std::ostringstream oss;
-        oss << ee.r() << " " << ee.b();
-        return oss.str();
-      }
-    };
-    map.dump<EED>();
+    for (Map::iterator it = map.begin(); it != map.end(); ++it) {
+      std::cerr << it->first() << ": " << it->second.r() << " " << it->second.b() << std::endl;
+    }
   }
   
   void EnvI::flat_addItem(Item* i) {
@@ -316,6 +687,39 @@ namespace MiniZinc {
   void EnvI::flat_removeItem(int i) {
     (*_flat)[i]->remove();
   }
+  void EnvI::flat_compact(void) {
+    Model& m = *_flat;
+    for (unsigned int i=0; i<m.size(); i++) {
+      if (m[i]->removed()) {
+        if (VarDeclI* vdi = m[i]->dyn_cast<VarDeclI>())
+          vo.idx.remove(vdi->e()->id());
+      }
+    }
+    m.compact();
+    // Queued declarations refer to the old item positions
+    domainQueue.clear();
+    // Items may have moved, so all declaration indices are updated
+    for (unsigned int i=0; i<m.size(); i++) {
+      if (VarDeclI* vdi = m[i]->dyn_cast<VarDeclI>()) {
+        IdMap<int>::iterator it = vo.idx.find(vdi->e()->id());
+        if (it != vo.idx.end())
+          it->second = i;
+      }
+    }
+    for (IdMap<VarOccurrences::Items>::iterator it = vo._m.begin();
+         it != vo._m.end(); ++it) {
+      std::vector<Item*> toRemove;
+      for (VarOccurrences::Items::iterator iit = it->second.begin();
+           iit != it->second.end(); ++iit) {
+        if ((*iit)->removed()) {
+          toRemove.push_back(*iit);
+        }
+      }
+      for (unsigned int i=0; i<toRemove.size(); i++) {
+        it->second.erase(toRemove[i]);
+      }
+    }
+  }
   
   void EnvI::collectVarDecls(bool b) {
     collect_vardecls = b;
@@ -337,6 +741,11 @@ namespace MiniZinc {
     if (collect_vardecls)
       modifiedVarDecls.push_back(idx);
   }
+  void EnvI::domainChanged(VarDecl* vd) {
+    IdMap<int>::iterator it = vo.idx.find(vd->id());
+    if (it != vo.idx.end() && (domainQueue.empty() || domainQueue.back() != it->second))
+      domainQueue.push_back(it->second);
+  }
   Model* EnvI::flat(void) {
     return _flat;
   }
@@ -348,6 +757,16 @@ namespace MiniZinc {
       return it->second;
     }
   }
+  ASTString EnvI::halfReifyId(const ASTString& id) {
+    if (id == constants().ids.exists) {
+      return constants().ids.array_bool_or.str()+"_imp";
+    } else if (id == constants().ids.forall) {
+      return constants().ids.array_bool_and.str()+"_imp";
+    }
+    std::string rid = reifyId(id).str();
+    // All reified identifiers end in _reif
+    return rid.substr(0,rid.size()-5)+"_imp";
+  }
 #undef MZN_FILL_REIFY_MAP
   
   void EnvI::addWarning(const std::string& msg) {
@@ -678,6 +1097,7 @@ namespace MiniZinc {
         } else {
           id->decl()->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(lb,IntVal::infinity)));
         }
+        env.domainChanged(id->decl());
         return false;
       } else if (e1->type().ispar() && e0->isa<Id>()) {
         // less than
@@ -696,6 +1116,7 @@ namespace MiniZinc {
         } else {
           id->decl()->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(-IntVal::infinity, ub)));
         }
+        env.domainChanged(id->decl());
       }
     } else if (c->id()==constants().ids.int_.lin_le) {
       ArrayLit* al_c = follow_id(c->args()[0])->cast<ArrayLit>();
@@ -727,6 +1148,7 @@ namespace MiniZinc {
           } else {
             id->decl()->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(lb, ub)));
           }
+          env.domainChanged(id->decl());
           return false;
         }
       }
@@ -847,8 +1269,15 @@ namespace MiniZinc {
             GCLock lock;
             ArrayLit* al = e->cast<ArrayLit>();
             /// TODO: review if limit of 10 is a sensible choice
-            if (al->type().bt()==Type::BT_ANN || al->v().size() <= 10)
+            if (al->type().bt()==Type::BT_ANN || al->size() <= 10)
               return e;
+            if (al->type().ispar()) {
+              // Reuse the declaration of an identical par array (e.g. a
+              // table accessed by several element constraints)
+              EnvI::Map::iterator it = env.map_find(al);
+              if (it != env.map_end() && it->second.r()->isa<VarDecl>())
+                return it->second.r()->cast<VarDecl>()->id();
+            }
 
             std::vector<TypeInst*> ranges(al->dims());
             for (unsigned int i=0; i<ranges.size(); i++) {
@@ -859,7 +1288,18 @@ namespace MiniZinc {
             ASTExprVec<TypeInst> ranges_v(ranges);
             assert(!al->type().isbot());
             Expression* domain = NULL;
-            if (al->v().size() > 0 && al->v()[0]->type().isint()) {
+            if (ASTParVecO* pv = al->packed()) {
+              // Read the bounds from the packed values, without creating literals
+              if (pv->kind()==ASTParVecO::PV_INT) {
+                long long int min = pv->i(0);
+                long long int max = min;
+                for (unsigned int i=1; i<pv->size(); i++) {
+                  min = std::min(min, pv->i(i));
+                  max = std::max(max, pv->i(i));
+                }
+                domain = new SetLit(Location().introduce(), IntSetVal::a(min,max));
+              }
+            } else if (al->v().size() > 0 && al->v()[0]->type().isint()) {
               IntVal min = IntVal::infinity;
               IntVal max = -IntVal::infinity;
               for (unsigned int i=0; i<al->v().size(); i++) {
@@ -910,10 +1350,7 @@ namespace MiniZinc {
                 while (id != NULL) {
                   if (id->decl()->ti()->domain()) {
                     IntSetVal* domain = eval_intset(env,id->decl()->ti()->domain());
-                    IntSetRanges dr(domain);
-                    IntSetRanges ibr(ibv);
-                    Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                    IntSetVal* newibv = IntSetVal::ai(i);
+                    IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
                     if (ibv->card() == newibv->card()) {
                       id->decl()->ti()->setComputedDomain(true);
                     } else {
@@ -1000,10 +1437,7 @@ namespace MiniZinc {
                         vdi->ti()->domain(vd->ti()->domain());
                       } else {
                         IntSetVal* vdi_dom = eval_intset(env, vdi->ti()->domain());
-                        IntSetRanges isvr(isv);
-                        IntSetRanges vdi_domr(vdi_dom);
-                        Ranges::Inter<IntSetRanges, IntSetRanges> inter(isvr,vdi_domr);
-                        IntSetVal* newdom = IntSetVal::ai(inter);
+                        IntSetVal* newdom = IntSetVal::intersect(isv,vdi_dom);
                         if (newdom->size()==0) {
                           env.flat()->fail(env);
                         } else {
@@ -1097,10 +1531,7 @@ namespace MiniZinc {
               if (ibv) {
                 if (vd->ti()->domain()) {
                   IntSetVal* domain = eval_intset(env,vd->ti()->domain());
-                  IntSetRanges dr(domain);
-                  IntSetRanges ibr(ibv);
-                  Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                  IntSetVal* newibv = IntSetVal::ai(i);
+                  IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
                   if (ibv->card() == newibv->card()) {
                     vd->ti()->setComputedDomain(true);
                   } else {
@@ -1550,8 +1981,35 @@ namespace MiniZinc {
             vars.push_back(e);
             break;
         }
-//      } else if (Call* call = e->dyn_cast<Call>()) {
-//        /// TODO! Handle sum, lin_exp (maybe not that important?)
+      } else if (Call* call = e->dyn_cast<Call>()) {
+        // Expand sum and lin_exp over arrays of known elements in place
+        ArrayLit* al = NULL;
+        ArrayLit* al_coeff = NULL;
+        if (call->decl() && call->decl()->e()==NULL) {
+          if (call->id()==constants().ids.sum && call->args().size()==1) {
+            al = Expression::dyn_cast<ArrayLit>(follow_id(call->args()[0]));
+          } else if (call->id()==constants().ids.lin_exp && call->args().size()==3 &&
+                     call->args()[0]->type().ispar() && call->args()[2]->type().ispar()) {
+            al = Expression::dyn_cast<ArrayLit>(follow_id(call->args()[1]));
+            if (al) {
+              al_coeff = eval_array_lit(env,call->args()[0]);
+              if (al_coeff->v().size() != al->v().size())
+                throw EvalError(env, call->loc(),
+                                "lin_exp: coefficient and variable arrays have different sizes");
+            }
+          }
+        }
+        if (al==NULL) {
+          coeffs.push_back(c);
+          vars.push_back(e);
+        } else if (al_coeff==NULL) {
+          for (unsigned int i=al->v().size(); i--;)
+            stack.push_back(StackItem(al->v()[i],c));
+        } else {
+          constval += c * LinearTraits<Lit>::eval(env,call->args()[2]);
+          for (unsigned int i=al->v().size(); i--;)
+            stack.push_back(StackItem(al->v()[i],c*LinearTraits<Lit>::eval(env,al_coeff->v()[i])));
+        }
       } else {
         coeffs.push_back(c);
         vars.push_back(e);
@@ -1686,11 +2144,106 @@ namespace MiniZinc {
 
   KeepAlive flat_cv_exp(EnvI& env, Ctx ctx, Expression* e);
   
+  /**
+   * \brief Flatten \a ite of the form if c then x else <> endif natively
+   *
+   * The resulting option variable is represented by the pair (c,x): calls
+   * to occurs and deopt on it are mapped to c and x directly, and a reverse
+   * mapper reconstructs its value for the output model. No auxiliary
+   * variables are introduced; only a declared domain of the result \a r
+   * is enforced on x if c holds. Returns false if \a ite does not have
+   * this form, or if c or x are partial.
+   */
+  bool flat_ite_opt(EnvI& env, Ctx ctx, ITE* ite, VarDecl* r, VarDecl* b, EE& ret) {
+    if (ite->size()!=1 || ite->e_else()!=constants().absent || r==constants().var_true ||
+        ite->type().dim()!=0 || !(ite->type().isint() || ite->type().isbool()) ||
+        ite->e_if(0)->type().ispar() || ite->e_then(0)->type().isopt())
+      return false;
+    // A result variable whose occurs or deopt has already been flattened
+    // has its own representation
+    if (r && (!r->type().isopt() || env.reverseMappers.find(r->id()) != env.reverseMappers.end()))
+      return false;
+    // Both c and x are used in positive and negative contexts
+    Ctx mctx;
+    mctx.b = C_MIX;
+    mctx.i = C_MIX;
+    EE ee_occ = flat_exp(env,mctx,ite->e_if(0),NULL,NULL);
+    EE ee_val = flat_exp(env,mctx,ite->e_then(0),NULL,NULL);
+    if (!istrue(env,ee_occ.b()) || !istrue(env,ee_val.b()) ||
+        !ee_occ.r()->isa<Id>())
+      return false;
+
+    GCLock lock;
+    VarDecl* nr = r;
+    if (nr==NULL) {
+      TypeInst* ti = new TypeInst(Location().introduce(),ite->type(),NULL);
+      nr = newVarDecl(env, Ctx(), ti, NULL, NULL, NULL);
+    } else if (nr->type().isint() && nr->ti()->domain()) {
+      // x has to be in the declared domain if it occurs
+      IntSetVal* dom = eval_intset(env,nr->ti()->domain());
+      IntBounds ib = compute_int_bounds(env,ee_val.r());
+      std::vector<Expression*> inDom;
+      if (ib.valid && dom->size()==1) {
+        if (ib.l < dom->min(0))
+          inDom.push_back(new BinOp(Location().introduce(),ee_val.r(),BOT_GQ,IntLit::a(dom->min(0))));
+        if (ib.u > dom->max(0))
+          inDom.push_back(new BinOp(Location().introduce(),ee_val.r(),BOT_LQ,IntLit::a(dom->max(0))));
+      } else {
+        SetLit* sl = new SetLit(Location().introduce(),dom);
+        sl->type(Type::parsetint());
+        inDom.push_back(new BinOp(Location().introduce(),ee_val.r(),BOT_IN,sl));
+      }
+      for (unsigned int i=0; i<inDom.size(); i++) {
+        inDom[i]->type(Type::varbool());
+        BinOp* impl = new BinOp(Location().introduce(),ee_occ.r(),BOT_IMPL,inDom[i]);
+        impl->type(Type::varbool());
+        (void) flat_exp(env, Ctx(), impl, constants().var_true, constants().var_true);
+      }
+    }
+
+    std::vector<Expression*> args(2);
+    args[0] = ee_occ.r();
+    args[1] = ee_val.r();
+    Call* revMap = new Call(Location().introduce(),ASTString("reverse_map"),args);
+    env.reverseMappers.insert(nr->id(),revMap);
+
+    // Keep c and x alive until the output model has been created
+    args.push_back(nr->id());
+    Call* keepAlive = new Call(Location().introduce(),constants().var_redef->id(),args);
+    keepAlive->type(Type::varbool());
+    keepAlive->decl(constants().var_redef);
+    (void) flat_exp(env, Ctx(), keepAlive, constants().var_true, constants().var_true);
+
+    // Share c and x with all calls to occurs and deopt on the result
+    std::vector<Expression*> nr_args(1);
+    nr_args[0] = nr->id();
+    ASTString fns[2] = { ASTString("occurs"), ASTString("deopt") };
+    for (unsigned int i=0; i<2; i++) {
+      Call* cc = new Call(Location().introduce(),fns[i],nr_args);
+      FunctionI* decl = env.orig->matchFn(env,cc);
+      if (decl==NULL)
+        continue;
+      cc->decl(decl);
+      cc->type(decl->rtype(env,nr_args));
+      env.map_insert(cc,EE(args[i],constants().lit_true));
+    }
+
+    ret.b = bind(env,Ctx(),b,constants().lit_true);
+    ret.r = nr->id();
+    return true;
+  }
+
   /// TODO: check if all expressions are total
   /// If yes, use element encoding
   /// If not, use implication encoding
   EE flat_ite(EnvI& env,Ctx ctx, ITE* ite, VarDecl* r, VarDecl* b) {
     
+    {
+      EE ret;
+      if (flat_ite_opt(env,ctx,ite,r,b,ret))
+        return ret;
+    }
+
     std::vector<Expression*> clauses;
     std::vector<Expression*> elseconds;
     
@@ -1913,6 +2466,7 @@ namespace MiniZinc {
             if (!LinearTraits<Lit>::domain_equals(domain,d)) {
               vd->ti()->setComputedDomain(false);
               vd->ti()->domain(LinearTraits<Lit>::new_domain(d));
+              env.domainChanged(vd);
             }
             ret.r = bind(env,ctx,r,constants().lit_true);
           } else {
@@ -1921,6 +2475,7 @@ namespace MiniZinc {
         } else {
           vd->ti()->setComputedDomain(false);
           vd->ti()->domain(LinearTraits<Lit>::new_domain(d));
+          env.domainChanged(vd);
           ret.r = bind(env,ctx,r,constants().lit_true);
         }
       } else {
@@ -1970,6 +2525,7 @@ namespace MiniZinc {
               ret.r = bind(env,ctx,r,constants().lit_true);
               vd->ti()->setComputedDomain(false);
               vd->ti()->domain(LinearTraits<Lit>::new_domain(ndomain));
+              env.domainChanged(vd);
 
               if (r==constants().var_true) {
                 BinOp* bo = new BinOp(Location().introduce(), e0, bot, e1);
@@ -2055,6 +2611,7 @@ namespace MiniZinc {
               if (!LinearTraits<Lit>::domain_equals(domain,new_domain)) {
                 vd->ti()->setComputedDomain(false);
                 vd->ti()->domain(LinearTraits<Lit>::new_domain(new_domain));
+                env.domainChanged(vd);
               }
             } else {
               ret.r = bind(env,ctx,r,constants().lit_false);
@@ -2118,6 +2675,9 @@ namespace MiniZinc {
     } else {
       EE flat_coeff = flat_exp(env,nctx,args_ee[0].r(),NULL,NULL);
       ArrayLit* coeff = follow_id(flat_coeff.r())->template cast<ArrayLit>();
+      if (coeff->v().size() != al->v().size())
+        throw EvalError(env, c->loc(),
+                        "lin_exp: coefficient and variable arrays have different sizes");
       for (unsigned int i=coeff->v().size(); i--;)
         c_coeff[i] = LinearTraits<Lit>::eval(env,coeff->v()[i]);
     }
@@ -2314,7 +2874,7 @@ namespace MiniZinc {
           es[i] = flat_cv_exp(env, ctx, al->v()[i])();
         }
         std::vector<std::pair<int,int> > dims(al->dims());
-        for (unsigned int i=0; i<al->dims(); i++) {
+        for (int i=0; i<al->dims(); i++) {
           dims[i] = std::make_pair(al->min(i), al->max(i));
         }
         Expression* al_ret =  eval_par(env, new ArrayLit(Location().introduce(),es,dims));
@@ -2419,9 +2979,8 @@ namespace MiniZinc {
       case Expression::E_LET:
       {
         Let* l = e->cast<Let>();
-        l->pushbindings();
+        Bindings bindings(l);
         KeepAlive ret = flat_cv_exp(env, ctx, l->in());
-        l->popbindings();
         return ret;
       }
         
@@ -2429,6 +2988,86 @@ namespace MiniZinc {
     
   }
   
+  /**
+   * \brief Compute the set of entries of par int array \a al that can be
+   * selected by the flattened indices \a idx
+   *
+   * Returns NULL if an index may be out of bounds, or if the indices can
+   * reach the whole array (in which case the bounds of the array are as
+   * good as it gets).
+   */
+  IntSetVal* reachable_elements(EnvI& env, ArrayLit* al,
+                                const std::vector<EE>& idx) {
+    std::vector<std::vector<IntVal> > vals(al->dims());
+    long long int count = 1;
+    for (int i=0; i<al->dims(); i++) {
+      Expression* ie = idx[i].r();
+      IntSetVal* isv;
+      Id* id = ie->dyn_cast<Id>();
+      if (id && id->decl()->ti()->domain()) {
+        isv = eval_intset(env,id->decl()->ti()->domain());
+      } else {
+        IntBounds ib = compute_int_bounds(env,ie);
+        if (!ib.valid)
+          return NULL;
+        isv = IntSetVal::a(ib.l,ib.u);
+      }
+      if (isv->size()==0 || isv->min() < al->min(i) || isv->max() > al->max(i))
+        return NULL;
+      count *= isv->card().toInt();
+      if (count >= static_cast<long long int>(al->size()))
+        return NULL;
+      IntSetRanges isr(isv);
+      for (Ranges::ToValues<IntSetRanges> isv_v(isr); isv_v(); ++isv_v)
+        vals[i].push_back(isv_v.val());
+    }
+    std::vector<IntVal> elems;
+    std::vector<unsigned int> pos(al->dims(),0);
+    for (;;) {
+      int offset = 0;
+      for (int i=0; i<al->dims(); i++) {
+        offset = offset*(al->max(i)-al->min(i)+1) +
+                 (vals[i][pos[i]].toInt()-al->min(i));
+      }
+      if (ASTParVecO* pv = al->packed()) {
+        elems.push_back(pv->i(offset));
+      } else {
+        IntLit* il = al->v()[offset]->dyn_cast<IntLit>();
+        if (il==NULL)
+          return NULL;
+        elems.push_back(il->v());
+      }
+      int i = al->dims()-1;
+      for (; i >= 0; i--) {
+        if (++pos[i] < vals[i].size())
+          break;
+        pos[i] = 0;
+      }
+      if (i < 0)
+        break;
+    }
+    return IntSetVal::a(elems);
+  }
+
+  /**
+   * \brief Return comprehension \a e if a root-context forall over it can be
+   * flattened element by element, otherwise NULL
+   *
+   * This is the case for array comprehensions of non-optional Booleans
+   * with par generators and a par where clause.
+   */
+  Comprehension* streamableForall(Expression* e) {
+    Comprehension* c = e->dyn_cast<Comprehension>();
+    if (c==NULL || c->set() || c->type().isopt() || c->e()->type().isopt())
+      return NULL;
+    if (c->where() && !c->where()->type().ispar())
+      return NULL;
+    for (int i=0; i<c->n_generators(); i++)
+      if (!c->in(i)->type().ispar())
+        return NULL;
+    return c;
+  }
+
   EE flat_exp(EnvI& env, Ctx ctx, Expression* e, VarDecl* r, VarDecl* b) {
     if (e==NULL) return EE();
     EE ret;
@@ -2908,7 +3547,7 @@ namespace MiniZinc {
               composed_e[i] = al->v()[inner_idx.toInt()-al->min(0)];
             }
             std::vector<std::pair<int,int> > dims(al_inner->dims());
-            for (unsigned int i=0; i<al_inner->dims(); i++) {
+            for (int i=0; i<al_inner->dims(); i++) {
               dims[i] = std::make_pair(al_inner->min(i), al_inner->max(i));
             }
             {
@@ -3003,6 +3642,28 @@ namespace MiniZinc {
           Ctx elemctx = ctx;
           elemctx.neg = false;
           EE ee = flat_exp(env,elemctx,ka(),NULL,NULL);
+          if (aa->type().isint() && aa->type().dim()==0 && !aa->type().isopt() &&
+              eev.r()->type().ispar() && ee.r()->isa<Id>()) {
+            // Restrict result to the array entries the indices can reach
+            GCLock lock;
+            ArrayLit* al = follow_id(eev.r())->cast<ArrayLit>();
+            if (IntSetVal* reach = reachable_elements(env,al,ees)) {
+              Id* id = ee.r()->cast<Id>();
+              while (id != NULL) {
+                if (id->decl()->ti()->domain()) {
+                  IntSetVal* domain = eval_intset(env,id->decl()->ti()->domain());
+                  IntSetVal* newdom = IntSetVal::intersect(domain,reach);
+                  if (newdom->card() != domain->card()) {
+                    if (newdom->size()==0)
+                      env.flat()->fail(env);
+                    else
+                      id->decl()->ti()->domain(new SetLit(Location().introduce(),newdom));
+                  }
+                }
+                id = id->decl()->e() ? id->decl()->e()->dyn_cast<Id>() : NULL;
+              }
+            }
+          }
           ees.push_back(ee);
           if (aa->type().isbool() && !aa->type().isopt()) {
             ee.b = ee.r;
@@ -3695,6 +4356,7 @@ namespace MiniZinc {
               VarDecl* vd = e0.r()->cast<Id>()->decl();
               if (vd->ti()->domain()==NULL) {
                 vd->ti()->domain(e1.r());
+                env.domainChanged(vd);
               } else {
                 GCLock lock;
                 IntSetVal* newdom = eval_intset(env,e1.r());
@@ -3703,10 +4365,7 @@ namespace MiniZinc {
                   bool changeDom = false;
                   if (id->decl()->ti()->domain()) {
                     IntSetVal* domain = eval_intset(env,id->decl()->ti()->domain());
-                    IntSetRanges dr(domain);
-                    IntSetRanges ibr(newdom);
-                    Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                    IntSetVal* newibv = IntSetVal::ai(i);
+                    IntSetVal* newibv = IntSetVal::intersect(domain,newdom);
                     if (domain->card() != newibv->card()) {
                       newdom = newibv;
                       changeDom = true;
@@ -3719,6 +4378,7 @@ namespace MiniZinc {
                   } else if (changeDom) {
                     id->decl()->ti()->setComputedDomain(false);
                     id->decl()->ti()->domain(new SetLit(Location().introduce(),newdom));
+                    env.domainChanged(id->decl());
                   }
                   id = id->decl()->e() ? id->decl()->e()->dyn_cast<Id>() : NULL;
                 }
@@ -4007,11 +4667,29 @@ namespace MiniZinc {
         if (ctx.b==C_ROOT && decl->e()==NULL &&
             cid == constants().ids.forall && r==constants().var_true) {
           ret.b = bind(env,ctx,b,constants().lit_true);
-          EE flat_al = flat_exp(env,Ctx(),c->args()[0],NULL,constants().var_true);
-          ArrayLit* al = follow_id(flat_al.r())->cast<ArrayLit>();
           nctx.b = C_ROOT;
-          for (unsigned int i=0; i<al->v().size(); i++)
-            (void) flat_exp(env,nctx,al->v()[i],r,b);
+          if (Comprehension* comp = streamableForall(c->args()[0])) {
+            KeepAlive comp_ka(comp);
+            class EvalRoot {
+            public:
+              Ctx ctx;
+              EvalRoot(Ctx ctx0) : ctx(ctx0) {}
+              EE e(EnvI& env, Expression* e) {
+                return flat_exp(env,ctx,e,constants().var_true,constants().var_true);
+              }
+            } _evalroot(nctx);
+            // The results have already been added to the flat model
+            class Discard {
+            public:
+              void push_back(const EE&) {}
+            } _discard;
+            eval_comp(env,_evalroot,comp,_discard);
+          } else {
+            EE flat_al = flat_exp(env,Ctx(),c->args()[0],NULL,constants().var_true);
+            ArrayLit* al = follow_id(flat_al.r())->cast<ArrayLit>();
+            for (unsigned int i=0; i<al->v().size(); i++)
+              (void) flat_exp(env,nctx,al->v()[i],r,b);
+          }
           ret.r = bind(env,ctx,r,constants().lit_true);
         } else {
           
@@ -4334,13 +5012,9 @@ namespace MiniZinc {
                   env.map_insert(cr_c,ret);
               }
             } else {
-              std::vector<KeepAlive> previousParameters(decl->params().size());
-              for (unsigned int i=decl->params().size(); i--;) {
-                VarDecl* vd = decl->params()[i];
-                previousParameters[i] = vd->e();
-                vd->flat(vd);
-                vd->e(args[i]());
-              }
+              Bindings parameters;
+              for (unsigned int i=decl->params().size(); i--;)
+                parameters.bind(decl->params()[i], args[i]());
               
               if (decl->e()->type().isbool() && !decl->e()->type().isopt()) {
                 ret.b = bind(env,Ctx(),b,constants().lit_true);
@@ -4369,13 +5043,6 @@ namespace MiniZinc {
               }
               if (!ctx.neg)
                 env.map_insert(cr(),ret);
-
-              // Restore previous mapping
-              for (unsigned int i=decl->params().size(); i--;) {
-                VarDecl* vd = decl->params()[i];
-                vd->e(previousParameters[i]());
-                vd->flat(vd->e() ? vd : NULL);
-              }
             }
           }
         }
@@ -4397,7 +5064,8 @@ namespace MiniZinc {
             nctx.b = C_MIX;
           if (v->e()) {
             (void) flat_exp(env,nctx,v->e(),vd,constants().var_true);
-            if (v->e()->type().bt()==Type::BT_INT && v->e()->type().dim()==0) {
+            if (v->e()->type().bt()==Type::BT_INT && v->e()->type().dim()==0 &&
+                !v->e()->type().isopt()) {
               IntSetVal* ibv = NULL;
               if (v->e()->type().is_set()) {
                 ibv = compute_intset_bounds(env,v->e());
@@ -4409,10 +5077,7 @@ namespace MiniZinc {
               if (ibv) {
                 if (vd->ti()->domain()) {
                   IntSetVal* domain = eval_intset(env,vd->ti()->domain());
-                  IntSetRanges dr(domain);
-                  IntSetRanges ibr(ibv);
-                  Ranges::Inter<IntSetRanges,IntSetRanges> i(dr,ibr);
-                  IntSetVal* newibv = IntSetVal::ai(i);
+                  IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
                   if (ibv->card() == newibv->card()) {
                     vd->ti()->setComputedDomain(true);
                   } else {
@@ -4455,10 +5120,8 @@ namespace MiniZinc {
     case Expression::E_LET:
       {
         Let* let = e->cast<Let>();
-        GC::mark();
         std::vector<EE> cs;
-        std::vector<KeepAlive> flatmap;
-        let->pushbindings();
+        Bindings bindings(let);
         for (unsigned int i=0; i<let->let().size(); i++) {
           Expression* le = let->let()[i];
           if (VarDecl* vd = le->dyn_cast<VarDecl>()) {
@@ -4508,7 +5171,6 @@ namespace MiniZinc {
               let_e = nvd->id();
             }
             vd->e(let_e);
-            flatmap.push_back(vd->flat());
             if (Id* id = let_e->dyn_cast<Id>()) {
               vd->flat(id->decl());
             } else {
@@ -4543,14 +5205,6 @@ namespace MiniZinc {
             ret.b = conj(env,b,Ctx(),cs);
           }
         }
-        let->popbindings();
-        // Restore previous mapping
-        for (unsigned int i=0; i<let->let().size(); i++) {
-          if (VarDecl* vd = let->let()[i]->dyn_cast<VarDecl>()) {
-            vd->flat(Expression::cast<VarDecl>(flatmap.back()()));
-            flatmap.pop_back();
-          }
-        }
       }
       break;
     case Expression::E_TI:
@@ -4671,6 +5325,10 @@ namespace MiniZinc {
       }
       /// Determine whether to enter node
       bool enter(Expression* e) {
+        // Immortal nodes are shared with other threads and must not be
+        // modified, and they only refer to other immortal nodes
+        if (e->immortal())
+          return false;
         Type t = e->type();
         t.ti(Type::TI_PAR);
         e->type(t);
@@ -4680,6 +5338,78 @@ namespace MiniZinc {
     topDown(_par, e);
   }
   
+  /**
+   * \brief Pre-evaluate accesses to par data arrays in output expression \a e
+   *
+   * Any access to a toplevel par array whose indices only depend on
+   * toplevel par declarations is evaluated, and the result is entered into
+   * the copy map. When the output item is copied, the access is replaced by
+   * the element, so that the output model only contains the whole array if
+   * it is also used in any other way.
+   */
+  void sliceOutputArrays(EnvI& env, Expression* e) {
+    class Closed : public EVisitor {
+    public:
+      bool closed;
+      Closed(void) : closed(true) {}
+      void vId(const Id& id) {
+        if (&id==constants().absent)
+          return;
+        if (id.decl()==NULL || !id.decl()->toplevel() || id.decl()->type().isvar())
+          closed = false;
+      }
+      /// Visit let
+      void vLet(const Let&) { closed = false; }
+      /// Determine whether to enter node
+      bool enter(Expression*) { return closed; }
+    };
+    class S : public EVisitor {
+    public:
+      EnvI& env;
+      S(EnvI& env0) : env(env0) {}
+      void vArrayAccess(ArrayAccess& aa) {
+        if (!aa.type().ispar() || aa.type().dim() != 0 || !aa.ann().isEmpty())
+          return;
+        Id* id = aa.v()->dyn_cast<Id>();
+        if (id==NULL || id->decl()==NULL || !id->decl()->toplevel() ||
+            !id->decl()->type().ispar() || id->decl()->e()==NULL)
+          return;
+        Closed c;
+        for (unsigned int i=aa.idx().size(); i--;) {
+          if (!aa.idx()[i]->type().ispar())
+            return;
+          topDown(c, aa.idx()[i]);
+        }
+        if (!c.closed)
+          return;
+        Expression* elem;
+        try {
+          elem = eval_par(env, &aa);
+        } catch (Exception&) {
+          // Keep the access, errors are reported when printing solutions
+          return;
+        }
+        switch (elem->eid()) {
+          case Expression::E_INTLIT:
+          case Expression::E_FLOATLIT:
+          case Expression::E_BOOLLIT:
+          case Expression::E_STRINGLIT:
+            break;
+          case Expression::E_SETLIT:
+            if (elem->cast<SetLit>()->isv()==NULL)
+              return;
+            break;
+          default:
+            return;
+        }
+        if (elem->type() != aa.type() || !elem->ann().isEmpty())
+          return;
+        env.cmap.insert(&aa, elem);
+      }
+    } _s(env);
+    topDown(_s, e);
+  }
+
   void outputVarDecls(EnvI& env, Item* ci, Expression* e) {
     class O : public EVisitor {
     public:
@@ -4956,6 +5686,7 @@ namespace MiniZinc {
         : env(env0), vo(vo0), outputItem(outputItem0) {}
         void vOutputI(OutputI* oi) {
           GCLock lock;
+          sliceOutputArrays(env, oi->e());
           outputItem = copy(env,env.cmap, oi)->cast<OutputI>();
           makePar(outputItem->e());
           env.output->addItem(outputItem);
@@ -4975,7 +5706,7 @@ namespace MiniZinc {
               s << vd->id()->str().str() << " = ";
               if (vd->type().dim() > 0) {
                 s << "array" << vd->type().dim() << "d(";
-                for (unsigned int i=0; i<vd->type().dim(); i++) {
+                for (int i=0; i<vd->type().dim(); i++) {
                   IntSetVal* idxset = eval_intset(e,vd->ti()->ranges()[i]->domain());
                   s << *idxset << ",";
                 }
@@ -5234,9 +5965,92 @@ namespace MiniZinc {
     }
     return true;
   }
-  
+
+  /**
+   * \brief Determine Boolean variables that only occur positively
+   *
+   * A variable that only occurs positively (in the positive literals of
+   * clauses, in disjunctions or conjunctions that are themselves only used
+   * positively) can be defined by a half-reified constraint, since setting
+   * it to false can never make the model unsatisfiable.
+   */
+  class PositiveOccurrences {
+  protected:
+    EnvI& env;
+    UNORDERED_NAMESPACE::unordered_map<VarDecl*,bool> known;
+    /// Check whether \a e is \a x or an array literal containing \a x
+    static bool mentions(Expression* e, VarDecl* x) {
+      if (Id* id = e->dyn_cast<Id>())
+        return id->decl()==x;
+      if (ArrayLit* al = e->dyn_cast<ArrayLit>()) {
+        for (unsigned int i=0; i<al->v().size(); i++) {
+          if (Id* id = al->v()[i]->dyn_cast<Id>())
+            if (id->decl()==x)
+              return true;
+        }
+      }
+      return false;
+    }
+    /// Check whether Boolean expression \a e is monotone in \a x
+    static bool monotone(Expression* e, VarDecl* x) {
+      if (Id* id = e->dyn_cast<Id>())
+        return id->decl()==x;
+      if (Call* c = e->dyn_cast<Call>()) {
+        if (c->id()==constants().ids.exists || c->id()==constants().ids.forall)
+          return c->args().size()==1;
+        if (c->id()==constants().ids.clause || c->id()==constants().ids.bool_clause)
+          return c->args().size()==2 && !mentions(c->args()[1],x);
+      }
+      return false;
+    }
+  public:
+    PositiveOccurrences(EnvI& env0) : env(env0) {}
+    /// Return whether \a x (a Boolean variable or array) only occurs positively
+    bool positive(VarDecl* x) {
+      UNORDERED_NAMESPACE::unordered_map<VarDecl*,bool>::iterator it = known.find(x);
+      if (it != known.end())
+        return it->second;
+      known[x] = false;
+      if (!x->introduced() || isOutput(x))
+        return false;
+      IdMap<VarOccurrences::Items>::iterator occ = env.vo._m.find(x->id());
+      if (occ==env.vo._m.end() || occ->second.empty())
+        return false;
+      for (VarOccurrences::Items::iterator item = occ->second.begin();
+           item != occ->second.end(); ++item) {
+        if ((*item)->removed())
+          continue;
+        if (ConstraintI* ci = (*item)->dyn_cast<ConstraintI>()) {
+          if (!monotone(ci->e(),x))
+            return false;
+        } else if (VarDeclI* vdi = (*item)->dyn_cast<VarDeclI>()) {
+          VarDecl* y = vdi->e();
+          if (y==x)
+            continue;
+          if (y->e()==NULL || !y->type().isvar() || y->type().bt()!=Type::BT_BOOL)
+            return false;
+          if (y->type().dim()==0) {
+            if (!monotone(y->e(),x))
+              return false;
+          } else if (!y->e()->isa<ArrayLit>()) {
+            return false;
+          }
+          if (!positive(y))
+            return false;
+        } else {
+          return false;
+        }
+      }
+      known[x] = true;
+      return true;
+    }
+  };
+
   void flatten(Env& e, FlatteningOptions opt) {
     EnvI& env = e.envi();
+    // Output items kept in the FlatZinc refer to variables without
+    // recording occurrences, so half reification is only safe without them
+    env.halfReifications = opt.halfReifications && !opt.keepOutputInFzn;
 
     bool onlyRangeDomains;
     {
@@ -5261,18 +6075,22 @@ namespace MiniZinc {
     iterItems<ExpandArrayDecls>(_ead,e.model());;
     
     bool hadSolveItem = false;
+    std::vector<VarDecl*> deletedVarDecls;
     // Flatten main model
     class FV : public ItemVisitor {
     public:
       EnvI& env;
       bool& hadSolveItem;
-      FV(EnvI& env0, bool& hadSolveItem0) : env(env0), hadSolveItem(hadSolveItem0) {}
+      std::vector<VarDecl*>& deletedVarDecls;
+      FV(EnvI& env0, bool& hadSolveItem0, std::vector<VarDecl*>& deletedVarDecls0)
+      : env(env0), hadSolveItem(hadSolveItem0), deletedVarDecls(deletedVarDecls0) {}
       bool enter(Item* i) {
         return !(i->isa<ConstraintI>()  && env.flat()->failed());
       }
       void vVarDeclI(VarDeclI* v) {
         if (v->e()->type().isvar() || v->e()->type().isann()) {
           (void) flat_exp(env,Ctx(),v->e()->id(),NULL,constants().var_true);
+          propagateDomains(env, deletedVarDecls);
         } else {
           if (v->e()->e()==NULL) {
             if (!v->e()->type().isann())
@@ -5309,6 +6127,7 @@ namespace MiniZinc {
       }
       void vConstraintI(ConstraintI* ci) {
         (void) flat_exp(env,Ctx(),ci->e(),constants().var_true,constants().var_true);
+        propagateDomains(env, deletedVarDecls);
       }
       void vSolveI(SolveI* si) {
         if (hadSolveItem)
@@ -5332,7 +6151,7 @@ namespace MiniZinc {
         }
         env.flat_addItem(nsi);
       }
-    } _fv(env,hadSolveItem);
+    } _fv(env,hadSolveItem,deletedVarDecls);
     iterItems<FV>(_fv,e.model());
     
     if (!hadSolveItem) {
@@ -5387,10 +6206,13 @@ namespace MiniZinc {
       array_bool_clause_reif = (fi && fi->e()) ? fi : NULL;
     }
     
-    std::vector<VarDecl*> deletedVarDecls;
     std::vector<VarDeclI*> removedItems;
     env.collectVarDecls(true);
 
+    // Removed items stay in the flat model until it is compacted, so the
+    // variables remembered here remain valid for the whole loop
+    PositiveOccurrences positiveOccurrences(env);
+
     while (startItem <= endItem || !env.modifiedVarDecls.empty()) {
       if (env.flat()->failed())
         return;
@@ -5438,6 +6260,10 @@ namespace MiniZinc {
 
           GCLock lock;
           IntSetVal* dom = eval_intset(env,vdi->e()->ti()->domain());
+          if (dom->size()==0) {
+            env.flat()->fail(env);
+            return;
+          }
 
           bool needRangeDomain = onlyRangeDomains;
           if (!needRangeDomain && dom->size() > 0) {
@@ -5532,6 +6358,7 @@ namespace MiniZinc {
             if (Call* c = vd->e()->dyn_cast<Call>()) {
               GCLock lock;
               Call* nc = NULL;
+              bool halfReified = false;
               if (c->id() == constants().ids.lin_exp) {
                 if (int_lin_eq) {
                   std::vector<Expression*> args(c->args().size());
@@ -5591,10 +6418,22 @@ namespace MiniZinc {
                     nc->type(Type::varbool());
                     nc->decl(array_bool_clause_reif);
                   } else {
+                    FunctionI* decl = NULL;
                     if (c->type().isbool() && vd->type().isbool()) {
-                      cid = env.reifyId(c->id());
+                      if (env.halfReifications && positiveOccurrences.positive(vd)) {
+                        ASTString imp_cid = env.halfReifyId(c->id());
+                        FunctionI* imp_decl = env.orig->matchFn(env,imp_cid,args);
+                        if (imp_decl && imp_decl->e()) {
+                          cid = imp_cid;
+                          decl = imp_decl;
+                          halfReified = true;
+                        }
+                      }
+                      if (!halfReified)
+                        cid = env.reifyId(c->id());
                     }
-                    FunctionI* decl = env.orig->matchFn(env,cid,args);
+                    if (decl==NULL)
+                      decl = env.orig->matchFn(env,cid,args);
                     if (decl && decl->e()) {
                       nc = new Call(c->loc().introduce(),cid,args);
                       nc->type(Type::varbool());
@@ -5613,7 +6452,10 @@ namespace MiniZinc {
                 CollectDecls cd(env.vo,deletedVarDecls,vdi);
                 topDown(cd,c);
                 vd->e(NULL);
-                if (nc != c) {
+                if (halfReified) {
+                  // vd no longer equals c, so c must not be reused through CSE
+                  env.map_remove(c);
+                } else if (nc != c) {
                   vd->addAnnotation(constants().ann.is_defined_var);
                   nc->addAnnotation(definesVarAnn(vd->id()));
                 }
@@ -5672,8 +6514,16 @@ namespace MiniZinc {
         }
       }
 
+      propagateDomains(env, deletedVarDecls);
+
       startItem = endItem+1;
       endItem = m.size()-1;
+      if (startItem > endItem && env.modifiedVarDecls.empty() && !env.flat()->failed()) {
+        // All redefinitions have been flattened, so the indicator constraints
+        // of the linear library can now be linearised using final bounds
+        if (linearize(env, deletedVarDecls))
+          endItem = m.size()-1;
+      }
     }
 
     for (unsigned int i=0; i<removedItems.size(); i++) {
@@ -5752,6 +6602,8 @@ namespace MiniZinc {
       }
     }
 
+    env.flat_compact();
+
     if (!opt.keepOutputInFzn) {
       createOutput(env);
     }
@@ -5769,10 +6621,31 @@ namespace MiniZinc {
           }
     }
 
-    m->compact();
     EnvI& env = e.envi();
+    env.flat_compact();
     
     int msize = m->size();
+
+    // Determine variables that can be defined by half reification before
+    // any definitions are turned into constraints
+    UNORDERED_NAMESPACE::unordered_set<VarDecl*> halfReified;
+    if (env.halfReifications) {
+      PositiveOccurrences po(env);
+      for (int i=0; i<msize; i++) {
+        if ((*m)[i]->removed())
+          continue;
+        if (VarDeclI* vdi = (*m)[i]->dyn_cast<VarDeclI>()) {
+          VarDecl* vd = vdi->e();
+          if (vd->type().isvar() && vd->type().isbool() && vd->type().dim()==0 &&
+              vd->e() && vd->e()->isa<Call>() &&
+              !Expression::equal(vd->ti()->domain(),constants().lit_true) &&
+              po.positive(vd)) {
+            halfReified.insert(vd);
+          }
+        }
+      }
+    }
+
     UNORDERED_NAMESPACE::unordered_set<Item*> globals;
     std::vector<int> declsWithIds;
     for (int i=0; i<msize; i++) {
@@ -5850,9 +6723,18 @@ namespace MiniZinc {
                 const Call* c = vd->e()->cast<Call>();
                 GCLock lock;
                 vd->e(NULL);
-                vd->addAnnotation(constants().ann.is_defined_var);
+                std::vector<Expression*> args(c->args().size());
+                std::copy(c->args().begin(),c->args().end(),args.begin());
+                args.push_back(vd->id());
                 ASTString cid;
-                if (c->id() == constants().ids.exists) {
+                bool isHalfReified = false;
+                if (halfReified.find(vd) != halfReified.end()) {
+                  cid = env.halfReifyId(c->id());
+                  isHalfReified = env.orig->matchFn(env,cid,args) != NULL;
+                }
+                if (isHalfReified) {
+                  // vd only implies c, it is not functionally defined
+                } else if (c->id() == constants().ids.exists) {
                   cid = constants().ids.array_bool_or;
                 } else if (c->id() == constants().ids.forall) {
                   cid = constants().ids.array_bool_and;
@@ -5861,12 +6743,12 @@ namespace MiniZinc {
                 } else {
                   cid = e.envi().reifyId(c->id());
                 }
-                std::vector<Expression*> args(c->args().size());
-                std::copy(c->args().begin(),c->args().end(),args.begin());
-                args.push_back(vd->id());
                 Call * nc = new Call(c->loc().introduce(),cid,args);
                 nc->type(c->type());
-                nc->addAnnotation(definesVarAnn(vd->id()));
+                if (!isHalfReified) {
+                  vd->addAnnotation(constants().ann.is_defined_var);
+                  nc->addAnnotation(definesVarAnn(vd->id()));
+                }
                 nc->ann().merge(c->ann());
                 e.envi().flat_addItem(new ConstraintI(Location().introduce(),nc));
               } else {
@@ -6088,21 +6970,7 @@ namespace MiniZinc {
       (*m)[declsWithIds[i]] = sortedVarDecls[i];
     }
     
-    m->compact();
-
-    for (IdMap<VarOccurrences::Items>::iterator it = env.vo._m.begin();
-         it != env.vo._m.end(); ++it) {
-      std::vector<Item*> toRemove;
-      for (VarOccurrences::Items::iterator iit = it->second.begin();
-           iit != it->second.end(); ++iit) {
-        if ((*iit)->removed()) {
-          toRemove.push_back(*iit);
-        }
-      }
-      for (unsigned int i=0; i<toRemove.size(); i++) {
-        it->second.erase(toRemove[i]);
-      }
-    }
+    env.flat_compact();
 
     class Cmp {
     public:
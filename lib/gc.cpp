@@ -13,16 +13,19 @@
 #include <minizinc/ast.hh>
 #include <minizinc/hash.hh>
 #include <minizinc/model.hh>
+#include <minizinc/bytecode.hh>
 #include <minizinc/config.hh>
 
 #include <vector>
+#include <deque>
 #include <cstring>
-
-//#define MINIZINC_GC_STATS
-
-#if defined(MINIZINC_GC_STATS)
-#include <map>
-#endif
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
 
 namespace MiniZinc {
   
@@ -73,26 +76,173 @@ namespace MiniZinc {
     HeapPage(HeapPage* n, size_t s) : next(n), size(s), used(0) {}
   };
 
+  /// Interned strings, indexed by their hash value
+  typedef UNORDERED_NAMESPACE::unordered_multimap<size_t,ASTStringO*> StringTable;
+
+  /// Return string in \a t equal to \a s of length \a n with hash \a h, or NULL
+  ASTStringO* findString(const StringTable& t, const char* s, size_t n, size_t h) {
+    std::pair<StringTable::const_iterator,StringTable::const_iterator> r =
+      t.equal_range(h);
+    for (StringTable::const_iterator it = r.first; it != r.second; ++it) {
+      ASTStringO* as = it->second;
+      if (as->size()==n && strncmp(as->c_str(), s, n)==0)
+        return as;
+    }
+    return NULL;
+  }
+
+  /// Process-wide memory for immortal nodes, never swept
+  class ImmortalHeap {
+  protected:
+    /// Protects allocation and string table updates from concurrent threads
+    std::mutex _mutex;
+    /// Current page
+    HeapPage* _page;
+    /// Default size of pages to allocate
+    static const size_t pageSize = 1<<16;
+    /**
+     * \brief Interned immortal strings
+     *
+     * A published table is never modified, so it can be read without
+     * locking. Adding strings publishes a new table.
+     */
+    std::atomic<const StringTable*> _strings;
+    /// Tables replaced by newer ones, which readers may still be using
+    std::vector<const StringTable*> _oldStrings;
+    ImmortalHeap(void) : _page(NULL), _strings(new StringTable()) {}
+  public:
+    /// Return the immortal heap
+    static ImmortalHeap& heap(void) {
+      static ImmortalHeap h;
+      return h;
+    }
+    /// Allocate \a size bytes
+    void* alloc(size_t size) {
+      size += ((8 - (size & 7)) & 7);
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_page==NULL || _page->used+size > _page->size) {
+        size_t s = std::max(size,pageSize);
+        HeapPage* newPage =
+          static_cast<HeapPage*>(::malloc(sizeof(HeapPage)+s-1));
+        if (newPage==NULL)
+          throw std::bad_alloc();
+        new (newPage) HeapPage(_page,s);
+        _page = newPage;
+      }
+      char* ret = _page->data+_page->used;
+      _page->used += size;
+      return ret;
+    }
+    /// Return interned string equal to \a s of length \a n with hash \a h, or NULL
+    ASTStringO* findString(const char* s, size_t n, size_t h) {
+      return MiniZinc::findString(*_strings.load(std::memory_order_acquire), s, n, h);
+    }
+    /// Publish a table containing the interned strings and all strings in \a t
+    void internStrings(const StringTable& t) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const StringTable* cur = _strings.load(std::memory_order_relaxed);
+      StringTable* next = new StringTable(*cur);
+      next->insert(t.begin(), t.end());
+      _oldStrings.push_back(cur);
+      _strings.store(next, std::memory_order_release);
+    }
+  };
+
+  /**
+   * \brief Helper threads of a collector
+   *
+   * The threads are started the first time a collection needs them and
+   * then wait for the next parallel phase, so that collections do not pay
+   * for creating and joining threads.
+   */
+  class WorkerPool {
+  protected:
+    std::mutex _mutex;
+    /// Signalled when a phase starts or the pool is stopped
+    std::condition_variable _start;
+    /// Signalled when the last helper finishes a phase
+    std::condition_variable _finish;
+    std::vector<std::thread> _workers;
+    /// Job of the current phase
+    const std::function<void(unsigned int)>* _job;
+    /// Number of threads taking part in the current phase
+    unsigned int _n;
+    /// Number of the current phase
+    unsigned long int _phase;
+    /// Number of helpers that have not finished the current phase
+    unsigned int _busy;
+    /// Whether the helpers should exit
+    bool _stop;
+    /// Main loop of helper \a me
+    void work(unsigned int me) {
+      unsigned long int phase = 0;
+      std::unique_lock<std::mutex> lock(_mutex);
+      for (;;) {
+        while (!_stop && _phase==phase)
+          _start.wait(lock);
+        if (_stop)
+          return;
+        phase = _phase;
+        if (me < _n) {
+          const std::function<void(unsigned int)>& job = *_job;
+          lock.unlock();
+          job(me);
+          lock.lock();
+          if (--_busy == 0)
+            _finish.notify_one();
+        }
+      }
+    }
+  public:
+    WorkerPool(void) : _job(NULL), _n(1), _phase(0), _busy(0), _stop(false) {}
+    ~WorkerPool(void) { stop(); }
+    /// Run \a job(i) for all i<\a n at the same time, job(0) on this thread
+    void run(unsigned int n, const std::function<void(unsigned int)>& job) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (_workers.size()+1 < n) {
+          unsigned int me = static_cast<unsigned int>(_workers.size())+1;
+          _workers.push_back(std::thread(&WorkerPool::work, this, me));
+        }
+        _job = &job;
+        _n = n;
+        _busy = n-1;
+        _phase++;
+      }
+      _start.notify_all();
+      job(0);
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (_busy > 0)
+        _finish.wait(lock);
+    }
+    /// Stop and join all helpers
+    void stop(void) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _start.notify_all();
+      for (unsigned int i=0; i<_workers.size(); i++)
+        _workers[i].join();
+      _workers.clear();
+      _stop = false;
+    }
+  };
+
+  class MarkState;
+
   /// Memory managed by the garbage collector
   class GC::Heap {
     friend class GC;
-#if defined(MINIZINC_GC_STATS)
+    /// Names of the node kinds
     static const char* _nodeid[Item::II_END+1];
-    struct GCStat {
-      int first;
-      int second;
-      int keepalive;
-      int inmodel;
-      size_t total;
-      GCStat(void) : first(0), second(0), keepalive(0), inmodel(0), total(0) {}
-    };
-    std::map<int,GCStat> gc_stats;
-#endif
   protected:
     HeapPage* _page;
     Model* _rootset;
     KeepAlive* _roots;
     WeakRef* _weakRefs;
+    /// Innermost live scope of bindings
+    Bindings* _bindings;
     static const int _max_fl = 5;
     FreeListNode* _fl[_max_fl+1];
     static const size_t _fl_size[_max_fl+1];
@@ -116,29 +266,82 @@ namespace MiniZinc {
     size_t _gc_threshold;
     /// High water mark of all allocated memory
     size_t _max_alloced_mem;
+    /// Number of threads used for marking and sweeping
+    unsigned int _threads;
+    /// Helper threads for marking and sweeping
+    WorkerPool _pool;
 
-    /// A trail item
-    struct TItem {
-      Expression** l;
-      Expression* v;
-      bool mark;
-      TItem(Expression** l0, Expression* v0)
-        : l(l0), v(v0), mark(false) {}
+    /// Whether statistics are recorded
+    bool _stats;
+    /// Statistics for a single collection
+    struct GCRun {
+      /// Heap size before the collection
+      size_t before;
+      /// Heap size after the collection
+      size_t after;
+      /// Bytes in live nodes after the collection
+      size_t live;
+      /// Number of root expressions
+      size_t roots;
+      /// Time spent in the mark phase (in milliseconds)
+      double markTime;
+      /// Time spent in the sweep phase (in milliseconds)
+      double sweepTime;
     };
-    /// Trail
-    std::vector<TItem> trail;
+    /// Statistics for all collections so far
+    std::vector<GCRun> _runs;
+    /// Node statistics gathered during a sweep
+    struct SweepStats {
+      /// Bytes reclaimed per node kind
+      size_t freedBytes[Item::II_END+1];
+      /// Number of nodes reclaimed per node kind
+      size_t freedNodes[Item::II_END+1];
+      /// Bytes in live nodes
+      size_t live;
+      SweepStats(void) : live(0) {
+        for (int i=Item::II_END+1; i--;)
+          freedBytes[i] = freedNodes[i] = 0;
+      }
+      void add(const SweepStats& s) {
+        for (int i=Item::II_END+1; i--;) {
+          freedBytes[i] += s.freedBytes[i];
+          freedNodes[i] += s.freedNodes[i];
+        }
+        live += s.live;
+      }
+    };
+    /// Node statistics accumulated over all sweeps
+    SweepStats _swept;
+    /// Allocations served from each free list
+    size_t _fl_hits[_max_fl+1];
+    /// Allocations of free list sizes that found their free list empty
+    size_t _fl_misses[_max_fl+1];
+    /// Allocations too small or too large for the free lists
+    size_t _exact_allocs;
+
+    /// Interned strings, indexed by their hash value
+    typedef MiniZinc::StringTable StringTable;
+    StringTable _strings;
+    /// Strings interned in the current immortal scope, not yet published
+    StringTable _immortal_strings;
 
     Heap(void)
       : _page(NULL)
       , _rootset(NULL)
       , _roots(NULL)
       , _weakRefs(NULL)
+      , _bindings(NULL)
       , _alloced_mem(0)
       , _free_mem(0)
       , _gc_threshold(10)
-      , _max_alloced_mem(0) {
-      for (int i=_max_fl+1; i--;)
+      , _max_alloced_mem(0)
+      , _threads(1)
+      , _stats(false)
+      , _exact_allocs(0) {
+      for (int i=_max_fl+1; i--;) {
         _fl[i] = NULL;
+        _fl_hits[i] = _fl_misses[i] = 0;
+      }
     }
 
     /// Default size of pages to allocate
@@ -211,32 +414,82 @@ namespace MiniZinc {
         FreeListNode* p = _fl[slot];
         _fl[slot] = p->next;
         _free_mem -= size;
+        _fl_hits[slot]++;
         return p;
       }
+      _fl_misses[slot]++;
       return alloc(size);
     }
 
     void rungc(void) {
       if (_alloced_mem > _gc_threshold) {
-#ifdef MINIZINC_GC_STATS
-        std::cerr << "GC\n\talloced " << (_alloced_mem/1024) << "\n\tfree " << (_free_mem/1024) << "\n\tdiff "
-                  << ((_alloced_mem-_free_mem)/1024)
-                  << "\n\tthreshold " << (_gc_threshold/1024)
-                  << "\n";
-#endif
-        mark();
-        sweep();
+        if (_stats) {
+          typedef std::chrono::steady_clock clock;
+          GCRun run;
+          run.before = _alloced_mem;
+          clock::time_point t0 = clock::now();
+          run.roots = mark();
+          clock::time_point t1 = clock::now();
+          run.live = sweep();
+          clock::time_point t2 = clock::now();
+          run.after = _alloced_mem;
+          run.markTime = std::chrono::duration<double,std::milli>(t1-t0).count();
+          run.sweepTime = std::chrono::duration<double,std::milli>(t2-t1).count();
+          _runs.push_back(run);
+        } else {
+          mark();
+          sweep();
+        }
         _gc_threshold = static_cast<size_t>(_alloced_mem * 1.5);
-#ifdef MINIZINC_GC_STATS
-        std::cerr << "done\n\talloced " << (_alloced_mem/1024) << "\n\tfree " << (_free_mem/1024) << "\n\tdiff "
-                  << ((_alloced_mem-_free_mem)/1024)
-                  << "\n\tthreshold " << (_gc_threshold/1024)
-                  << "\n";
-#endif
+        // Flattened versions of declarations may have been collected
+        VarDecl::touchAll();
       }
     }
-    void mark(void);
-    void sweep(void);
+    /// Mark all reachable nodes, return number of root expressions
+    size_t mark(void);
+    /// Reclaim unmarked nodes, return bytes in live nodes (if recording statistics)
+    size_t sweep(void);
+
+    /// Add \a e to \a roots unless it is NULL or already marked
+    static void root(std::vector<const Expression*>& roots, const Expression* e) {
+      if (e != NULL && e->_gc_mark==0)
+        roots.push_back(e);
+    }
+    /// Mark everything reachable from \a roots using a single thread
+    static void seqMark(std::vector<const Expression*>& roots);
+    /// Mark everything reachable from \a roots using _threads threads
+    void parMark(std::vector<const Expression*>& roots);
+    /// Mark expressions from the shared deques (run by each marking thread)
+    static void markWorker(MarkState& s, unsigned int me);
+
+    /// Release the resources of the unreachable node \a n
+    static void destroy(ASTNode* n) {
+      switch (n->_id) {
+        case Item::II_FUN:
+          static_cast<FunctionI*>(n)->ann().~Annotation();
+          bytecode_delete(static_cast<FunctionI*>(n)->_bytecode);
+          break;
+        case Item::II_SOL:
+          static_cast<SolveI*>(n)->ann().~Annotation();
+          break;
+        case Expression::E_COMP:
+          static_cast<Comprehension*>(n)->ann().~Annotation();
+          bytecode_delete(static_cast<Comprehension*>(n)->_bytecode);
+          break;
+        case Expression::E_VARDECL:
+          // Reset WeakRef inside VarDecl
+          static_cast<VarDecl*>(n)->flat(NULL);
+          // fall through
+        default:
+          if (n->_id >= ASTNode::NID_END+1 && n->_id <= Expression::EID_END) {
+            static_cast<Expression*>(n)->ann().~Annotation();
+          }
+      }
+    }
+    /// Sweep all pages using _threads threads, return bytes in live nodes
+    size_t parSweep(void);
+    /// Print statistics in JSON format to \a os
+    void printStats(std::ostream& os);
 
     static size_t
     nodesize(ASTNode* n) {
@@ -293,39 +546,37 @@ namespace MiniZinc {
 
   };
 
-#ifdef MINIZINC_GC_STATS
   const char*
   GC::Heap::_nodeid[] = {
-    "FreeList      ", // NID_FL
-    "Chunk         ", // NID_CHUNK
-    "Vec           ", // NID_VEC
-    "IntLit        ",        // E_INTLIT
-    "FloatLit      ",      // E_FLOATLIT
-    "SetLit        ",        // E_SETLIT
-    "BoolLit       ",       // E_BOOLLIT
-    "StringLit     ",     // E_STRINGLIT
-    "Id            ",            // E_ID
-    "AnonVar       ",       // E_ANON
-    "ArrayLit      ",      // E_ARRAYLIT
-    "ArrayAccess   ",   // E_ARRAYACCESS
-    "Comprehension ", // E_COMP
-    "ITE           ",           // E_ITE
-    "BinOp         ",         // E_BINOP
-    "UnOp          ",          // E_UNOP
-    "Call          ",          // E_CALL
-    "VarDecl       ",       // E_VARDECL
-    "Let           ",           // E_LET
-    "TypeInst      ",      // E_TI
-    "TIId          ",          // E_TIID
-    "IncludeI      ",      // II_INC
-    "VarDeclI      ",      // II_VD
-    "AssignI       ",       // II_ASN
-    "ConstraintI   ",   // II_CON
-    "SolveI        ",        // II_SOL
-    "OutputI       ",       // II_OUT
-    "FunctionI     "      // II_FUN
+    "FreeList",     // NID_FL
+    "Chunk",        // NID_CHUNK
+    "Vec",          // NID_VEC
+    "IntLit",       // E_INTLIT
+    "FloatLit",     // E_FLOATLIT
+    "SetLit",       // E_SETLIT
+    "BoolLit",      // E_BOOLLIT
+    "StringLit",    // E_STRINGLIT
+    "Id",           // E_ID
+    "AnonVar",      // E_ANON
+    "ArrayLit",     // E_ARRAYLIT
+    "ArrayAccess",  // E_ARRAYACCESS
+    "Comprehension",// E_COMP
+    "ITE",          // E_ITE
+    "BinOp",        // E_BINOP
+    "UnOp",         // E_UNOP
+    "Call",         // E_CALL
+    "VarDecl",      // E_VARDECL
+    "Let",          // E_LET
+    "TypeInst",     // E_TI
+    "TIId",         // E_TIID
+    "IncludeI",     // II_INC
+    "VarDeclI",     // II_VD
+    "AssignI",      // II_ASN
+    "ConstraintI",  // II_CON
+    "SolveI",       // II_SOL
+    "OutputI",      // II_OUT
+    "FunctionI"     // II_FUN
   };
-#endif
   
   void
   GC::lock(void) {
@@ -343,6 +594,7 @@ namespace MiniZinc {
   }
 
   const size_t GC::Heap::pageSize;
+  const size_t ImmortalHeap::pageSize;
 
   const size_t
   GC::Heap::_fl_size[GC::Heap::_max_fl+1] = {
@@ -354,7 +606,58 @@ namespace MiniZinc {
     sizeof(Item)+6*sizeof(void*),
   };
 
-  GC::GC(void) : _heap(new Heap()), _lock_count(0) {}
+  GC::GC(void) : _heap(new Heap()), _lock_count(0), _immortal_count(0) {}
+
+  void
+  GC::beginImmortal(void) {
+    assert(locked());
+    gc()->_immortal_count++;
+  }
+  void
+  GC::endImmortal(void) {
+    GC* gc = GC::gc();
+    assert(gc->_immortal_count > 0);
+    if (--gc->_immortal_count == 0) {
+      for (unsigned int i=0; i<gc->_immortal_nodes.size(); i++) {
+        gc->_immortal_nodes[i]->_gc_mark = 1;
+        gc->_immortal_nodes[i]->_immortal = 1;
+      }
+      std::vector<ASTNode*>().swap(gc->_immortal_nodes);
+      // Other threads can find the strings once their nodes are sealed
+      if (!gc->_heap->_immortal_strings.empty()) {
+        ImmortalHeap::heap().internStrings(gc->_heap->_immortal_strings);
+        gc->_heap->_immortal_strings.clear();
+      }
+    }
+  }
+
+  ASTStringO*
+  GC::findString(const char* s, size_t n, size_t h) {
+    GC* gc = GC::gc();
+    // Immortal strings (such as the identifiers in constants()) are shared
+    // by all threads, so they take precedence over thread-local ones
+    if (ASTStringO* as = ImmortalHeap::heap().findString(s, n, h))
+      return as;
+    // Immortal strings must not refer to thread-local ones
+    if (gc->_immortal_count > 0)
+      return MiniZinc::findString(gc->_heap->_immortal_strings, s, n, h);
+    return MiniZinc::findString(gc->_heap->_strings, s, n, h);
+  }
+  void
+  GC::internString(ASTStringO* s) {
+    GC* gc = GC::gc();
+    if (gc->_immortal_count > 0)
+      gc->_heap->_immortal_strings.insert(std::make_pair(s->hash(), s));
+    else
+      gc->_heap->_strings.insert(std::make_pair(s->hash(), s));
+  }
+
+  GCImmortal::GCImmortal(void) {
+    GC::beginImmortal();
+  }
+  GCImmortal::~GCImmortal(void) {
+    GC::endImmortal();
+  }
 
   void
   GC::add(Model* m) {
@@ -386,7 +689,12 @@ namespace MiniZinc {
   GC::alloc(size_t size) {
     assert(locked());
     void* ret;
-    if (size < _heap->_fl_size[0] || size > _heap->_fl_size[_heap->_max_fl]) {
+    if (_immortal_count > 0) {
+      ret = ImmortalHeap::heap().alloc(size);
+      _immortal_nodes.push_back(new (ret) FreeListNode(size));
+      return ret;
+    } else if (size < _heap->_fl_size[0] || size > _heap->_fl_size[_heap->_max_fl]) {
+      _heap->_exact_allocs++;
       ret = _heap->alloc(size,true);
     } else {
       ret = _heap->fl(size);
@@ -395,93 +703,92 @@ namespace MiniZinc {
     return ret;
   }
 
-  void
+  size_t
   GC::Heap::mark(void) {
-#if defined(MINIZINC_GC_STATS)
-    std::cerr << "================= mark =================: ";
-    gc_stats.clear();
-#endif
+    std::vector<const Expression*> roots;
 
     for (KeepAlive* e = _roots; e != NULL; e = e->next()) {
       if ((*e)() && (*e)()->_gc_mark==0) {
-        Expression::mark((*e)());
-#if defined(MINIZINC_GC_STATS)
-        gc_stats[(*e)()->_id].keepalive++;
-#endif
+        roots.push_back((*e)());
       }
     }
-#if defined(MINIZINC_GC_STATS)
-    std::cerr << "+";
-#endif
     
     Model* m = _rootset;
-    if (m==NULL)
-      return;
-    do {
-      m->_filepath.mark();
-      m->_filename.mark();
-      for (unsigned int j=0; j<m->_items.size(); j++) {
-        Item* i = m->_items[j];
-        if (i->_gc_mark==0) {
-          i->_gc_mark = 1;
-          i->loc().mark();
-          switch (i->iid()) {
-          case Item::II_INC:
-            i->cast<IncludeI>()->f().mark();
-            break;
-          case Item::II_VD:
-            Expression::mark(i->cast<VarDeclI>()->e());
-#if defined(MINIZINC_GC_STATS)
-            gc_stats[i->cast<VarDeclI>()->e()->Expression::eid()].inmodel++;
-#endif
-            break;
-          case Item::II_ASN:
-            i->cast<AssignI>()->id().mark();
-            Expression::mark(i->cast<AssignI>()->e());
-            Expression::mark(i->cast<AssignI>()->decl());
-            break;
-          case Item::II_CON:
-            Expression::mark(i->cast<ConstraintI>()->e());
-#if defined(MINIZINC_GC_STATS)
-            gc_stats[i->cast<ConstraintI>()->e()->Expression::eid()].inmodel++;
-#endif
-            break;
-          case Item::II_SOL:
-            {
-              SolveI* si = i->cast<SolveI>();
-              for (ExpressionSetIter it = si->ann().begin(); it != si->ann().end(); ++it) {
-                Expression::mark(*it);
-              }
-            }
-            Expression::mark(i->cast<SolveI>()->e());
-            break;
-          case Item::II_OUT:
-            Expression::mark(i->cast<OutputI>()->e());
-            break;
-          case Item::II_FUN:
-            {
-              FunctionI* fi = i->cast<FunctionI>();
-              fi->id().mark();
-              Expression::mark(fi->ti());
-              for (ExpressionSetIter it = fi->ann().begin(); it != fi->ann().end(); ++it) {
-                Expression::mark(*it);
+    if (m != NULL) {
+      do {
+        m->_filepath.mark();
+        m->_filename.mark();
+        for (unsigned int j=0; j<m->_items.size(); j++) {
+          Item* i = m->_items[j];
+          if (i->_gc_mark==0) {
+            i->_gc_mark = 1;
+            i->loc().mark();
+            switch (i->iid()) {
+            case Item::II_INC:
+              i->cast<IncludeI>()->f().mark();
+              break;
+            case Item::II_VD:
+              root(roots, i->cast<VarDeclI>()->e());
+              break;
+            case Item::II_ASN:
+              i->cast<AssignI>()->id().mark();
+              root(roots, i->cast<AssignI>()->e());
+              root(roots, i->cast<AssignI>()->decl());
+              break;
+            case Item::II_CON:
+              root(roots, i->cast<ConstraintI>()->e());
+              break;
+            case Item::II_SOL:
+              {
+                SolveI* si = i->cast<SolveI>();
+                for (ExpressionSetIter it = si->ann().begin(); it != si->ann().end(); ++it) {
+                  root(roots, *it);
+                }
               }
-              Expression::mark(fi->e());
-              fi->params().mark();
-              for (unsigned int k=0; k<fi->params().size(); k++) {
-                Expression::mark(fi->params()[k]);
+              root(roots, i->cast<SolveI>()->e());
+              break;
+            case Item::II_OUT:
+              root(roots, i->cast<OutputI>()->e());
+              break;
+            case Item::II_FUN:
+              {
+                FunctionI* fi = i->cast<FunctionI>();
+                fi->id().mark();
+                root(roots, fi->ti());
+                for (ExpressionSetIter it = fi->ann().begin(); it != fi->ann().end(); ++it) {
+                  root(roots, *it);
+                }
+                root(roots, fi->e());
+                fi->params().mark();
+                for (unsigned int k=0; k<fi->params().size(); k++) {
+                  root(roots, fi->params()[k]);
+                }
               }
+              break;      
             }
-            break;      
           }
         }
+        m = m->_roots_next;
+      } while (m != _rootset);
+    }
+
+    for (Bindings* b = _bindings; b != NULL; b = b->next()) {
+      for (unsigned int i=b->size(); i--;) {
+        // The declaration is restored by the destructor of b, so it
+        // must stay alive even if nothing else refers to it any more
+        root(roots, (*b)[i].vd);
+        root(roots, (*b)[i].e);
+        root(roots, (*b)[i].ti);
+        root(roots, (*b)[i].flat);
       }
-      m = m->_roots_next;
-    } while (m != _rootset);
-    
-    for (unsigned int i=trail.size(); i--;) {
-      Expression::mark(trail[i].v);
     }
+    size_t nRoots = roots.size();
+
+    // Only use several threads once the heap spans more than one page
+    if (_threads > 1 && _page != NULL && _page->next != NULL)
+      parMark(roots);
+    else
+      seqMark(roots);
     
     for (WeakRef* wr = _weakRefs; wr != NULL; wr = wr->next()) {
       if ((*wr)() && (*wr)()->_gc_mark==0) {
@@ -490,17 +797,122 @@ namespace MiniZinc {
       }
     }
 
-#if defined(MINIZINC_GC_STATS)
-    std::cerr << "+";
-    std::cerr << "\n";
-#endif
+    for (StringTable::iterator it = _strings.begin(); it != _strings.end();) {
+      if (static_cast<ASTNode*>(it->second)->_gc_mark==0)
+        it = _strings.erase(it);
+      else
+        ++it;
+    }
+    return nRoots;
   }
-    
+
   void
+  GC::Heap::seqMark(std::vector<const Expression*>& stack) {
+    while (!stack.empty()) {
+      const Expression* cur = stack.back(); stack.pop_back();
+      if (cur->_gc_mark==0) {
+        cur->_gc_mark = 1;
+        Expression::markChildren(cur, stack);
+      }
+    }
+  }
+
+  /**
+   * \brief State shared by the threads of a parallel mark phase
+   *
+   * Each thread traverses from a private stack of grey expressions and
+   * publishes part of it to its own deque whenever other threads are idle.
+   * Idle threads steal from the front of any deque.
+   */
+  class MarkState {
+  public:
+    /// Grey expressions that can be stolen by other threads
+    class Deque {
+    public:
+      std::mutex mutex;
+      std::deque<const Expression*> d;
+    };
+    /// Number of threads
+    unsigned int n;
+    /// One deque per thread
+    Deque* deques;
+    /// Number of threads that are currently not looking for work
+    std::atomic<unsigned int> active;
+    /// Number of threads that are currently looking for work
+    std::atomic<unsigned int> idle;
+    /// Minimum size of a private stack before work is shared
+    static const size_t shareThreshold = 64;
+    MarkState(unsigned int n0) : n(n0), deques(new Deque[n0]), active(0), idle(0) {}
+    ~MarkState(void) { delete[] deques; }
+    /// Move older half of \a stack into the deque of thread \a me
+    void share(unsigned int me, std::vector<const Expression*>& stack) {
+      size_t half = stack.size()/2;
+      std::lock_guard<std::mutex> lock(deques[me].mutex);
+      deques[me].d.insert(deques[me].d.end(), stack.begin(), stack.begin()+half);
+      stack.erase(stack.begin(), stack.begin()+half);
+    }
+    /// Find work for thread \a me, return false if marking is finished
+    bool take(unsigned int me, std::vector<const Expression*>& stack) {
+      active--;
+      idle++;
+      for (;;) {
+        bool done = (active.load()==0);
+        for (unsigned int k=0; k<n; k++) {
+          Deque& victim = deques[(me+k) % n];
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          if (!victim.d.empty()) {
+            active++;
+            idle--;
+            size_t take = std::max<size_t>(1, victim.d.size()/2);
+            stack.insert(stack.end(), victim.d.begin(), victim.d.begin()+take);
+            victim.d.erase(victim.d.begin(), victim.d.begin()+take);
+            return true;
+          }
+        }
+        if (done) {
+          // No thread can publish new work, and all deques are empty
+          return false;
+        }
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  const size_t MarkState::shareThreshold;
+
+  void
+  GC::Heap::markWorker(MarkState& s, unsigned int me) {
+    std::vector<const Expression*> stack;
+    while (s.take(me, stack)) {
+      while (!stack.empty()) {
+        const Expression* cur = stack.back(); stack.pop_back();
+        // Non-expression components (strings, vectors, sets) are marked
+        // with setMark, which may let two threads mark the same node, but
+        // only one thread claims each expression and visits its children
+        if (cur->claimMark())
+          Expression::markChildren(cur, stack);
+        if (stack.size() > MarkState::shareThreshold && s.idle.load() > 0)
+          s.share(me, stack);
+      }
+    }
+  }
+
+  void
+  GC::Heap::parMark(std::vector<const Expression*>& roots) {
+    MarkState s(_threads);
+    // All threads start out looking for work
+    s.active = _threads;
+    for (unsigned int i=0; i<roots.size(); i++)
+      s.deques[i % _threads].d.push_back(roots[i]);
+    _pool.run(_threads, [&s](unsigned int me) { markWorker(s, me); });
+    roots.clear();
+  }
+    
+  size_t
   GC::Heap::sweep(void) {
-#if defined(MINIZINC_GC_STATS)
-    std::cerr << "=============== GC sweep =============\n";
-#endif
+    if (_threads > 1 && _page != NULL && _page->next != NULL)
+      return parSweep();
+    SweepStats stats;
     HeapPage* p = _page;
     HeapPage* prev = NULL;
     while (p) {
@@ -510,28 +922,12 @@ namespace MiniZinc {
         ASTNode* n = reinterpret_cast<ASTNode*>(p->data+off);
         size_t ns = nodesize(n);
         assert(ns != 0);
-#if defined(MINIZINC_GC_STATS)
-        GCStat& stats = gc_stats[n->_id];
-        stats.first++;
-        stats.total += ns;
-#endif
         if (n->_gc_mark==0) {
-          switch (n->_id) {
-            case Item::II_FUN:
-              static_cast<FunctionI*>(n)->ann().~Annotation();
-              break;
-            case Item::II_SOL:
-              static_cast<SolveI*>(n)->ann().~Annotation();
-              break;
-            case Expression::E_VARDECL:
-              // Reset WeakRef inside VarDecl
-              static_cast<VarDecl*>(n)->flat(NULL);
-              // fall through
-            default:
-              if (n->_id >= ASTNode::NID_END+1 && n->_id <= Expression::EID_END) {
-                static_cast<Expression*>(n)->ann().~Annotation();
-              }
+          if (_stats) {
+            stats.freedBytes[n->_id] += ns;
+            stats.freedNodes[n->_id]++;
           }
+          destroy(n);
           if (ns >= _fl_size[0] && ns <= _fl_size[_max_fl]) {
             FreeListNode* fln = static_cast<FreeListNode*>(n);
             new (fln) FreeListNode(ns, _fl[_fl_slot(ns)]);
@@ -544,11 +940,10 @@ namespace MiniZinc {
             wholepage = true;
           }
         } else {
-#if defined(MINIZINC_GC_STATS)
-          stats.second++;
-#endif
-          if (n->_id != ASTNode::NID_FL)
+          if (n->_id != ASTNode::NID_FL) {
             n->_gc_mark=0;
+            stats.live += ns;
+          }
         }
         off += ns;
       }
@@ -572,22 +967,200 @@ namespace MiniZinc {
         p = p->next;
       }
     }
-#if defined(MINIZINC_GC_STATS)
-    for (auto stat: gc_stats) {
-      std::cerr << _nodeid[stat.first] << ":\t" << stat.second.first << " / " << stat.second.second
-      << " / " << stat.second.keepalive << " / " << stat.second.inmodel << " / ";
-      if (stat.second.total > 1024) {
-        if (stat.second.total > 1024*1024) {
-          std::cerr << (stat.second.total / 1024 / 1024) << "M";
+    _swept.add(stats);
+    return stats.live;
+  }
+
+  size_t
+  GC::Heap::parSweep(void) {
+    std::vector<HeapPage*> pages;
+    for (HeapPage* p = _page; p != NULL; p = p->next)
+      pages.push_back(p);
+    unsigned int nThreads =
+      static_cast<unsigned int>(std::min<size_t>(_threads, pages.size()));
+
+    /// Free lists and statistics for the pages swept by one thread
+    struct Part {
+      FreeListNode* fl[_max_fl+1];
+      FreeListNode* fl_last[_max_fl+1];
+      size_t freed;
+      SweepStats stats;
+      /// Dead VarDecls, whose weak references can only be reset sequentially
+      std::vector<std::pair<ASTNode*,size_t> > vardecls;
+      Part(void) : freed(0) {
+        for (int i=_max_fl+1; i--;)
+          fl[i] = fl_last[i] = NULL;
+      }
+    };
+    std::vector<Part> parts(nThreads);
+    std::vector<char> wholepage(pages.size(), 0);
+    std::atomic<size_t> nextPage(0);
+
+    auto sweepPages = [&](unsigned int me) {
+      Part& part = parts[me];
+      for (size_t i = nextPage++; i < pages.size(); i = nextPage++) {
+        HeapPage* p = pages[i];
+        size_t off = 0;
+        while (off < p->used) {
+          ASTNode* n = reinterpret_cast<ASTNode*>(p->data+off);
+          size_t ns = nodesize(n);
+          assert(ns != 0);
+          if (n->_gc_mark==0) {
+            if (_stats) {
+              part.stats.freedBytes[n->_id] += ns;
+              part.stats.freedNodes[n->_id]++;
+            }
+            if (n->_id==Expression::E_VARDECL) {
+              part.vardecls.push_back(std::make_pair(n,i));
+            } else {
+              destroy(n);
+              if (ns >= _fl_size[0] && ns <= _fl_size[_max_fl]) {
+                int slot = _fl_slot(ns);
+                FreeListNode* fln = static_cast<FreeListNode*>(n);
+                new (fln) FreeListNode(ns, part.fl[slot]);
+                if (part.fl[slot]==NULL)
+                  part.fl_last[slot] = fln;
+                part.fl[slot] = fln;
+                part.freed += ns;
+              } else {
+                assert(off==0);
+                assert(p->used==p->size);
+                wholepage[i] = 1;
+              }
+            }
+          } else {
+            if (n->_id != ASTNode::NID_FL) {
+              n->_gc_mark=0;
+              part.stats.live += ns;
+            }
+          }
+          off += ns;
+        }
+      }
+    };
+    _pool.run(nThreads, sweepPages);
+
+    SweepStats stats;
+    for (unsigned int i=0; i<nThreads; i++) {
+      Part& part = parts[i];
+      stats.add(part.stats);
+      for (int slot=0; slot<=_max_fl; slot++) {
+        if (part.fl[slot]) {
+          part.fl_last[slot]->next = _fl[slot];
+          _fl[slot] = part.fl[slot];
+        }
+      }
+      _free_mem += part.freed;
+      for (unsigned int j=0; j<part.vardecls.size(); j++) {
+        ASTNode* n = part.vardecls[j].first;
+        size_t ns = nodesize(n);
+        destroy(n);
+        if (ns >= _fl_size[0] && ns <= _fl_size[_max_fl]) {
+          FreeListNode* fln = static_cast<FreeListNode*>(n);
+          new (fln) FreeListNode(ns, _fl[_fl_slot(ns)]);
+          _fl[_fl_slot(ns)] = fln;
+          _free_mem += ns;
         } else {
-          std::cerr << (stat.second.total / 1024) << "K";
+          wholepage[part.vardecls[j].second] = 1;
         }
-      } else {
-        std::cerr << (stat.second.total);
       }
-      std::cerr << std::endl;
     }
+    assert(_alloced_mem >= _free_mem);
+
+    HeapPage* prev = NULL;
+    for (unsigned int i=0; i<pages.size(); i++) {
+      HeapPage* p = pages[i];
+      if (wholepage[i]) {
+#ifndef NDEBUG
+        memset(p->data,42,p->size);
 #endif
+        _alloced_mem -= p->size;
+        assert(_alloced_mem >= _free_mem);
+        ::free(p);
+      } else {
+        if (prev)
+          prev->next = p;
+        else
+          _page = p;
+        prev = p;
+      }
+    }
+    if (prev)
+      prev->next = NULL;
+    else
+      _page = NULL;
+    _swept.add(stats);
+    return stats.live;
+  }
+
+  void
+  GC::Heap::printStats(std::ostream& os) {
+    // Nodes that have been allocated but not reclaimed yet
+    size_t curBytes[Item::II_END+1];
+    size_t curNodes[Item::II_END+1];
+    for (int i=Item::II_END+1; i--;)
+      curBytes[i] = curNodes[i] = 0;
+    for (HeapPage* p = _page; p != NULL; p = p->next) {
+      for (size_t off = 0; off < p->used;) {
+        ASTNode* n = reinterpret_cast<ASTNode*>(p->data+off);
+        size_t ns = nodesize(n);
+        if (n->_id != ASTNode::NID_FL) {
+          curBytes[n->_id] += ns;
+          curNodes[n->_id]++;
+        }
+        off += ns;
+      }
+    }
+    double totalPause = 0.0;
+    double maxPause = 0.0;
+    for (unsigned int i=0; i<_runs.size(); i++) {
+      double pause = _runs[i].markTime+_runs[i].sweepTime;
+      totalPause += pause;
+      maxPause = std::max(maxPause, pause);
+    }
+
+    os << "{\n";
+    os << "  \"collections\": " << _runs.size() << ",\n";
+    os << "  \"total_pause_ms\": " << totalPause << ",\n";
+    os << "  \"max_pause_ms\": " << maxPause << ",\n";
+    os << "  \"heap_bytes\": " << _alloced_mem << ",\n";
+    os << "  \"free_bytes\": " << _free_mem << ",\n";
+    os << "  \"max_heap_bytes\": " << _max_alloced_mem << ",\n";
+    os << "  \"exact_allocations\": " << _exact_allocs << ",\n";
+    os << "  \"free_lists\": [\n";
+    for (int i=0; i<=_max_fl; i++) {
+      size_t total = _fl_hits[i]+_fl_misses[i];
+      os << "    {\"node_size\": " << _fl_size[i]
+         << ", \"hits\": " << _fl_hits[i]
+         << ", \"misses\": " << _fl_misses[i]
+         << ", \"hit_rate\": " << (total==0 ? 0.0 : static_cast<double>(_fl_hits[i])/total)
+         << "}" << (i < _max_fl ? "," : "") << "\n";
+    }
+    os << "  ],\n";
+    os << "  \"node_kinds\": {\n";
+    for (int i=ASTNode::NID_FL+1; i<=Item::II_END; i++) {
+      os << "    \"" << _nodeid[i] << "\": {"
+         << "\"allocated_nodes\": " << (_swept.freedNodes[i]+curNodes[i])
+         << ", \"allocated_bytes\": " << (_swept.freedBytes[i]+curBytes[i])
+         << ", \"current_nodes\": " << curNodes[i]
+         << ", \"current_bytes\": " << curBytes[i]
+         << "}" << (i < Item::II_END ? "," : "") << "\n";
+    }
+    os << "  },\n";
+    os << "  \"runs\": [\n";
+    for (unsigned int i=0; i<_runs.size(); i++) {
+      const GCRun& r = _runs[i];
+      os << "    {\"heap_bytes_before\": " << r.before
+         << ", \"heap_bytes_after\": " << r.after
+         << ", \"live_bytes\": " << r.live
+         << ", \"roots\": " << r.roots
+         << ", \"mark_ms\": " << r.markTime
+         << ", \"sweep_ms\": " << r.sweepTime
+         << ", \"pause_ms\": " << (r.markTime+r.sweepTime)
+         << "}" << (i+1 < _runs.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n";
+    os << "}\n";
   }
 
   ASTVec::ASTVec(size_t size)
@@ -608,31 +1181,38 @@ namespace MiniZinc {
     return GC::gc()->alloc(s);
   }
 
-  void
-  GC::mark(void) {
+  size_t
+  GC::maxMem(void) {
     GC* gc = GC::gc();
-    if (!gc->_heap->trail.empty())
-      gc->_heap->trail.back().mark = true;
+    return gc->_heap->_max_alloced_mem;
   }
   void
-  GC::trail(Expression** l,Expression* v) {
+  GC::threads(unsigned int n) {
+    if (gc()==NULL) {
+      gc() = new GC();
+    }
+    gc()->_heap->_threads = std::max(1u, n);
+    if (n <= 1)
+      gc()->_heap->_pool.stop();
+  }
+  unsigned int
+  GC::threads(void) {
     GC* gc = GC::gc();
-    gc->_heap->trail.push_back(GC::Heap::TItem(l,v));
+    return gc==NULL ? 1 : gc->_heap->_threads;
   }
   void
-  GC::untrail(void) {
-    GC* gc = GC::gc();
-    while (!gc->_heap->trail.empty() && !gc->_heap->trail.back().mark) {
-      *gc->_heap->trail.back().l = gc->_heap->trail.back().v;
-      gc->_heap->trail.pop_back();
+  GC::stats(bool b) {
+    if (gc()==NULL) {
+      gc() = new GC();
     }
-    if (!gc->_heap->trail.empty())
-      gc->_heap->trail.back().mark = false;
+    gc()->_heap->_stats = b;
   }
-  size_t
-  GC::maxMem(void) {
-    GC* gc = GC::gc();
-    return gc->_heap->_max_alloced_mem;
+  void
+  GC::printStats(std::ostream& os) {
+    if (gc()==NULL) {
+      gc() = new GC();
+    }
+    gc()->_heap->printStats(os);
   }
   
 
@@ -663,6 +1243,17 @@ namespace MiniZinc {
     }
   }
 
+  void
+  GC::pushBindings(Bindings* b) {
+    b->_next = GC::gc()->_heap->_bindings;
+    GC::gc()->_heap->_bindings = b;
+  }
+  void
+  GC::popBindings(Bindings* b) {
+    assert(GC::gc()->_heap->_bindings==b);
+    GC::gc()->_heap->_bindings = b->_next;
+  }
+
   KeepAlive::KeepAlive(Expression* e)
     : _e(e), _p(NULL), _n(NULL) {
     if (_e)
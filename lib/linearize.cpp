@@ -0,0 +1,554 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/linearize.hh>
+#include <minizinc/eval_par.hh>
+#include <minizinc/optimize.hh>
+#include <minizinc/astiterator.hh>
+
+#include <algorithm>
+#include <map>
+
+namespace MiniZinc {
+
+  namespace {
+
+    /// A 0/1 indicator, possibly negated
+    struct IndLit {
+      /// Identifier or integer literal
+      Expression* e;
+      /// Whether the indicator is 1 if and only if \a e is 0
+      bool neg;
+      IndLit(void) : e(NULL), neg(false) {}
+      IndLit(Expression* e0, bool neg0) : e(e0), neg(neg0) {}
+      /// Return the negated indicator
+      IndLit operator !(void) const { return IndLit(e,!neg); }
+    };
+
+    /// Normalised linear constraint sum(c[i]*x[i]) <= d, or = d if \a eq
+    struct LinKey {
+      bool eq;
+      std::vector<IntVal> c;
+      std::vector<VarDecl*> x;
+      IntVal d;
+      bool operator <(const LinKey& k) const {
+        if (eq != k.eq)
+          return eq < k.eq;
+        if (d != k.d)
+          return d < k.d;
+        if (c.size() != k.c.size())
+          return c.size() < k.c.size();
+        for (unsigned int i=0; i<c.size(); i++) {
+          if (x[i] != k.x[i])
+            return x[i] < k.x[i];
+          if (c[i] != k.c[i])
+            return c[i] < k.c[i];
+        }
+        return false;
+      }
+    };
+
+    /// Indicator constraint p <-> key
+    struct IndCon {
+      LinKey key;
+      IndLit p;
+      Location loc;
+    };
+
+    typedef std::map<LinKey,IndLit> IndMap;
+
+    /// Return whether indicator \a l is fixed, and if so its value in \a v
+    bool fixedLit(EnvI& env, const IndLit& l, IntVal& v) {
+      Expression* e = follow_id_to_value(l.e);
+      IntVal ev;
+      if (IntLit* il = e->dyn_cast<IntLit>()) {
+        ev = il->v();
+      } else {
+        VarDecl* vd = e->cast<Id>()->decl();
+        if (vd->ti()->domain()==NULL)
+          return false;
+        IntSetVal* isv = eval_intset(env,vd->ti()->domain());
+        if (isv->size() != 1 || isv->min() != isv->max())
+          return false;
+        ev = isv->min();
+      }
+      v = l.neg ? 1-ev : ev;
+      return true;
+    }
+
+    /// Return whether the domain of \a vd is empty
+    bool emptyDomain(EnvI& env, VarDecl* vd) {
+      return vd->ti()->domain() && eval_intset(env,vd->ti()->domain())->size()==0;
+    }
+
+    /// Fail the model if a variable of \a k has an empty domain
+    bool failedKey(EnvI& env, const LinKey& k) {
+      for (unsigned int i=0; i<k.x.size(); i++) {
+        if (emptyDomain(env,k.x[i])) {
+          env.flat()->fail(env);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// Builder for linear constraints over variables and indicators
+    class LinBuilder {
+    public:
+      EnvI& env;
+      std::vector<IntVal> c;
+      std::vector<KeepAlive> x;
+      IntVal d;
+      LinBuilder(EnvI& env0, IntVal d0) : env(env0), d(d0) {}
+      /// Add term \a a * \a e for variable \a e
+      void add(IntVal a, Expression* e) {
+        if (a != 0) {
+          c.push_back(a);
+          x.push_back(e);
+        }
+      }
+      /// Add the terms of \a k multiplied by \a a
+      void add(IntVal a, const LinKey& k) {
+        for (unsigned int i=0; i<k.c.size(); i++)
+          add(a*k.c[i],k.x[i]->id());
+      }
+      /// Add term \a a * \a l for indicator \a l
+      void add(IntVal a, const IndLit& l) {
+        IntVal v;
+        if (fixedLit(env,l,v)) {
+          d -= a*v;
+        } else if (l.neg) {
+          d -= a;
+          add(-a,l.e);
+        } else {
+          add(a,l.e);
+        }
+      }
+      /// Post sum(c[i]*x[i]) <= d, or = d if \a eq
+      void post(bool eq) {
+        IntVal d0 = 0;
+        simplify_lin<IntLit>(c,x,d0);
+        d -= d0;
+        if (c.empty()) {
+          if (eq ? d != 0 : d < 0)
+            env.flat()->fail(env);
+          return;
+        }
+        if (eq && c[0] < 0) {
+          for (unsigned int i=0; i<c.size(); i++)
+            c[i] = -c[i];
+          d = -d;
+        }
+        Call* call;
+        if (eq && ((c.size()==1 && c[0]==1) ||
+                   (c.size()==2 && c[0]==1 && c[1]==-1 && d==0))) {
+          std::vector<Expression*> args(2);
+          args[0] = x[0]();
+          args[1] = c.size()==1 ? static_cast<Expression*>(IntLit::a(d)) : x[1]();
+          call = new Call(Location().introduce(),constants().ids.int_.eq,args);
+        } else {
+          std::vector<Expression*> ce(c.size());
+          std::vector<Expression*> xe(x.size());
+          for (unsigned int i=0; i<c.size(); i++) {
+            ce[i] = IntLit::a(c[i]);
+            xe[i] = x[i]();
+          }
+          std::vector<Expression*> args(3);
+          args[0] = new ArrayLit(Location().introduce(),ce);
+          args[0]->type(Type::parint(1));
+          args[1] = new ArrayLit(Location().introduce(),xe);
+          args[1]->type(Type::varint(1));
+          args[2] = IntLit::a(d);
+          call = new Call(Location().introduce(),
+                          eq ? constants().ids.int_.lin_eq : constants().ids.int_.lin_le, args);
+        }
+        call->type(Type::varbool());
+        call->decl(env.orig->matchFn(env,call));
+        (void) flat_exp(env,Ctx(),call,constants().var_true,constants().var_true);
+      }
+    };
+
+    /// Constrain indicator \a l to take value \a v
+    void fixLit(EnvI& env, const IndLit& l, IntVal v) {
+      LinBuilder lb(env,v);
+      lb.add(1,l);
+      lb.post(true);
+    }
+
+    /// Constrain indicators \a l0 and \a l1 to be equal
+    void unifyLit(EnvI& env, const IndLit& l0, const IndLit& l1) {
+      LinBuilder lb(env,0);
+      lb.add(1,l0);
+      lb.add(-1,l1);
+      lb.post(true);
+    }
+
+    /// Create a new 0/1 indicator variable
+    IndLit newLit(EnvI& env) {
+      TypeInst* ti = new TypeInst(Location().introduce(),Type::varint(),
+                                  new SetLit(Location().introduce(),IntSetVal::a(IntVal(0),IntVal(1))));
+      VarDecl* vd = new VarDecl(Location().introduce(),ti,env.genId());
+      vd->introduced(true);
+      return IndLit(flat_exp(env,Ctx(),vd,NULL,constants().var_true).r(),false);
+    }
+
+    /// Return the indicator of \a k from \a m, creating it if necessary
+    IndLit findLit(EnvI& env, IndMap& m, const LinKey& k) {
+      IndMap::iterator it = m.find(k);
+      if (it != m.end())
+        return it->second;
+      IndLit l = newLit(env);
+      m.insert(std::make_pair(k,l));
+      return l;
+    }
+
+    /// Parse the arguments of indicator constraint \a call into \a ic
+    void parseInd(EnvI& env, Call* call, bool eq, bool neg, IndCon& ic) {
+      ArrayLit* al_c = eval_array_lit(env,call->args()[0]);
+      ArrayLit* al_x = eval_array_lit(env,call->args()[1]);
+      std::vector<IntVal> c(al_c->v().size());
+      std::vector<KeepAlive> x(al_x->v().size());
+      for (unsigned int i=0; i<c.size(); i++) {
+        c[i] = eval_int(env,al_c->v()[i]);
+        x[i] = al_x->v()[i];
+      }
+      IntVal d0 = 0;
+      simplify_lin<IntLit>(c,x,d0);
+      IntVal d = eval_int(env,call->args()[2])-d0;
+
+      // Order terms by the position of their declarations in the flat model
+      std::vector<std::pair<int,unsigned int> > order(c.size());
+      for (unsigned int i=0; i<c.size(); i++)
+        order[i] = std::make_pair(env.vo.find(x[i]()->cast<Id>()->decl()),i);
+      std::sort(order.begin(),order.end());
+
+      IntVal g = 0;
+      for (unsigned int i=0; i<c.size(); i++) {
+        IntVal a = std::abs(c[i]);
+        while (a != 0) {
+          IntVal t = g % a;
+          g = a;
+          a = t;
+        }
+      }
+      LinKey& k = ic.key;
+      k.eq = eq;
+      k.c.resize(c.size());
+      k.x.resize(c.size());
+      for (unsigned int i=0; i<c.size(); i++) {
+        k.c[i] = c[order[i].second] / g;
+        k.x[i] = x[order[i].second]()->cast<Id>()->decl();
+      }
+      ic.p = IndLit(call->args()[3],neg);
+      ic.loc = call->loc();
+      if (g > 1) {
+        if (!eq) {
+          IntVal q = d / g;
+          if (d % g != 0 && d < 0)
+            --q;
+          d = q;
+        } else if (d % g != 0) {
+          // The equation has no integer solutions
+          k.c.clear();
+          k.x.clear();
+          d = 1;
+        } else {
+          d = d / g;
+        }
+      }
+      // Normalise to a positive leading coefficient
+      if (!k.c.empty() && k.c[0] < 0) {
+        for (unsigned int i=0; i<k.c.size(); i++)
+          k.c[i] = -k.c[i];
+        if (eq) {
+          d = -d;
+        } else {
+          d = -d-1;
+          ic.p = !ic.p;
+        }
+      }
+      k.d = d;
+    }
+
+    /// Linearise p <-> sum(c[i]*x[i]) <= d
+    void linearizeLe(EnvI& env, const IndCon& ic) {
+      const LinKey& k = ic.key;
+      if (failedKey(env,k))
+        return;
+      IntVal L = 0;
+      IntVal U = 0;
+      bool finite = true;
+      for (unsigned int i=0; i<k.c.size(); i++) {
+        IntBounds b = LinearTraits<IntLit>::compute_bounds(env,k.x[i]->id());
+        if (!b.valid || !LinearTraits<IntLit>::finite(b)) {
+          finite = false;
+          break;
+        }
+        L += k.c[i] > 0 ? k.c[i]*b.l : k.c[i]*b.u;
+        U += k.c[i] > 0 ? k.c[i]*b.u : k.c[i]*b.l;
+      }
+      IntVal v;
+      if (finite && U <= k.d) {
+        fixLit(env,ic.p,1);
+      } else if (finite && L > k.d) {
+        fixLit(env,ic.p,0);
+      } else if (fixedLit(env,ic.p,v)) {
+        LinBuilder lb(env, v==1 ? k.d : -k.d-1);
+        lb.add(v==1 ? 1 : -1, k);
+        lb.post(false);
+      } else if (!finite) {
+        throw FlatteningError(env,ic.loc,"cannot linearise constraint on unbounded variables");
+      } else {
+        // p -> sum <= d
+        LinBuilder lb1(env,U);
+        lb1.add(1,k);
+        lb1.add(U-k.d,ic.p);
+        lb1.post(false);
+        // not p -> sum >= d+1
+        LinBuilder lb0(env,-(k.d+1));
+        lb0.add(-1,k);
+        lb0.add(-(k.d+1-L),ic.p);
+        lb0.post(false);
+      }
+    }
+
+    /// Linearise p <-> sum(c[i]*x[i]) = d
+    void linearizeEq(EnvI& env, IndMap& m, const IndCon& ic) {
+      const LinKey& k = ic.key;
+      if (failedKey(env,k))
+        return;
+      const IntVal& d = k.d;
+      IntVal L = 0;
+      IntVal U = 0;
+      bool finiteL = true;
+      bool finiteU = true;
+      for (unsigned int i=0; i<k.c.size(); i++) {
+        IntBounds b = LinearTraits<IntLit>::compute_bounds(env,k.x[i]->id());
+        IntVal lo = k.c[i] > 0 ? b.l : b.u;
+        IntVal hi = k.c[i] > 0 ? b.u : b.l;
+        if (!b.valid || !lo.isFinite())
+          finiteL = false;
+        else if (finiteL)
+          L += k.c[i]*lo;
+        if (!b.valid || !hi.isFinite())
+          finiteU = false;
+        else if (finiteU)
+          U += k.c[i]*hi;
+      }
+      IntVal v;
+      if ((finiteL && d < L) || (finiteU && d > U)) {
+        fixLit(env,ic.p,0);
+        return;
+      }
+      if (finiteL && finiteU && L==U) {
+        fixLit(env,ic.p,1);
+        return;
+      }
+      if (fixedLit(env,ic.p,v) && v==1) {
+        LinBuilder lb(env,d);
+        lb.add(1,k);
+        lb.post(true);
+        return;
+      }
+      bool hasLo = !finiteL || d > L;
+      bool hasHi = !finiteU || d < U;
+      if ((hasLo && !finiteL) || (hasHi && !finiteU))
+        throw FlatteningError(env,ic.loc,"cannot linearise constraint on unbounded variables");
+      if (hasLo && hasHi) {
+        // Split not p into sum <= d-1 (lo) and sum >= d+1 (hi),
+        // sharing the indicators of these inequalities if they exist
+        LinKey kl = k;
+        kl.eq = false;
+        kl.d = d-1;
+        IndLit lo = findLit(env,m,kl);
+        LinKey kh = kl;
+        kh.d = d;
+        IndMap::iterator it = m.find(kh);
+        if (it != m.end()) {
+          IndLit hi = !it->second;
+          LinBuilder lb(env,1);
+          lb.add(1,ic.p);
+          lb.add(1,lo);
+          lb.add(1,hi);
+          lb.post(true);
+          LinBuilder lb1(env,0);
+          lb1.add(1,k);
+          lb1.add(-(d-1),lo);
+          lb1.add(-d,ic.p);
+          lb1.add(-U,hi);
+          lb1.post(false);
+          LinBuilder lb0(env,0);
+          lb0.add(-1,k);
+          lb0.add(L,lo);
+          lb0.add(d,ic.p);
+          lb0.add(d+1,hi);
+          lb0.post(false);
+        } else {
+          if (!fixedLit(env,ic.p,v)) {
+            LinBuilder lb(env,1);
+            lb.add(1,ic.p);
+            lb.add(1,lo);
+            lb.post(false);
+          }
+          LinBuilder lb1(env,U);
+          lb1.add(1,k);
+          lb1.add(U-d,ic.p);
+          lb1.add(U-d+1,lo);
+          lb1.post(false);
+          LinBuilder lb0(env,-(d+1));
+          lb0.add(-1,k);
+          lb0.add(-1,ic.p);
+          lb0.add(-(d+1-L),lo);
+          lb0.post(false);
+        }
+      } else if (hasHi) {
+        // d is the lower bound, so not p means sum >= d+1
+        LinBuilder lb1(env,U);
+        lb1.add(1,k);
+        lb1.add(U-d,ic.p);
+        lb1.post(false);
+        LinBuilder lb0(env,-(d+1));
+        lb0.add(-1,k);
+        lb0.add(-1,ic.p);
+        lb0.post(false);
+      } else {
+        // d is the upper bound, so not p means sum <= d-1
+        LinBuilder lb1(env,d-1);
+        lb1.add(1,k);
+        lb1.add(-1,ic.p);
+        lb1.post(false);
+        LinBuilder lb0(env,-L);
+        lb0.add(-1,k);
+        lb0.add(d-L,ic.p);
+        lb0.post(false);
+      }
+    }
+
+    /// Equalities x = d of a single variable with different constants
+    struct EqGroup {
+      VarDecl* x;
+      std::vector<unsigned int> cons;
+      EqGroup(VarDecl* x0) : x(x0) {}
+    };
+
+  }
+
+  bool linearize(EnvI& env, std::vector<VarDecl*>& deletedVarDecls) {
+    Model& m = *env.flat();
+    if (m.failed())
+      return false;
+    GCLock lock;
+    ASTString le_ind("mzn_int_lin_le_ind");
+    ASTString eq_ind("mzn_int_lin_eq_ind");
+    ASTString ne_ind("mzn_int_lin_ne_ind");
+
+    std::vector<IndCon> cons;
+    for (unsigned int i=0; i<m.size(); i++) {
+      if (m[i]->removed())
+        continue;
+      if (ConstraintI* ci = m[i]->dyn_cast<ConstraintI>()) {
+        if (Call* c = ci->e()->dyn_cast<Call>()) {
+          if (c->id()==le_ind || c->id()==eq_ind || c->id()==ne_ind) {
+            cons.push_back(IndCon());
+            parseInd(env,c,c->id()!=le_ind,c->id()==ne_ind,cons.back());
+            CollectDecls cd(env.vo,deletedVarDecls,ci);
+            topDown(cd,c);
+            ci->e(constants().lit_true);
+            env.flat_removeItem(i);
+          }
+        }
+      }
+    }
+    if (cons.empty())
+      return false;
+
+    // Share the indicators of equivalent constraints
+    IndMap indicators;
+    std::vector<bool> shared(cons.size(),false);
+    for (unsigned int i=0; i<cons.size(); i++) {
+      IndMap::iterator it = indicators.find(cons[i].key);
+      if (it == indicators.end()) {
+        indicators.insert(std::make_pair(cons[i].key,cons[i].p));
+      } else {
+        unifyLit(env,cons[i].p,it->second);
+        shared[i] = true;
+      }
+    }
+
+    // Merge equalities x = d for several d into an equality encoding of x
+    std::vector<EqGroup> groups;
+    {
+      UNORDERED_NAMESPACE::unordered_map<VarDecl*,unsigned int> groupIdx;
+      for (unsigned int i=0; i<cons.size(); i++) {
+        const LinKey& k = cons[i].key;
+        IntVal v;
+        if (shared[i] || !k.eq || k.c.size() != 1 || k.c[0] != 1 || fixedLit(env,cons[i].p,v))
+          continue;
+        UNORDERED_NAMESPACE::unordered_map<VarDecl*,unsigned int>::iterator it = groupIdx.find(k.x[0]);
+        if (it == groupIdx.end()) {
+          groupIdx.insert(std::make_pair(k.x[0],groups.size()));
+          groups.push_back(EqGroup(k.x[0]));
+          groups.back().cons.push_back(i);
+        } else {
+          groups[it->second].cons.push_back(i);
+        }
+      }
+    }
+    for (unsigned int g=0; g<groups.size(); g++) {
+      EqGroup& eg = groups[g];
+      if (eg.cons.size() < 2 || eg.x->ti()->domain()==NULL)
+        continue;
+      IntSetVal* dom = eval_intset(env,eg.x->ti()->domain());
+      if (dom->size()==0 || !dom->min().isFinite() || !dom->max().isFinite())
+        continue;
+      std::map<IntVal,IndLit> valueLit;
+      for (unsigned int i=0; i<eg.cons.size(); i++) {
+        const IndCon& ic = cons[eg.cons[i]];
+        if (dom->contains(ic.key.d))
+          valueLit.insert(std::make_pair(ic.key.d,ic.p));
+      }
+      // Only encode if the constraints refer to at least half of the domain
+      if (valueLit.size() < 2 || dom->card() > 2*static_cast<long long int>(valueLit.size()))
+        continue;
+      for (unsigned int i=0; i<eg.cons.size(); i++) {
+        IndCon& ic = cons[eg.cons[i]];
+        if (!dom->contains(ic.key.d))
+          fixLit(env,ic.p,0);
+        shared[eg.cons[i]] = true;
+      }
+      LinBuilder one(env,1);
+      LinBuilder val(env,0);
+      val.add(-1,eg.x->id());
+      for (IntSetRanges r(dom); r(); ++r) {
+        for (IntVal v = r.min(); v <= r.max(); v++) {
+          std::map<IntVal,IndLit>::iterator it = valueLit.find(v);
+          IndLit l = it==valueLit.end() ? newLit(env) : it->second;
+          one.add(1,l);
+          val.add(v,l);
+        }
+      }
+      one.post(true);
+      val.post(true);
+    }
+
+    // Linearise the remaining constraints using bounds-based Big-M values
+    for (unsigned int i=0; i<cons.size() && !env.flat()->failed(); i++) {
+      if (!shared[i] && !cons[i].key.eq)
+        linearizeLe(env,cons[i]);
+    }
+    for (unsigned int i=0; i<cons.size() && !env.flat()->failed(); i++) {
+      if (!shared[i] && cons[i].key.eq)
+        linearizeEq(env,indicators,cons[i]);
+    }
+    return true;
+  }
+
+}
@@ -18,7 +18,7 @@
 
 namespace MiniZinc {
   
-  Model::Model(void) : _parent(NULL), _solveItem(NULL), _outputItem(NULL), _failed(false) {
+  Model::Model(void) : _parent(NULL), _solveItem(NULL), _outputItem(NULL), _failed(false), _frozen(false) {
     GC::add(this);
   }
 
@@ -32,7 +32,8 @@ namespace MiniZinc {
         }
       }
     }
-    GC::remove(this);
+    if (!_frozen)
+      GC::remove(this);
   }
 
   VarDeclIterator
@@ -132,7 +133,7 @@ namespace MiniZinc {
           }
         }
         if (match) {
-          return fi;
+          return env.libraryFn(fi);
         }
       }
     }
@@ -208,21 +209,21 @@ namespace MiniZinc {
           if (botarg)
             matched.push_back(fi);
           else
-            return fi;
+            return env.libraryFn(fi);
         }
       }
     }
     if (matched.empty())
       return NULL;
     if (matched.size()==1)
-      return matched[0];
+      return env.libraryFn(matched[0]);
     Type t = matched[0]->ti()->type();
     t.ti(Type::TI_PAR);
     for (unsigned int i=1; i<matched.size(); i++) {
       if (!t.isSubtypeOf(matched[i]->ti()->type()))
         throw TypeError(env, botarg->loc(), "ambiguous overloading on return type of function");
     }
-    return matched[0];
+    return env.libraryFn(matched[0]);
   }
   
   FunctionI*
@@ -264,21 +265,21 @@ namespace MiniZinc {
           if (botarg)
             matched.push_back(fi);
           else
-            return fi;
+            return env.libraryFn(fi);
         }
       }
     }
     if (matched.empty())
       return NULL;
     if (matched.size()==1)
-      return matched[0];
+      return env.libraryFn(matched[0]);
     Type t = matched[0]->ti()->type();
     t.ti(Type::TI_PAR);
     for (unsigned int i=1; i<matched.size(); i++) {
       if (!t.isSubtypeOf(matched[i]->ti()->type()))
         throw TypeError(env, botarg->loc(), "ambiguous overloading on return type of function");
     }
-    return matched[0];
+    return env.libraryFn(matched[0]);
   }
 
   Item*&
@@ -325,4 +326,17 @@ namespace MiniZinc {
   bool Model::failed() const {
     return _failed;
   }
+
+  void
+  Model::freeze(void) {
+    if (_frozen)
+      return;
+    _frozen = true;
+    GC::remove(this);
+    for (unsigned int i=0; i<_items.size(); i++) {
+      assert(_items[i]->immortal());
+      if (IncludeI* ii = _items[i]->dyn_cast<IncludeI>())
+        ii->m()->freeze();
+    }
+  }
 }
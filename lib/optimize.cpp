@@ -19,6 +19,8 @@
 #include <minizinc/optimize_constraints.hh>
 
 #include <vector>
+#include <map>
+#include <algorithm>
 
 namespace MiniZinc {
 
@@ -147,10 +149,7 @@ namespace MiniZinc {
           if (id0->type().isint() || id0->type().isintset()) {
             IntSetVal* isv0 = eval_intset(env,id0->decl()->ti()->domain());
             IntSetVal* isv1 = eval_intset(env,id1->decl()->ti()->domain());
-            IntSetRanges isv0r(isv0);
-            IntSetRanges isv1r(isv1);
-            Ranges::Inter<IntSetRanges,IntSetRanges> inter(isv0r,isv1r);
-            IntSetVal* nd = IntSetVal::ai(inter);
+            IntSetVal* nd = IntSetVal::intersect(isv0,isv1);
             if (nd->size()==0) {
               env.flat()->fail(env);
             } else {
@@ -208,6 +207,12 @@ namespace MiniZinc {
                           std::vector<VarDecl*>& deletedVarDecls,
                           std::vector<Item*>& constraintQueue,
                           std::vector<int>& vardeclQueue);
+
+  void simplifyClauses(EnvI& env, bool fixedLiterals,
+                       std::vector<ConstraintI*>& items,
+                       std::vector<VarDecl*>& deletedVarDecls,
+                       std::vector<Item*>& constraintQueue,
+                       std::vector<int>& vardeclQueue);
   
   void pushVarDecl(EnvI& env, VarDeclI* vdi, int vd_idx, std::vector<int>& q) {
     if (!vdi->removed() && !vdi->flag())
@@ -304,6 +309,14 @@ namespace MiniZinc {
         }
       } else if (VarDeclI* vdi = m[i]->dyn_cast<VarDeclI>()) {
         vdi->flag(false);
+        if (vdi->e()->type().isvar() && vdi->e()->e()==NULL &&
+            envi.vo.occurrences(vdi->e())==0 && isOutput(vdi->e())) {
+          // Unused output variables (e.g. after propagation during flattening)
+          // are moved to the output model below if they are fixed. Variables
+          // with a right hand side are kept, since removing them would also
+          // remove the constraint defined by the right hand side.
+          deletedVarDecls.push_back(vdi->e());
+        }
         if (vdi->e()->e() && vdi->e()->e()->isa<Id>() && vdi->e()->type().dim()==0) {
           Id* id1 = vdi->e()->e()->cast<Id>();
           vdi->e()->e(NULL);
@@ -340,6 +353,13 @@ namespace MiniZinc {
       }
     }
     
+    std::vector<ConstraintI*> clauseItems;
+    for (unsigned int i=0; i<m.size(); i++) {
+      if (ConstraintI* ci = m[i]->dyn_cast<ConstraintI>())
+        clauseItems.push_back(ci);
+    }
+    simplifyClauses(envi, false, clauseItems, deletedVarDecls, constraintQueue, vardeclQueue);
+
     ExpressionMap<int> nonFixedLiteralCount;
     while (!vardeclQueue.empty() || !constraintQueue.empty()) {
       while (!vardeclQueue.empty()) {
@@ -447,6 +467,15 @@ namespace MiniZinc {
         substitueFixedVars(envi, item, deletedVarDecls);
         handledConstraint = simplifyConstraint(envi,item,deletedVarDecls,constraintQueue,vardeclQueue);
       }
+      if (vardeclQueue.empty() && constraintQueue.empty()) {
+        // Propagation has finished, clean up clauses with fixed literals
+        clauseItems.clear();
+        for (unsigned int i=0; i<m.size(); i++) {
+          if (ConstraintI* ci = m[i]->dyn_cast<ConstraintI>())
+            clauseItems.push_back(ci);
+        }
+        simplifyClauses(envi, true, clauseItems, deletedVarDecls, constraintQueue, vardeclQueue);
+      }
     }
     for (unsigned int i=toRemoveConstraints.size(); i--;) {
       ConstraintI* ci = m[toRemoveConstraints[i]]->cast<ConstraintI>();
@@ -488,6 +517,7 @@ namespace MiniZinc {
         }
       }
     }
+    envi.flat_compact();
   }
 
   class SubstitutionVisitor : public EVisitor {
@@ -517,8 +547,10 @@ namespace MiniZinc {
   public:
     /// Visit array literal
     void vArrayLit(const ArrayLit& al) {
-      for (unsigned int i=0; i<al.v().size(); i++) {
-        al.v()[i] = subst(al.v()[i]);
+      // Substituting elements in place materialises a packed array
+      ASTExprVec<Expression> v = const_cast<ArrayLit&>(al).v();
+      for (unsigned int i=0; i<v.size(); i++) {
+        v[i] = subst(v[i]);
       }
     }
     /// Visit call
@@ -770,6 +802,251 @@ namespace MiniZinc {
     return false;
   }
   
+  /// A clause of the flat model as a set of literals
+  class FlatClause {
+  public:
+    /// The constraint item
+    ConstraintI* ci;
+    /// Sorted literals, 2*v for variable v and 2*v+1 for its negation
+    std::vector<int> lits;
+    /// Whether the clause has been removed
+    bool removed;
+    FlatClause(ConstraintI* ci0) : ci(ci0), removed(false) {}
+  };
+
+  /// Remove clause \a ci from the flat model
+  void removeClause(EnvI& env, ConstraintI* ci,
+                    std::vector<VarDecl*>& deletedVarDecls) {
+    CollectDecls cd(env.vo,deletedVarDecls,ci);
+    topDown(cd,ci->e());
+    env.flat_removeItem(ci);
+  }
+
+  /**
+   * \brief Simplify the clauses among the constraints \a items
+   *
+   * Collects the top-level clause and exists constraints in \a items,
+   * removes duplicate literals, tautologies, and clauses subsumed by other
+   * clauses, fixes unconstrained variables in unit clauses, and unifies
+   * variables that are equivalent because of a pair of binary clauses. If
+   * \a fixedLiterals is false, clauses containing fixed literals are
+   * ignored (they are left to unit propagation), otherwise satisfied
+   * clauses are removed and false literals are dropped, and the clauses of
+   * variables fixed by a unit clause are simplified again in the same pass.
+   * Fixed and unified variables are added to the propagation queues.
+   */
+  void simplifyClauses(EnvI& env, bool fixedLiterals,
+                       std::vector<ConstraintI*>& items,
+                       std::vector<VarDecl*>& deletedVarDecls,
+                       std::vector<Item*>& constraintQueue,
+                       std::vector<int>& vardeclQueue) {
+    std::vector<FlatClause> clauses;
+    std::vector<VarDecl*> vars;
+    UNORDERED_NAMESPACE::unordered_map<VarDecl*,int> varIdx;
+    UNORDERED_NAMESPACE::unordered_map<ConstraintI*,int> clauseIdx;
+
+    for (unsigned int i=0; i<items.size(); i++) {
+      ConstraintI* ci = items[i];
+      if (ci->removed() || !ci->e()->ann().isEmpty())
+        continue;
+      Call* c = ci->e()->dyn_cast<Call>();
+      if (c==NULL)
+        continue;
+      if (! ((c->id()==constants().ids.exists && c->args().size()==1) ||
+             ((c->id()==constants().ids.clause || c->id()==constants().ids.bool_clause) &&
+              c->args().size()==2)))
+        continue;
+      UNORDERED_NAMESPACE::unordered_map<ConstraintI*,int>::iterator cit = clauseIdx.find(ci);
+      if (cit != clauseIdx.end()) {
+        // Simplified again, the literals collected earlier are out of date
+        clauses[cit->second].removed = true;
+        clauseIdx.erase(cit);
+      }
+      FlatClause cl(ci);
+      bool isClause = true;
+      bool tautology = false;
+      unsigned int nLits = 0;
+      for (unsigned int j=0; isClause && j<c->args().size(); j++) {
+        bool ispos = j==0;
+        ArrayLit* al = follow_id(c->args()[j])->cast<ArrayLit>();
+        nLits += al->v().size();
+        for (unsigned int k=0; k<al->v().size(); k++) {
+          Expression* le = al->v()[k];
+          Id* id = le->dyn_cast<Id>();
+          if (le->type().ispar() || (id && id->decl()->ti()->domain())) {
+            if (!fixedLiterals) {
+              isClause = false;
+              break;
+            }
+            bool val = le->type().ispar() ? eval_bool(env,le) :
+              id->decl()->ti()->domain()==constants().lit_true;
+            if (val==ispos)
+              tautology = true;
+            continue;
+          }
+          if (id==NULL) {
+            isClause = false;
+            break;
+          }
+          VarDecl* vd = id->decl();
+          UNORDERED_NAMESPACE::unordered_map<VarDecl*,int>::iterator it = varIdx.find(vd);
+          int v;
+          if (it==varIdx.end()) {
+            v = vars.size();
+            varIdx.insert(std::make_pair(vd,v));
+            vars.push_back(vd);
+          } else {
+            v = it->second;
+          }
+          cl.lits.push_back(2*v+(ispos ? 0 : 1));
+        }
+      }
+      if (!isClause)
+        continue;
+      std::sort(cl.lits.begin(),cl.lits.end());
+      cl.lits.erase(std::unique(cl.lits.begin(),cl.lits.end()),cl.lits.end());
+      for (unsigned int j=1; !tautology && j<cl.lits.size(); j++) {
+        if (cl.lits[j]==(cl.lits[j-1]^1))
+          tautology = true;
+      }
+      if (tautology) {
+        removeClause(env,ci,deletedVarDecls);
+        continue;
+      }
+      if (cl.lits.empty()) {
+        env.flat()->fail(env);
+        continue;
+      }
+      if (cl.lits.size()==1) {
+        VarDecl* vd = vars[cl.lits[0]/2];
+        if (vd->e() != NULL) {
+          // Defined variables are fixed by unit propagation
+          continue;
+        }
+        vd->ti()->domain(constants().boollit(cl.lits[0]%2==0));
+        pushVarDecl(env, env.vo.idx.find(vd->id())->second, vardeclQueue);
+        pushDependentConstraints(env, vd->id(), constraintQueue);
+        if (fixedLiterals) {
+          IdMap<VarOccurrences::Items>::iterator it = env.vo._m.find(vd->id());
+          if (it != env.vo._m.end()) {
+            for (VarOccurrences::Items::iterator item = it->second.begin(); item != it->second.end(); ++item) {
+              if (ConstraintI* dep = (*item)->dyn_cast<ConstraintI>())
+                if (dep != ci)
+                  items.push_back(dep);
+            }
+          }
+        }
+        continue;
+      }
+      if (cl.lits.size() < nLits) {
+        bool allLits = true;
+        for (unsigned int j=0; j<c->args().size(); j++)
+          if (!c->args()[j]->isa<ArrayLit>())
+            allLits = false;
+        if (allLits) {
+          // Rebuild without duplicate or fixed literals
+          std::vector<Expression*> pos;
+          std::vector<Expression*> neg;
+          for (unsigned int j=0; j<cl.lits.size(); j++) {
+            if (cl.lits[j]%2==0)
+              pos.push_back(vars[cl.lits[j]/2]->id());
+            else
+              neg.push_back(vars[cl.lits[j]/2]->id());
+          }
+          std::vector<Expression*> args(c->args().size());
+          args[0] = new ArrayLit(Location().introduce(),pos);
+          args[0]->type(Type::varbool(1));
+          if (args.size()==2) {
+            args[1] = new ArrayLit(Location().introduce(),neg);
+            args[1]->type(Type::varbool(1));
+          }
+          Call* nc = new Call(c->loc(),c->id(),args);
+          nc->type(c->type());
+          nc->decl(c->decl());
+          CollectDecls cd(env.vo,deletedVarDecls,ci);
+          topDown(cd,c);
+          ci->e(nc);
+          CollectOccurrencesE ce(env.vo,ci);
+          topDown(ce,nc);
+        }
+      }
+      clauseIdx.insert(std::make_pair(ci,static_cast<int>(clauses.size())));
+      clauses.push_back(cl);
+    }
+
+    // Subsumption, shorter clauses first
+    std::vector<std::vector<int> > occ(2*vars.size());
+    std::vector<int> order(clauses.size());
+    for (unsigned int i=0; i<clauses.size(); i++) {
+      order[i] = i;
+      for (unsigned int j=0; j<clauses[i].lits.size(); j++)
+        occ[clauses[i].lits[j]].push_back(i);
+    }
+    class CmpSize {
+    public:
+      std::vector<FlatClause>& cls;
+      CmpSize(std::vector<FlatClause>& cls0) : cls(cls0) {}
+      bool operator ()(int i, int j) {
+        return cls[i].lits.size() < cls[j].lits.size() ||
+               (cls[i].lits.size() == cls[j].lits.size() && i < j);
+      }
+    } _cmpSize(clauses);
+    std::sort(order.begin(),order.end(),_cmpSize);
+    for (unsigned int i=0; i<order.size(); i++) {
+      FlatClause& cl = clauses[order[i]];
+      if (cl.removed)
+        continue;
+      int minLit = cl.lits[0];
+      for (unsigned int j=1; j<cl.lits.size(); j++)
+        if (occ[cl.lits[j]].size() < occ[minLit].size())
+          minLit = cl.lits[j];
+      std::vector<int>& candidates = occ[minLit];
+      for (unsigned int j=0; j<candidates.size(); j++) {
+        FlatClause& other = clauses[candidates[j]];
+        if (candidates[j]==order[i] || other.removed ||
+            other.lits.size() < cl.lits.size())
+          continue;
+        if (std::includes(other.lits.begin(),other.lits.end(),
+                          cl.lits.begin(),cl.lits.end())) {
+          other.removed = true;
+          removeClause(env,other.ci,deletedVarDecls);
+        }
+      }
+    }
+
+    // Equivalent literals: (a \/ not b) /\ (not a \/ b)
+    std::map<std::pair<int,int>,int> binary;
+    std::vector<bool> unified(vars.size(),false);
+    for (unsigned int i=0; i<clauses.size(); i++) {
+      FlatClause& cl = clauses[i];
+      if (cl.removed || cl.lits.size() != 2 || (cl.lits[0]%2)==(cl.lits[1]%2))
+        continue;
+      std::map<std::pair<int,int>,int>::iterator it =
+        binary.find(std::make_pair(cl.lits[0]^1,cl.lits[1]^1));
+      if (it == binary.end()) {
+        binary.insert(std::make_pair(std::make_pair(cl.lits[0],cl.lits[1]),i));
+        continue;
+      }
+      FlatClause& other = clauses[it->second];
+      VarDecl* v0 = vars[cl.lits[0]/2];
+      VarDecl* v1 = vars[cl.lits[1]/2];
+      if (other.removed || unified[cl.lits[0]/2] || unified[cl.lits[1]/2] ||
+          v0->ti()->domain() || v1->ti()->domain() ||
+          (v0->e() != NULL && v1->e() != NULL))
+        continue;
+      unified[cl.lits[0]/2] = true;
+      unified[cl.lits[1]/2] = true;
+      cl.removed = true;
+      other.removed = true;
+      removeClause(env,cl.ci,deletedVarDecls);
+      removeClause(env,other.ci,deletedVarDecls);
+      binary.erase(it);
+      Id* id0 = v0->id();
+      unify(env, id0, v1->id());
+      pushDependentConstraints(env, id0, constraintQueue);
+    }
+  }
+
   int boolState(EnvI& env, Expression* e) {
     if (e->type().ispar()) {
       return eval_bool(env,e);
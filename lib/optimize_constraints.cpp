@@ -218,13 +218,9 @@ namespace MiniZinc {
     public:
       Register(void) {
         GCLock lock;
-        Model* m = new Model;
+        GCImmortal immortal;
         ASTString id_element("array_int_element");
         ASTString id_var_element("array_var_int_element");
-        std::vector<Expression*> e;
-        e.push_back(new StringLit(Location(),id_element));
-        e.push_back(new StringLit(Location(),id_var_element));
-        m->addItem(new ConstraintI(Location(),new ArrayLit(Location(),e)));
         OptimizeRegistry::registry().reg(constants().ids.int_.lin_eq, o_linear);
         OptimizeRegistry::registry().reg(constants().ids.int_.lin_le, o_linear);
         OptimizeRegistry::registry().reg(constants().ids.int_.lin_ne, o_linear);
@@ -197,6 +197,31 @@ namespace MiniZinc {
       }
     }
     
+    void pFloat(FloatVal f) {
+      std::ostringstream oss;
+      oss << std::setprecision(std::numeric_limits<double>::digits10+2);
+      oss << f;
+      if (oss.str().find("e") == std::string::npos && oss.str().find(".") == std::string::npos)
+        oss << ".0";
+      os << oss.str();
+    }
+    void pElem(const ArrayLit& al, unsigned int i) {
+      if (const ASTParVecO* pv = al.packed()) {
+        switch (pv->kind()) {
+        case ASTParVecO::PV_INT:
+          os << pv->i(i);
+          break;
+        case ASTParVecO::PV_FLOAT:
+          pFloat(pv->f(i));
+          break;
+        case ASTParVecO::PV_BOOL:
+          os << (pv->b(i) ? "true" : "false");
+          break;
+        }
+      } else {
+        p(al[i]);
+      }
+    }
     void p(const Expression* e) {
       if (e==NULL)
         return;
@@ -205,14 +230,7 @@ namespace MiniZinc {
         os << e->cast<IntLit>()->v();
         break;
       case Expression::E_FLOATLIT:
-        {
-          std::ostringstream oss;
-          oss << std::setprecision(std::numeric_limits<double>::digits10+2);
-          oss << e->cast<FloatLit>()->v();
-          if (oss.str().find("e") == std::string::npos && oss.str().find(".") == std::string::npos)
-            oss << ".0";
-          os << oss.str();
-        }
+        pFloat(e->cast<FloatLit>()->v());
         break;
       case Expression::E_SETLIT:
         {
@@ -285,9 +303,9 @@ namespace MiniZinc {
           int n = al.dims();
           if (n == 1 && al.min(0) == 1) {
             os << "[";
-            for (unsigned int i = 0; i < al.v().size(); i++) {
-              p(al.v()[i]);
-              if (i<al.v().size()-1)
+            for (unsigned int i = 0; i < al.size(); i++) {
+              pElem(al,i);
+              if (i<al.size()-1)
                 os << ",";
             }
             os << "]";
@@ -295,7 +313,7 @@ namespace MiniZinc {
             os << "[|";
             for (int i = 0; i < al.max(0); i++) {
               for (int j = 0; j < al.max(1); j++) {
-                p(al.v()[i * al.max(1) + j]);
+                pElem(al,i * al.max(1) + j);
                 if (j < al.max(1)-1)
                   os << ",";
               }
@@ -310,9 +328,9 @@ namespace MiniZinc {
               os << ",";
             }
             os << "[";
-            for (unsigned int i = 0; i < al.v().size(); i++) {
-              p(al.v()[i]);
-              if (i<al.v().size()-1)
+            for (unsigned int i = 0; i < al.size(); i++) {
+              pElem(al,i);
+              if (i<al.size()-1)
                 os << ",";
             }
             os << "])";
@@ -1118,15 +1136,15 @@ namespace MiniZinc {
       int n = al.dims();
       if (n == 1 && al.min(0) == 1) {
         dl = new DocumentList("[", ", ", "]");
-        for (unsigned int i = 0; i < al.v().size(); i++)
-          dl->addDocumentToList(expressionToDocument(al.v()[i]));
+        for (unsigned int i = 0; i < al.size(); i++)
+          dl->addDocumentToList(expressionToDocument(al[i]));
       } else if (n == 2 && al.min(0) == 1 && al.min(1) == 1) {
         dl = new DocumentList("[| ", " | ", " |]");
         for (int i = 0; i < al.max(0); i++) {
           DocumentList* row = new DocumentList("", ", ", "");
           for (int j = 0; j < al.max(1); j++) {
             row->
-              addDocumentToList(expressionToDocument(al.v()[i * al.max(1) + j]));
+              addDocumentToList(expressionToDocument(al[i * al.max(1) + j]));
           }
           dl->addDocumentToList(row);
           if (i != al.max(0) - 1)
@@ -1145,8 +1163,8 @@ namespace MiniZinc {
           args->addStringToList(oss.str());
         }
         DocumentList* array = new DocumentList("[", ", ", "]");
-        for (unsigned int i = 0; i < al.v().size(); i++)
-          array->addDocumentToList(expressionToDocument(al.v()[i]));
+        for (unsigned int i = 0; i < al.size(); i++)
+          array->addDocumentToList(expressionToDocument(al[i]));
         args->addDocumentToList(array);
         dl->addDocumentToList(args);
       }
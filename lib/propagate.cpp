@@ -0,0 +1,274 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/propagate.hh>
+#include <minizinc/eval_par.hh>
+#include <minizinc/optimize.hh>
+#include <minizinc/astiterator.hh>
+
+namespace MiniZinc {
+
+  namespace {
+
+    /// Relations of the integer comparisons that can be decided
+    enum Rel { R_LE, R_EQ, R_NE };
+
+    /// Whether the domain of \a vd is implied by its definition
+    bool hasComputedDomain(VarDecl* vd) {
+      return vd->type().isvar() && vd->type().isint() && !vd->type().isopt() &&
+             (vd->introduced() || vd->ti()->domain()==NULL || vd->ti()->computedDomain());
+    }
+
+    /// Return the declaration defined by constraint \a c, or NULL
+    VarDecl* definedVar(Call* c) {
+      for (ExpressionSetIter it = c->ann().begin(); it != c->ann().end(); ++it) {
+        Call* ann = (*it)->dyn_cast<Call>();
+        if (ann && ann->id()==constants().ann.defines_var) {
+          if (Id* id = ann->args()[0]->dyn_cast<Id>())
+            return id->decl();
+        }
+      }
+      return NULL;
+    }
+
+    /// Compute bounds of sum(c[i]*x[i]) over all i except \a skip
+    IntBounds linBounds(EnvI& env, ArrayLit* c, ArrayLit* x, int skip) {
+      IntVal l = 0;
+      IntVal u = 0;
+      for (unsigned int i=0; i<x->v().size(); i++) {
+        if (static_cast<int>(i)==skip)
+          continue;
+        IntVal ci = eval_int(env,c->v()[i]);
+        IntBounds b = compute_int_bounds(env,x->v()[i]);
+        if (!b.valid || !b.l.isFinite() || !b.u.isFinite())
+          return IntBounds(0,0,false);
+        if (ci > 0) {
+          l += ci*b.l;
+          u += ci*b.u;
+        } else {
+          l += ci*b.u;
+          u += ci*b.l;
+        }
+      }
+      return IntBounds(l,u,true);
+    }
+
+    /**
+     * \brief Decide the integer comparison \a c using the current domains
+     *
+     * If \a reif is true, \a c is the reified form with the control
+     * variable as its last argument. Returns whether \a c is entailed or
+     * disentailed, and in that case its truth value in \a value.
+     */
+    bool decide(EnvI& env, Call* c, bool reif, bool& value) {
+      const ASTString& id = c->id();
+      unsigned int nargs = c->args().size() - (reif ? 1 : 0);
+      Rel rel;
+      IntVal d = 0;
+      bool lin = false;
+      if (id==(reif ? constants().ids.int_reif.le : constants().ids.int_.le)) {
+        rel = R_LE;
+      } else if (id==(reif ? constants().ids.int_reif.lt : constants().ids.int_.lt)) {
+        rel = R_LE;
+        d = -1;
+      } else if (id==(reif ? constants().ids.int_reif.eq : constants().ids.int_.eq)) {
+        rel = R_EQ;
+      } else if (id==(reif ? constants().ids.int_reif.ne : constants().ids.int_.ne)) {
+        rel = R_NE;
+      } else if (id==(reif ? constants().ids.int_reif.lin_le : constants().ids.int_.lin_le)) {
+        rel = R_LE;
+        lin = true;
+      } else if (id==(reif ? constants().ids.int_reif.lin_eq : constants().ids.int_.lin_eq)) {
+        rel = R_EQ;
+        lin = true;
+      } else if (id==(reif ? constants().ids.int_reif.lin_ne : constants().ids.int_.lin_ne)) {
+        rel = R_NE;
+        lin = true;
+      } else {
+        return false;
+      }
+      if (nargs != (lin ? 3 : 2))
+        return false;
+
+      IntBounds b(0,0,false);
+      if (lin) {
+        b = linBounds(env,eval_array_lit(env,c->args()[0]),eval_array_lit(env,c->args()[1]),-1);
+        d += eval_int(env,c->args()[2]);
+      } else {
+        Expression* x = c->args()[0];
+        Expression* y = c->args()[1];
+        if (!x->type().isint() || !y->type().isint())
+          return false;
+        if (rel != R_LE) {
+          // A constant outside the domain decides an (in)equality
+          if (x->type().ispar())
+            std::swap(x,y);
+          if (y->type().ispar() && x->isa<Id>() && x->cast<Id>()->decl()->ti()->domain()) {
+            IntSetVal* dom = eval_intset(env,x->cast<Id>()->decl()->ti()->domain());
+            if (!dom->contains(eval_int(env,y))) {
+              value = (rel==R_NE);
+              return true;
+            }
+          }
+        }
+        IntBounds bx = compute_int_bounds(env,x);
+        IntBounds by = compute_int_bounds(env,y);
+        if (bx.valid && by.valid && bx.l.isFinite() && bx.u.isFinite() &&
+            by.l.isFinite() && by.u.isFinite())
+          b = IntBounds(bx.l-by.u,bx.u-by.l,true);
+      }
+      if (!b.valid)
+        return false;
+      switch (rel) {
+        case R_LE:
+          if (b.u <= d) {
+            value = true;
+          } else if (b.l > d) {
+            value = false;
+          } else {
+            return false;
+          }
+          break;
+        case R_EQ:
+        case R_NE:
+          if (b.l==d && b.u==d) {
+            value = true;
+          } else if (b.u < d || b.l > d) {
+            value = false;
+          } else {
+            return false;
+          }
+          if (rel==R_NE)
+            value = !value;
+          break;
+      }
+      return true;
+    }
+
+    /// Narrow the domain of \a vd to the bounds \a ib implied by its definition
+    void narrowDomain(EnvI& env, VarDecl* vd, const IntBounds& ib) {
+      if (!ib.valid || !ib.l.isFinite() || !ib.u.isFinite())
+        return;
+      IntSetVal* ibv = IntSetVal::a(ib.l,ib.u);
+      if (vd->ti()->domain()) {
+        IntSetVal* domain = eval_intset(env,vd->ti()->domain());
+        IntSetVal* newibv = IntSetVal::intersect(domain,ibv);
+        if (newibv->card()==domain->card())
+          return;
+        if (newibv->size()==0) {
+          env.flat()->fail(env);
+          return;
+        }
+        if (ibv->card()==newibv->card())
+          vd->ti()->setComputedDomain(true);
+        ibv = newibv;
+      } else {
+        vd->ti()->setComputedDomain(true);
+      }
+      vd->ti()->domain(new SetLit(Location().introduce(),ibv));
+      env.domainChanged(vd);
+    }
+
+    /// Fix the Boolean \a vd to \a value
+    void fixBool(EnvI& env, VarDecl* vd, bool value) {
+      vd->ann().remove(constants().ann.is_defined_var);
+      Ctx ctx;
+      ctx.neg = !value;
+      (void) bind(env,ctx,constants().var_true,vd->id());
+    }
+
+    /// Propagate a narrowed domain into \a item
+    void propagateItem(EnvI& env, Item* item, std::vector<VarDecl*>& deletedVarDecls) {
+      if (VarDeclI* vdi = item->dyn_cast<VarDeclI>()) {
+        VarDecl* vd = vdi->e();
+        Call* c = vd->e() ? vd->e()->dyn_cast<Call>() : NULL;
+        if (c==NULL)
+          return;
+        bool value;
+        if (vd->type().isvar() && vd->type().isbool()) {
+          if (decide(env,c,false,value)) {
+            CollectDecls cd(env.vo,deletedVarDecls,vdi);
+            topDown(cd,c);
+            vd->e(NULL);
+            fixBool(env,vd,value);
+          }
+        } else if (hasComputedDomain(vd)) {
+          narrowDomain(env,vd,compute_int_bounds(env,c));
+        }
+      } else if (ConstraintI* ci = item->dyn_cast<ConstraintI>()) {
+        Call* c = ci->e()->dyn_cast<Call>();
+        if (c==NULL)
+          return;
+        VarDecl* def = definedVar(c);
+        if (def==NULL)
+          return;
+        bool value;
+        if (c->id()==constants().ids.int_.lin_eq) {
+          if (!hasComputedDomain(def))
+            return;
+          ArrayLit* al_c = eval_array_lit(env,c->args()[0]);
+          ArrayLit* al_x = eval_array_lit(env,c->args()[1]);
+          for (unsigned int i=0; i<al_x->v().size(); i++) {
+            Id* id = al_x->v()[i]->dyn_cast<Id>();
+            if (id && id->decl()==def) {
+              // def = (d - sum of the other terms) / c[i]
+              IntVal ci = eval_int(env,al_c->v()[i]);
+              IntBounds b = linBounds(env,al_c,al_x,i);
+              if (b.valid) {
+                IntVal d = eval_int(env,c->args()[2]);
+                IntVal l = ci > 0 ? d-b.u : d-b.l;
+                IntVal u = ci > 0 ? d-b.l : d-b.u;
+                narrowDomain(env,def,IntBounds(LinearTraits<IntLit>::ceil_div(l,ci),
+                                               LinearTraits<IntLit>::floor_div(u,ci),true));
+              }
+              break;
+            }
+          }
+        } else if (def->type().isvar() && def->type().isbool() &&
+                   c->args()[c->args().size()-1]->isa<Id>() &&
+                   c->args()[c->args().size()-1]->cast<Id>()->decl()==def &&
+                   decide(env,c,true,value)) {
+          CollectDecls cd(env.vo,deletedVarDecls,ci);
+          topDown(cd,c);
+          ci->e(constants().lit_true);
+          env.flat_removeItem(ci);
+          fixBool(env,def,value);
+        }
+      }
+    }
+
+  }
+
+  void propagateDomains(EnvI& env, std::vector<VarDecl*>& deletedVarDecls) {
+    if (env.domainQueue.empty())
+      return;
+    GCLock lock;
+    Model& m = *env.flat();
+    while (!env.domainQueue.empty() && !m.failed()) {
+      int idx = env.domainQueue.back();
+      env.domainQueue.pop_back();
+      if (m[idx]->removed())
+        continue;
+      VarDecl* vd = m[idx]->cast<VarDeclI>()->e();
+      IdMap<VarOccurrences::Items>::iterator it = env.vo._m.find(vd->id());
+      if (it==env.vo._m.end())
+        continue;
+      // Propagation may remove items from the occurrences of vd
+      std::vector<Item*> items(it->second.begin(),it->second.end());
+      for (unsigned int i=0; i<items.size() && !m.failed(); i++) {
+        if (!items[i]->removed())
+          propagateItem(env,items[i],deletedVarDecls);
+      }
+    }
+    env.domainQueue.clear();
+  }
+
+}
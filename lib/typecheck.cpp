@@ -836,6 +836,9 @@ namespace MiniZinc {
       }
       void vOutputI(OutputI* i) { ts.run(env,i->e()); }
       void vFunctionI(FunctionI* fi) {
+        // Functions of frozen libraries have already been typechecked
+        if (fi->immortal())
+          return;
         ts.run(env,fi->ti());
         for (unsigned int i=0; i<fi->params().size(); i++)
           ts.run(env,fi->params()[i]);
@@ -881,6 +884,8 @@ namespace MiniZinc {
         ty.vVarDecl(*ts.decls[i]);
       }
       for (unsigned int i=0; i<functionItems.size(); i++) {
+        if (functionItems[i]->immortal())
+          continue;
         bu_ty.run(functionItems[i]->ti());
         for (unsigned int j=0; j<functionItems[i]->params().size(); j++)
           bu_ty.run(functionItems[i]->params()[j]);
@@ -944,6 +949,8 @@ namespace MiniZinc {
             throw TypeError(env, i->e()->loc(), "invalid type in output item, expected `"+Type::parstring(1).toString()+"', actual `"+i->e()->type().toString()+"'");
         }
         void vFunctionI(FunctionI* i) {
+          if (i->immortal())
+            return;
           for (ExpressionSetIter it = i->ann().begin(); it != i->ann().end(); ++it) {
             bu_ty.run(*it);
             if (!(*it)->type().isann())
@@ -16,6 +16,274 @@ namespace MiniZinc {
   
   const IntVal IntVal::minint = IntVal(INT_MIN);
   const IntVal IntVal::maxint = IntVal(INT_MAX);
-  const IntVal IntVal::infinity = IntVal(1,true);
+  const IntVal IntVal::infinity = IntVal(LLONG_MAX,IntVal::Unchecked());
+
+  namespace {
+    
+    typedef IntSetVal::Range Range;
+    
+    /// Buffer of sorted ranges that coalesces adjacent and overlapping ranges
+    class RangeBuffer {
+    private:
+      /// Inline storage for small results
+      Range _s[16];
+      /// Heap storage for large results
+      std::vector<Range> _v;
+      /// Current storage
+      Range* _r;
+      /// Number of ranges
+      int _n;
+    public:
+      /// Create buffer for at most \a n ranges
+      RangeBuffer(int n) : _r(_s), _n(0) {
+        if (n > 16) {
+          _v.resize(n);
+          _r = &_v[0];
+        }
+      }
+      /// Append range \a min .. \a max (must not start before the last range)
+      void push(const IntVal& min, const IntVal& max) {
+        if (_n > 0 && min <= _r[_n-1].max.plus(1)) {
+          if (max > _r[_n-1].max)
+            _r[_n-1].max = max;
+        } else {
+          _r[_n++] = Range(min,max);
+        }
+      }
+      /// Return number of ranges
+      int size(void) const { return _n; }
+      /// Return range \a i
+      const Range& operator [](int i) const { return _r[i]; }
+      /// Return ranges
+      const Range* ranges(void) const { return _r; }
+    };
+    
+    /// Union of sorted range arrays \a x and \a y
+    void unionRanges(const Range* x, int nx, const Range* y, int ny,
+                     RangeBuffer& r) {
+      int i=0, j=0;
+      while (i<nx && j<ny) {
+        if (x[i].min <= y[j].min) {
+          r.push(x[i].min,x[i].max); i++;
+        } else {
+          r.push(y[j].min,y[j].max); j++;
+        }
+      }
+      for (; i<nx; i++)
+        r.push(x[i].min,x[i].max);
+      for (; j<ny; j++)
+        r.push(y[j].min,y[j].max);
+    }
+    
+    /// Intersection of sorted range arrays \a x and \a y
+    void interRanges(const Range* x, int nx, const Range* y, int ny,
+                     RangeBuffer& r) {
+      int i=0, j=0;
+      while (i<nx && j<ny) {
+        IntVal lo = std::max(x[i].min,y[j].min);
+        IntVal hi = std::min(x[i].max,y[j].max);
+        if (lo <= hi)
+          r.push(lo,hi);
+        if (x[i].max < y[j].max)
+          i++;
+        else
+          j++;
+      }
+    }
+    
+    /// Difference of sorted range arrays \a x and \a y
+    void diffRanges(const Range* x, int nx, const Range* y, int ny,
+                    RangeBuffer& r) {
+      int j=0;
+      for (int i=0; i<nx; i++) {
+        IntVal lo = x[i].min;
+        IntVal hi = x[i].max;
+        while (j<ny && y[j].max < lo)
+          j++;
+        bool covered = false;
+        for (int k=j; k<ny && y[k].min <= hi; k++) {
+          if (y[k].min > lo)
+            r.push(lo,y[k].min.minus(1));
+          if (y[k].max >= hi) {
+            covered = true;
+            break;
+          }
+          lo = y[k].max+1;
+        }
+        if (!covered)
+          r.push(lo,hi);
+      }
+    }
+    
+    /// Set operations supported by the bitset kernel
+    enum SetOp { SO_UNION, SO_INTER, SO_DIFF, SO_SYMDIFF };
+    
+    typedef unsigned long long int Word;
+    
+    /// Return index of least significant set bit in \a w (must be non-zero)
+    inline unsigned int ctz(Word w) {
+#if defined(__GNUC__)
+      return __builtin_ctzll(w);
+#else
+      unsigned int c = 0;
+      while ((w & 1)==0) {
+        w >>= 1;
+        c++;
+      }
+      return c;
+#endif
+    }
+    
+    /// Maximum number of bits for the bitset kernel
+    const long long int maxBits = 1 << 20;
+    
+    /// Set the bits for ranges \a x in \a w, relative to \a base
+    void setBits(Word* w, long long int base, const Range* x, int nx) {
+      for (int i=0; i<nx; i++) {
+        long long int lo = x[i].min.toInt()-base;
+        long long int hi = x[i].max.toInt()-base;
+        long long int lw = lo >> 6;
+        long long int hw = hi >> 6;
+        Word lm = ~static_cast<Word>(0) << (lo & 63);
+        Word hm = ~static_cast<Word>(0) >> (63 - (hi & 63));
+        if (lw==hw) {
+          w[lw] |= lm & hm;
+        } else {
+          w[lw] |= lm;
+          for (long long int k=lw+1; k<hw; k++)
+            w[k] = ~static_cast<Word>(0);
+          w[hw] |= hm;
+        }
+      }
+    }
+    
+    /**
+     * \brief Apply \a op to \a x and \a y using dense bitsets
+     *
+     * Returns false (without touching \a r) if the sets are not bounded,
+     * or too sparse for the bitset to be cheaper than merging ranges.
+     */
+    bool bitsetOp(SetOp op, const Range* x, int nx, const Range* y, int ny,
+                  RangeBuffer& r) {
+      IntVal min = std::min(x[0].min,y[0].min);
+      IntVal max = std::max(x[nx-1].max,y[ny-1].max);
+      if (!min.isFinite() || !max.isFinite())
+        return false;
+      unsigned long long int span =
+        static_cast<unsigned long long int>(max.toInt()) -
+        static_cast<unsigned long long int>(min.toInt());
+      if (span >= static_cast<unsigned long long int>(maxBits))
+        return false;
+      long long int bits = static_cast<long long int>(span)+1;
+      if (bits > 64LL*(nx+ny))
+        return false;
+      long long int base = min.toInt();
+      long long int nw = (bits+63) >> 6;
+      std::vector<Word> wx(nw,0);
+      std::vector<Word> wy(nw,0);
+      Word* px = &wx[0];
+      Word* py = &wy[0];
+      setBits(px,base,x,nx);
+      setBits(py,base,y,ny);
+      switch (op) {
+      case SO_UNION:
+        for (long long int k=0; k<nw; k++)
+          px[k] |= py[k];
+        break;
+      case SO_INTER:
+        for (long long int k=0; k<nw; k++)
+          px[k] &= py[k];
+        break;
+      case SO_DIFF:
+        for (long long int k=0; k<nw; k++)
+          px[k] &= ~py[k];
+        break;
+      case SO_SYMDIFF:
+        for (long long int k=0; k<nw; k++)
+          px[k] ^= py[k];
+        break;
+      }
+      // Extract maximal runs of set bits
+      bool inRun = false;
+      long long int start = 0;
+      for (long long int k=0; k<nw; k++) {
+        Word cur = px[k];
+        unsigned int b = 0;
+        while (b < 64) {
+          Word m = (inRun ? ~cur : cur) & (~static_cast<Word>(0) << b);
+          if (m==0)
+            break;
+          b = ctz(m);
+          if (inRun)
+            r.push(base+start,base+(k<<6)+b-1);
+          else
+            start = (k<<6)+b;
+          inRun = !inRun;
+        }
+      }
+      if (inRun)
+        r.push(base+start,base+(nw<<6)-1);
+      return true;
+    }
+  }
+  
+  IntSetVal*
+  IntSetVal::unite(IntSetVal* x, IntSetVal* y) {
+    if (y->size()==0)
+      return x;
+    if (x->size()==0)
+      return y;
+    if (x->size()==1 && y->size()==1 &&
+        x->min() <= y->max().plus(1) && y->min() <= x->max().plus(1))
+      return a(std::min(x->min(),y->min()),std::max(x->max(),y->max()));
+    RangeBuffer r(x->size()+y->size());
+    if (!bitsetOp(SO_UNION,&x->get(0),x->size(),&y->get(0),y->size(),r))
+      unionRanges(&x->get(0),x->size(),&y->get(0),y->size(),r);
+    return a(r.ranges(),r.size());
+  }
+  
+  IntSetVal*
+  IntSetVal::intersect(IntSetVal* x, IntSetVal* y) {
+    if (x->size()==0)
+      return x;
+    if (y->size()==0)
+      return y;
+    if (x->size()==1 && y->size()==1)
+      return a(std::max(x->min(),y->min()),std::min(x->max(),y->max()));
+    if (x->max() < y->min() || y->max() < x->min())
+      return a();
+    RangeBuffer r(x->size()+y->size());
+    if (!bitsetOp(SO_INTER,&x->get(0),x->size(),&y->get(0),y->size(),r))
+      interRanges(&x->get(0),x->size(),&y->get(0),y->size(),r);
+    return a(r.ranges(),r.size());
+  }
+  
+  IntSetVal*
+  IntSetVal::diff(IntSetVal* x, IntSetVal* y) {
+    if (x->size()==0 || y->size()==0 ||
+        x->max() < y->min() || y->max() < x->min())
+      return x;
+    RangeBuffer r(x->size()+y->size());
+    if (!bitsetOp(SO_DIFF,&x->get(0),x->size(),&y->get(0),y->size(),r))
+      diffRanges(&x->get(0),x->size(),&y->get(0),y->size(),r);
+    return a(r.ranges(),r.size());
+  }
+  
+  IntSetVal*
+  IntSetVal::symdiff(IntSetVal* x, IntSetVal* y) {
+    if (y->size()==0)
+      return x;
+    if (x->size()==0)
+      return y;
+    RangeBuffer r(x->size()+y->size());
+    if (!bitsetOp(SO_SYMDIFF,&x->get(0),x->size(),&y->get(0),y->size(),r)) {
+      RangeBuffer u(x->size()+y->size());
+      unionRanges(&x->get(0),x->size(),&y->get(0),y->size(),u);
+      RangeBuffer i(x->size()+y->size());
+      interRanges(&x->get(0),x->size(),&y->get(0),y->size(),i);
+      diffRanges(u.ranges(),u.size(),i.ranges(),i.size(),r);
+    }
+    return a(r.ranges(),r.size());
+  }
   
-}
\ No newline at end of file
+}
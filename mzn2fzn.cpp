@@ -57,6 +57,7 @@ int main(int argc, char** argv) {
   bool flag_optimize = true;
   bool flag_werror = false;
   bool flag_statistics = false;
+  bool flag_gc_stats = false;
   
   Timer starttime;
   Timer lasttime;
@@ -113,6 +114,8 @@ int main(int argc, char** argv) {
       flag_newfzn = true;
     } else if (string(argv[i])==string("--no-optimize") || string(argv[i])==string("--no-optimise")) {
       flag_optimize = false;
+    } else if (string(argv[i])==string("--half-reify")) {
+      fopts.halfReifications = true;
     } else if (string(argv[i])==string("--no-output-ozn") ||
                string(argv[i])==string("-O-")) {
       flag_no_output_ozn = false;
@@ -217,6 +220,17 @@ int main(int argc, char** argv) {
       flag_werror = true;
     } else if (string(argv[i])=="-s" || string(argv[i])=="--statistics") {
       flag_statistics = true;
+    } else if (string(argv[i])=="--gc-threads") {
+      i++;
+      if (i==argc)
+        goto error;
+      int gcThreads = atoi(argv[i]);
+      if (gcThreads < 1)
+        goto error;
+      GC::threads(gcThreads);
+    } else if (string(argv[i])=="--gc-stats") {
+      flag_gc_stats = true;
+      GC::stats(true);
     } else {
       if(!flag_inputFromStdin) {
         std::string input_file(argv[i]);
@@ -523,6 +537,9 @@ int main(int argc, char** argv) {
     std::cerr << ")." << std::endl;
     
   }
+  if (flag_gc_stats) {
+    GC::printStats(std::cerr);
+  }
   return 0;
 
 error:
@@ -537,11 +554,14 @@ error:
             << "  -s, --statistics\n    Print statistics" << std::endl
             << "  --instance-check-only\n    Check the model instance (including data) for errors, but do not\n    convert to FlatZinc." << std::endl
             << "  --no-optimize\n    Do not optimize the FlatZinc\n    Currently does nothing (only available for compatibility with 1.6)" << std::endl
+            << "  --half-reify\n    Use half-reified (_imp) constraints for Boolean variables that only\n    occur positively, if the solver library declares them" << std::endl
             << "  -d <file>, --data <file>\n    File named <file> contains data used by the model." << std::endl
             << "  -D <data>, --cmdline-data <data>\n    Include the given data in the model." << std::endl
             << "  --stdlib-dir <dir>\n    Path to MiniZinc standard library directory" << std::endl
             << "  -G --globals-dir --mzn-globals-dir\n    Search for included files in <stdlib>/<dir>." << std::endl
             << "  --input-from-stdin\n    Read the MiniZinc model from stdin. Default output names are output.mzn and output.ozn." << std::endl
+            << "  --gc-threads <n>\n    Use <n> threads for garbage collection (default 1)" << std::endl
+            << "  --gc-stats\n    Print garbage collection statistics in JSON format" << std::endl
             << std::endl
             << "Output options:" << std::endl << std::endl
             << "  --no-output-ozn, -O-\n    Do not output ozn file" << std::endl
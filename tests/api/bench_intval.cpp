@@ -0,0 +1,88 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Microbenchmark for IntVal and integer set operations: checked
+ * arithmetic over a vector of values, sorting the vector, and
+ * intersecting two large integer sets. Prints the time taken by each.
+ *
+ * usage: bench_intval [number of values]
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <minizinc/values.hh>
+#include <minizinc/iter.hh>
+
+using namespace MiniZinc;
+
+namespace {
+
+  typedef std::chrono::steady_clock Clock;
+
+  double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now()-start).count();
+  }
+
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  std::vector<IntVal> v;
+  v.reserve(n);
+  for (int i=0; i<n; i++)
+    v.push_back(IntVal((i*7919LL) % 1000003 - 500000));
+
+  Clock::time_point start = Clock::now();
+  IntVal lb = 0;
+  IntVal ub = 0;
+  for (int r=0; r<20; r++) {
+    for (unsigned int i=0; i<v.size(); i++) {
+      IntVal x = v[i]*3;
+      lb += std::min(x, IntVal(0));
+      ub += std::max(x, IntVal(0));
+    }
+  }
+  std::cout << "arithmetic: " << seconds(start) << "s"
+            << " (" << lb << ".." << ub << ")" << std::endl;
+
+  start = Clock::now();
+  std::sort(v.begin(), v.end());
+  std::cout << "sort: " << seconds(start) << "s" << std::endl;
+
+  GCLock lock;
+  std::vector<IntSetVal::Range> ra;
+  std::vector<IntSetVal::Range> rb;
+  for (unsigned int i=0; i+1<v.size(); i+=2) {
+    if (ra.empty() || ra.back().max+1 < v[i])
+      ra.push_back(IntSetVal::Range(v[i], v[i]));
+    if (rb.empty() || rb.back().max+1 < v[i+1]-1)
+      rb.push_back(IntSetVal::Range(v[i+1]-1, v[i+1]));
+  }
+  IntSetVal* a = IntSetVal::a(ra);
+  IntSetVal* b = IntSetVal::a(rb);
+  start = Clock::now();
+  IntVal card = 0;
+  for (int r=0; r<10; r++) {
+    IntSetRanges ar(a);
+    IntSetRanges br(b);
+    Ranges::Inter<IntSetRanges,IntSetRanges> inter(ar, br);
+    IntSetVal* c = IntSetVal::ai(inter);
+    card += c->card();
+  }
+  std::cout << "intersect: " << seconds(start) << "s"
+            << " (" << card << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,57 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Checks that the identifiers in constants().ids, which live in the
+ * immortal region, are interned: creating a string with the same contents
+ * on any thread must return the very same string object.
+ *
+ * usage: test_intern
+ */
+
+#include <iostream>
+#include <thread>
+
+#include <minizinc/ast.hh>
+
+using namespace MiniZinc;
+
+namespace {
+
+  /// Count the identifiers in constants().ids that are not interned
+  int checkIds(const char* where) {
+    GCLock lock;
+    // ids is a struct made up of ASTString members only
+    const ASTString* ids =
+      reinterpret_cast<const ASTString*>(&constants().ids);
+    const unsigned int n_ids = sizeof(constants().ids)/sizeof(ASTString);
+    int failures = 0;
+    for (unsigned int i=0; i<n_ids; i++) {
+      ASTString s(ids[i].str());
+      if (s.aststr() != ids[i].aststr()) {
+        std::cerr << "identifier " << ids[i].str() << " is not interned "
+                  << where << std::endl;
+        failures++;
+      }
+    }
+    return failures;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  int failures = checkIds("on the main thread");
+  std::thread t([&failures]() {
+    failures += checkIds("on another thread");
+  });
+  t.join();
+  return failures==0 ? 0 : 1;
+}
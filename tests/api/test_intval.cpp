@@ -0,0 +1,85 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Checks the boundaries of the IntVal representation: the values reserved
+ * for plus and minus infinity (and LLONG_MIN) cannot be constructed from a
+ * long long, the extreme finite values behave like ordinary integers, and
+ * infinity is ordered outside the finite range.
+ *
+ * usage: test_intval
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include <minizinc/values.hh>
+
+using namespace MiniZinc;
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool b, const char* what) {
+    if (!b) {
+      std::cerr << "failed: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  /// Return whether constructing an IntVal from \a v throws an ArithmeticError
+  bool rejects(long long int v) {
+    try {
+      IntVal i(v);
+      return false;
+    } catch (ArithmeticError&) {
+      return true;
+    }
+  }
+
+  /// Return whether \a x - \a y throws an ArithmeticError
+  bool overflows(const IntVal& x, const IntVal& y) {
+    try {
+      (void)(x-y);
+      return false;
+    } catch (ArithmeticError&) {
+      return true;
+    }
+  }
+
+}
+
+int main(int argc, char** argv) {
+  check(rejects(LLONG_MAX), "LLONG_MAX is rejected");
+  check(rejects(-LLONG_MAX), "-LLONG_MAX is rejected");
+  check(rejects(LLONG_MIN), "LLONG_MIN is rejected");
+
+  IntVal max(LLONG_MAX-1);
+  IntVal min(-LLONG_MAX+1);
+  check(max.isFinite() && min.isFinite(), "extreme values are finite");
+  check((max-1).toInt() == LLONG_MAX-2, "largest value minus one");
+  check((min+1).toInt() == -LLONG_MAX+2, "smallest value plus one");
+  check((-max).toInt() == -LLONG_MAX+1, "negation of largest value");
+  check(overflows(max, -1), "largest value plus one overflows");
+  check(overflows(min, 1), "smallest value minus one overflows");
+
+  check(-IntVal::infinity < min, "minus infinity is below all finite values");
+  check(max < IntVal::infinity, "infinity is above all finite values");
+  check((-IntVal::infinity).isMinusInfinity(), "negation of infinity");
+
+  std::ostringstream oss;
+  oss << min << " " << max;
+  check(oss.str() == "-9223372036854775806 9223372036854775806",
+        "extreme values are printed as integers");
+
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Flattens a set of models that include a shared, frozen library
+ * (see parseLibrary) on several threads at the same time, and checks that
+ * the result is the same as flattening each model on its own with a
+ * private copy of the standard library.
+ *
+ * usage: test_shared_library <stdlib directory>
+ */
+
+#include <iostream>
+#include <thread>
+
+#include <minizinc/parser.hh>
+
+#include "test_util.hh"
+
+using namespace MiniZinc;
+
+namespace {
+
+  const char* models[] = {
+    "include \"alldifferent.mzn\";\n"
+    "array[1..4] of var 1..4: q;\n"
+    "constraint alldifferent(q);\n"
+    "constraint alldifferent(i in 1..4)(q[i]+i);\n"
+    "constraint alldifferent(i in 1..4)(q[i]-i);\n"
+    "solve satisfy;\n"
+    "output [show(q)];\n",
+
+    "include \"cumulative.mzn\";\n"
+    "array[1..3] of var 0..10: s;\n"
+    "constraint cumulative(s,[2,3,4],[1,2,2],3);\n"
+    "var 0..20: end = max(i in 1..3)(s[i]+[2,3,4][i]);\n"
+    "solve minimize end;\n"
+    "output [show(s),\" \",show(end)];\n",
+
+    "include \"globals.mzn\";\n"
+    "array[1..5] of var 1..9: x;\n"
+    "var 1..5: i;\n"
+    "constraint increasing(x) /\\ x[i] = 4;\n"
+    "constraint sum(j in 1..5)(bool2int(x[j] > 2)) >= 2 \\/ x[1] = x[5];\n"
+    "constraint among(2,x,{1,3,5});\n"
+    "solve maximize sum(x);\n"
+    "output [show(x)];\n",
+
+    "include \"table.mzn\";\n"
+    "include \"lex_lesseq.mzn\";\n"
+    "array[1..3] of var 0..2: y;\n"
+    "array[1..3] of var bool: b;\n"
+    "constraint table(y,[|0,1,2|1,2,0|2,0,1|]);\n"
+    "constraint lex_lesseq(b,[y[k]>0 | k in 1..3]);\n"
+    "solve satisfy;\n"
+    "output [show(y),show(b)];\n"
+  };
+  const unsigned int n_models = sizeof(models)/sizeof(models[0]);
+
+  /// Flatten \a text, including \a library unless it is NULL, and print the result
+  std::string flattenModel(const std::string& text,
+                           const std::vector<std::string>& includePaths,
+                           Model* library) {
+    std::stringstream errstream;
+    Model* m;
+    if (library)
+      m = parseFromStringWithLibrary(text, "model.mzn", includePaths, library,
+                                     false, false, errstream);
+    else
+      m = parseFromString(text, "model.mzn", includePaths, false,
+                          false, false, errstream);
+    if (m==NULL)
+      return "parse error: "+errstream.str();
+    return Test::flattenModel(m);
+  }
+
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <stdlib directory>" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> includePaths;
+  includePaths.push_back(std::string(argv[1])+"/");
+
+  std::vector<std::string> expected(n_models);
+  for (unsigned int i=0; i<n_models; i++)
+    expected[i] = flattenModel(models[i], includePaths, NULL);
+
+  std::vector<std::string> includes;
+  includes.push_back("globals.mzn");
+  Model* library = parseLibrary(includes, includePaths, std::cerr);
+  if (library==NULL)
+    return 1;
+
+  const unsigned int n_rounds = 3;
+  std::vector<std::string> actual(n_models*n_rounds);
+  std::vector<std::thread> threads;
+  for (unsigned int i=0; i<actual.size(); i++) {
+    threads.push_back(std::thread([&actual,&includePaths,library,i]() {
+      actual[i] = flattenModel(models[i % n_models], includePaths, library);
+    }));
+  }
+  for (unsigned int i=0; i<threads.size(); i++)
+    threads[i].join();
+
+  int failures = 0;
+  for (unsigned int i=0; i<actual.size(); i++) {
+    if (Test::normalise(actual[i]) != Test::normalise(expected[i % n_models])) {
+      std::cerr << "model " << i % n_models << " differs when flattened with "
+                << "the shared library:\n" << actual[i] << "\nexpected:\n"
+                << expected[i % n_models] << std::endl;
+      failures++;
+    }
+  }
+  return failures==0 ? 0 : 1;
+}
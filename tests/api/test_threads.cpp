@@ -0,0 +1,88 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Stress test for compiling independent models in one process: each of a
+ * set of example models is parsed, typechecked and flattened on its own
+ * thread, several times over, with parallel garbage collection enabled.
+ * The results must be the same as flattening the models one after the
+ * other on the main thread.
+ *
+ * usage: test_threads <stdlib directory> <examples directory>
+ */
+
+#include <iostream>
+#include <thread>
+
+#include <minizinc/parser.hh>
+
+#include "test_util.hh"
+
+using namespace MiniZinc;
+
+namespace {
+
+  const char* models[] = {
+    "alpha.mzn", "golomb.mzn", "langford.mzn", "magicsq_4.mzn",
+    "perfsq.mzn", "photo.mzn", "queen_cp2.mzn", "sudoku.mzn"
+  };
+  const unsigned int n_models = sizeof(models)/sizeof(models[0]);
+
+  /// Parse and flatten the model in \a filename, and print the result
+  std::string flattenFile(const std::string& filename,
+                          const std::vector<std::string>& includePaths) {
+    std::stringstream errstream;
+    Model* m = parse(filename, std::vector<std::string>(), includePaths,
+                     false, false, false, errstream);
+    if (m==NULL)
+      return "parse error: "+errstream.str();
+    return Test::flattenModel(m);
+  }
+
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0]
+              << " <stdlib directory> <examples directory>" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> includePaths;
+  includePaths.push_back(std::string(argv[1])+"/");
+  std::string dir = std::string(argv[2])+"/";
+
+  std::vector<std::string> expected(n_models);
+  for (unsigned int i=0; i<n_models; i++)
+    expected[i] = Test::normalise(flattenFile(dir+models[i], includePaths));
+
+  const unsigned int n_rounds = 2;
+  std::vector<std::string> actual(n_models*n_rounds);
+  std::vector<std::thread> threads;
+  for (unsigned int i=0; i<actual.size(); i++) {
+    threads.push_back(std::thread([&actual,&includePaths,&dir,i]() {
+      GC::threads(2);
+      actual[i] = flattenFile(dir+models[i % n_models], includePaths);
+      GC::threads(1);
+    }));
+  }
+  for (unsigned int i=0; i<threads.size(); i++)
+    threads[i].join();
+
+  int failures = 0;
+  for (unsigned int i=0; i<actual.size(); i++) {
+    if (Test::normalise(actual[i]) != expected[i % n_models]) {
+      std::cerr << models[i % n_models] << " differs when flattened on "
+                << "several threads:\n" << actual[i] << std::endl;
+      failures++;
+    }
+  }
+  return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+ *  Main authors:
+ *     Guido Tack <guido.tack@monash.edu>
+ */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __MINIZINC_TEST_UTIL_HH__
+#define __MINIZINC_TEST_UTIL_HH__
+
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+#include <minizinc/model.hh>
+#include <minizinc/prettyprinter.hh>
+#include <minizinc/typecheck.hh>
+#include <minizinc/flatten.hh>
+#include <minizinc/optimize.hh>
+#include <minizinc/builtins.hh>
+
+namespace MiniZinc { namespace Test {
+
+  /// Typecheck and flatten \a m, delete it, and return the printed result
+  inline std::string flattenModel(Model* m) {
+    std::stringstream result;
+    try {
+      Env env(m);
+      std::vector<TypeError> typeErrors;
+      typecheck(env, m, typeErrors);
+      if (typeErrors.size() > 0) {
+        result << "type error: " << typeErrors[0].msg();
+      } else {
+        registerBuiltins(env, m);
+        flatten(env, FlatteningOptions());
+        optimize(env);
+        oldflatzinc(env);
+        Printer p(result,0);
+        p.print(env.flat());
+        p.print(env.output());
+      }
+    } catch (LocationException& e) {
+      result << e.what() << ": " << e.msg();
+    }
+    delete m;
+    return result.str();
+  }
+
+  /**
+   * \brief Normalise a printed flat model for comparison
+   *
+   * The flattener orders the arguments of some commutative constraints by
+   * node address, and numbers introduced variables in the order in which
+   * they are created, so neither is stable between runs. Introduced names
+   * are replaced by X, the elements of each innermost array are sorted,
+   * and so are the lines.
+   */
+  inline std::string normalise(const std::string& printed) {
+    std::vector<std::string> lines;
+    std::istringstream is(printed);
+    std::string line;
+    const std::string introduced = "X_INTRODUCED_";
+    while (std::getline(is, line)) {
+      std::string::size_type p;
+      while ((p = line.find(introduced)) != std::string::npos) {
+        std::string::size_type q = p+introduced.size();
+        while (q < line.size() && isdigit(line[q]))
+          q++;
+        line.replace(p, q-p, "X");
+      }
+      std::string::size_type close = 0;
+      while ((close = line.find(']', close)) != std::string::npos) {
+        std::string::size_type open = line.rfind('[', close);
+        if (open != std::string::npos &&
+            line.find(']', open+1) == close) {
+          std::vector<std::string> elems;
+          std::istringstream es(line.substr(open+1, close-open-1));
+          std::string elem;
+          while (std::getline(es, elem, ','))
+            elems.push_back(elem);
+          std::sort(elems.begin(), elems.end());
+          std::string sorted;
+          for (unsigned int i=0; i<elems.size(); i++)
+            sorted += (i==0 ? "" : ",")+elems[i];
+          line.replace(open+1, close-open-1, sorted);
+          close = open+1+sorted.size();
+        }
+        close++;
+      }
+      lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    std::string result;
+    for (unsigned int i=0; i<lines.size(); i++)
+      result += lines[i]+"\n";
+    return result;
+  }
+
+}}
+
+#endif